@@ -0,0 +1,131 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "../extensions/atmosphere.h"
+#include "../extensions/shaders.h"
+
+// Costo por píxel de la atmósfera con tablas contra el shader de la Tierra que cubre, y error de las tablas contra la
+// integración directa. Termina con error si la atmósfera cuesta más que ATMOSPHERE_COST_BOUND veces el shader o si
+// alguna muestra de las tablas se aparta más que ATMOSPHERE_ERROR_BOUND del valor exacto, medido contra su canal más
+// brillante y sin bajar de ATMOSPHERE_ERROR_FLOOR para que el lado nocturno, casi negro, no domine
+
+const int IMAGE_SIZE = 512;
+const double ATMOSPHERE_COST_BOUND = 0.25;
+const float ATMOSPHERE_ERROR_BOUND = 0.15f;
+const float ATMOSPHERE_ERROR_FLOOR = 0.01f;
+
+int main(int argc, char* argv[]) {
+    const float radius = 0.5f;
+    AtmosphereParameters earth = {0.06f, 0.012f, glm::vec3(0.03f, 0.07f, 0.17f), 8.0f};
+
+    auto precomputeStart = std::chrono::steady_clock::now();
+    std::unique_ptr<Atmosphere> atmosphere = createAtmosphere(earth, radius, "");
+    std::chrono::duration<double, std::milli> precomputeElapsed = std::chrono::steady_clock::now() - precomputeStart;
+
+    Uniform uniform{};
+    uniform.model = glm::mat4(1.0f);
+    uniform.frame.cameraPosition = glm::vec3(0.0f, 0.0f, 3.0f);
+    uniform.frame.sunPosition = glm::vec3(100.0f, 50.0f, 100.0f);
+    uniform.animationPhase = 1.5f;
+    AtmosphereView view = createAtmosphereView(*atmosphere, uniform);
+
+    // Una imagen del planeta en orden de barrido, como la recorre el rasterizador: los píxeles que caen sobre el disco
+    // son fragmentos de la superficie y el resto son rayos que pueden cruzar el borde de la atmósfera
+    float extent = 1.25f * (1.0f + earth.height);
+    std::vector<Fragment> fragments;
+    std::vector<glm::vec3> limbDirections;
+    for (int y = 0; y < IMAGE_SIZE; y++) {
+        for (int x = 0; x < IMAGE_SIZE; x++) {
+            glm::vec3 target(((x + 0.5f) / IMAGE_SIZE * 2.0f - 1.0f) * extent, ((y + 0.5f) / IMAGE_SIZE * 2.0f - 1.0f) * extent, 0.0f);
+            glm::vec3 direction = glm::normalize(target - view.camera);
+            float b = glm::dot(view.camera, direction);
+            float discriminant = b * b - view.cameraDistanceSquared + 1.0f;
+            if (discriminant < 0.0f) {
+                limbDirections.push_back(direction);
+                continue;
+            }
+            Fragment fragment;
+            glm::vec3 point = view.camera + direction * (-b - std::sqrt(discriminant));
+            fragment.original = point * radius;
+            fragment.normal = glm::normalize(point);
+            fragment.z = 0.5f;
+            fragment.footprint = 0.0f;
+            fragments.push_back(fragment);
+        }
+    }
+
+    std::vector<Color> surfaceColors(fragments.size());
+    auto shaderStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < fragments.size(); i++) {
+        Fragment fragment = fragments[i];
+        surfaceColors[i] = fragmentShaderEarth(fragment, uniform);
+    }
+    std::chrono::duration<double, std::nano> shaderElapsed = std::chrono::steady_clock::now() - shaderStart;
+
+    std::vector<Color> shadedColors(fragments.size());
+    auto atmosphereStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < fragments.size(); i++) {
+        shadedColors[i] = fromLinear(shadeAtmosphereSurface(*atmosphere, view, fragments[i].original, toLinear(surfaceColors[i])));
+    }
+    std::chrono::duration<double, std::nano> atmosphereElapsed = std::chrono::steady_clock::now() - atmosphereStart;
+
+    size_t limbPixels = 0;
+    ColorF limbSum;
+    auto limbStart = std::chrono::steady_clock::now();
+    for (const glm::vec3& direction : limbDirections) {
+        ColorF inscattered;
+        if (shadeAtmosphereLimb(*atmosphere, view, direction, inscattered)) {
+            limbSum = limbSum + inscattered;
+            limbPixels++;
+        }
+    }
+    std::chrono::duration<double, std::nano> limbElapsed = std::chrono::steady_clock::now() - limbStart;
+
+    // Error de interpolación: la tabla contra la integración de computeScattering en el mismo punto de entrada, sobre
+    // el disco y en los rayos del borde
+    std::vector<glm::vec3> errorDirections;
+    for (size_t i = 0; i < fragments.size(); i += 64) {
+        errorDirections.push_back(glm::normalize(fragments[i].original / radius - view.camera));
+    }
+    for (size_t i = 0; i < limbDirections.size(); i += 16) {
+        errorDirections.push_back(limbDirections[i]);
+    }
+    float maximumError = 0.0f;
+    float maximumRelativeError = 0.0f;
+    for (const glm::vec3& direction : errorDirections) {
+        float mu, muSun, nu;
+        if (!atmosphereEntry(*atmosphere, view, direction, mu, muSun, nu)) {
+            continue;
+        }
+        glm::vec3 exact = computeScattering(*atmosphere, mu, muSun, nu);
+        ColorF table;
+        storeColorF(table, sampleScattering(*atmosphere, mu, muSun, nu));
+        float error = std::max({std::abs(table.r - exact.x), std::abs(table.g - exact.y), std::abs(table.b - exact.z)});
+        float brightest = std::max({exact.x, exact.y, exact.z});
+        maximumError = std::max(maximumError, error);
+        maximumRelativeError = std::max(maximumRelativeError, error / std::max(brightest, ATMOSPHERE_ERROR_FLOOR));
+    }
+
+    double shaderCost = shaderElapsed.count() / fragments.size();
+    double atmosphereCost = atmosphereElapsed.count() / fragments.size();
+    double limbCost = limbElapsed.count() / limbDirections.size();
+    std::cout << "Precompute: " << precomputeElapsed.count() << " ms ("
+              << (atmosphere->transmittance.size() + atmosphere->scattering.size()) * sizeof(ColorF) / 1024 << " KB of tables)" << std::endl;
+    std::cout << "Earth shader: " << shaderCost << " ns/pixel" << std::endl;
+    std::cout << "Atmosphere over the surface: " << atmosphereCost << " ns/pixel (" << atmosphereCost / shaderCost * 100.0 << "% of the shader)" << std::endl;
+    std::cout << "Atmosphere limb: " << limbCost << " ns/pixel, " << limbPixels << " of " << limbDirections.size() << " rays lit, mean blue "
+              << (limbPixels > 0 ? limbSum.b / limbPixels : 0.0f) << std::endl;
+    std::cout << "Largest table error against direct integration: " << maximumError << " (" << maximumRelativeError * 100.0f
+              << "% of the exact value)" << std::endl;
+
+    bool withinBound = atmosphereCost <= shaderCost * ATMOSPHERE_COST_BOUND && limbCost <= shaderCost * ATMOSPHERE_COST_BOUND;
+    if (!withinBound) {
+        std::cout << "Atmosphere exceeds " << ATMOSPHERE_COST_BOUND * 100.0 << "% of the shader cost" << std::endl;
+    }
+    bool accurate = maximumRelativeError <= ATMOSPHERE_ERROR_BOUND;
+    if (!accurate) {
+        std::cout << "Atmosphere tables are off by more than " << ATMOSPHERE_ERROR_BOUND * 100.0f << "% of the exact value" << std::endl;
+    }
+    return withinBound && accurate ? 0 : 1;
+}
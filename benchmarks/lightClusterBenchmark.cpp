@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "../extensions/lights.h"
+
+// Costo por píxel de las luces con clusters contra recorrer todas las luces, con cada vez más luces más pequeñas (el
+// radio baja con la raíz cúbica de la cantidad, así que cada píxel recibe más o menos las mismas). Termina con error
+// si los clusters cambian el resultado o si su costo por píxel crece más que CLUSTER_COST_GROWTH veces
+
+const double CLUSTER_COST_GROWTH = 2.0;
+const int BUILD_REPETITIONS = 20;
+
+struct SurfacePixel {
+    int x, y;
+    glm::vec3 position;
+};
+
+int main(int argc, char* argv[]) {
+    Uniform uniform{};
+    uniform.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 17.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    uniform.projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+
+    // Un plano en z = 0 que llena la pantalla, visto de frente como los planetas desde la cámara inicial
+    std::vector<SurfacePixel> pixels;
+    for (int y = 1; y < static_cast<int>(SCREEN_HEIGHT); y++) {
+        for (int x = 1; x < static_cast<int>(SCREEN_WIDTH); x++) {
+            float ndcX = (x + 0.5f) * 2.0f / SCREEN_WIDTH - 1.0f;
+            float ndcY = (y + 0.5f) * 2.0f / SCREEN_HEIGHT - 1.0f;
+            pixels.push_back({x, y, glm::vec3(ndcX / uniform.projection[0][0] * 17.0f, ndcY / uniform.projection[1][1] * 17.0f, 0.0f)});
+        }
+    }
+    glm::vec3 normal(0.0f, 0.0f, 1.0f);
+    ColorF surface(0.5f, 0.5f, 0.5f);
+
+    std::mt19937 generator(1500);
+    std::uniform_real_distribution<float> spread(-7.0f, 7.0f);
+    std::uniform_real_distribution<float> height(0.05f, 1.5f);
+    std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+
+    double firstCost = 0.0;
+    double lastCost = 0.0;
+    float maximumError = 0.0f;
+    LightClusters clusters;
+    for (int lightCount : {16, 64, 256, 1024}) {
+        float radius = 1.5f * std::cbrt(16.0f / lightCount);
+        std::vector<PointLight> lights;
+        for (int i = 0; i < lightCount; i++) {
+            lights.push_back({glm::vec3(spread(generator), spread(generator), height(generator)), radius, ColorF(channel(generator), channel(generator), channel(generator))});
+        }
+
+        auto buildStart = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < BUILD_REPETITIONS; repetition++) {
+            buildLightClusters(clusters, lights, uniform);
+        }
+        std::chrono::duration<double, std::milli> buildElapsed = std::chrono::steady_clock::now() - buildStart;
+
+        std::vector<ColorF> clustered(pixels.size());
+        auto clusteredStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pixels.size(); i++) {
+            clustered[i] = shadeClusteredLights(clusters, pixels[i].x, pixels[i].y, pixels[i].position, normal, surface);
+        }
+        std::chrono::duration<double, std::nano> clusteredElapsed = std::chrono::steady_clock::now() - clusteredStart;
+
+        std::vector<ColorF> bruteForce(pixels.size());
+        auto bruteForceStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pixels.size(); i++) {
+            __m128 irradiance = loadColorF(clusters.ambient);
+            for (const PointLight& light : lights) {
+                irradiance = accumulatePointLight(irradiance, light, pixels[i].position, normal);
+            }
+            storeColorF(bruteForce[i], _mm_mul_ps(loadColorF(surface), irradiance));
+        }
+        std::chrono::duration<double, std::nano> bruteForceElapsed = std::chrono::steady_clock::now() - bruteForceStart;
+
+        size_t tested = 0;
+        for (size_t i = 0; i < pixels.size(); i++) {
+            tested += findLightCluster(clusters, pixels[i].x, pixels[i].y, pixels[i].position).count;
+            maximumError = std::max({maximumError, std::abs(clustered[i].r - bruteForce[i].r), std::abs(clustered[i].g - bruteForce[i].g), std::abs(clustered[i].b - bruteForce[i].b)});
+        }
+
+        double clusteredCost = clusteredElapsed.count() / pixels.size();
+        double bruteForceCost = bruteForceElapsed.count() / pixels.size();
+        if (lightCount == 16) {
+            firstCost = clusteredCost;
+        }
+        lastCost = clusteredCost;
+        std::cout << lightCount << " lights: build " << buildElapsed.count() / BUILD_REPETITIONS << " ms, clustered " << clusteredCost
+                  << " ns/pixel (" << static_cast<double>(tested) / pixels.size() << " lights tested), all lights " << bruteForceCost
+                  << " ns/pixel, " << clusters.dropped << " dropped" << std::endl;
+    }
+    std::cout << "Largest difference against all lights: " << maximumError << std::endl;
+
+    bool correct = maximumError < 1e-4f;
+    bool flat = lastCost <= firstCost * CLUSTER_COST_GROWTH;
+    if (!correct) {
+        std::cout << "Clustered lighting differs from shading with every light" << std::endl;
+    }
+    if (!flat) {
+        std::cout << "Clustered cost grew " << lastCost / firstCost << " times" << std::endl;
+    }
+    return correct && flat ? 0 : 1;
+}
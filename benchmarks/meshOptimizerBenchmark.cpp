@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "../extensions/loadOBJFile.h"
+#include "../extensions/meshOptimizer.h"
+
+// ACMR y overdraw de cada modelo de models/ en el orden del archivo (ya soldado) y después de optimizeMesh. Termina
+// con error si algún modelo cambia de triángulos o queda con peor ACMR u overdraw
+
+// Triángulos como tríos de posiciones con la esquina menor primero, para comparar sin importar el orden
+std::vector<std::array<float, 9>> canonicalTriangles(const std::vector<Vertex>& triangleList) {
+    std::vector<std::array<float, 9>> triangles;
+    for (size_t i = 0; i < triangleList.size(); i += 3) {
+        std::array<glm::vec3, 3> corners = {triangleList[i].position, triangleList[i + 1].position, triangleList[i + 2].position};
+        auto less = [](const glm::vec3& a, const glm::vec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+        triangles.push_back({corners[0].x, corners[0].y, corners[0].z, corners[1].x, corners[1].y, corners[1].z, corners[2].x, corners[2].y, corners[2].z});
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int main(int argc, char* argv[]) {
+    const char* directory = argc > 1 ? argv[1] : "../models";
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".obj") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cout << "No models found in " << directory << std::endl;
+        return 1;
+    }
+
+    bool correct = true;
+    for (const std::filesystem::path& path : paths) {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<Face> faces;
+        if (!loadOBJ(path.string().c_str(), vertices, normals, faces)) {
+            return 1;
+        }
+        std::vector<Vertex> triangleList = setupVertexArray(vertices, normals, faces);
+        IndexedMesh mesh = weldVertices(triangleList);
+        MeshStats before = computeMeshStats(mesh);
+        optimizeMesh(mesh);
+        MeshStats after = computeMeshStats(mesh);
+
+        std::cout << path.filename().string() << ": " << faces.size() << " triangles, " << triangleList.size() << " -> " << mesh.vertices.size()
+                  << " vertices, ACMR " << before.acmr << " -> " << after.acmr << ", overdraw " << before.overdraw << " -> " << after.overdraw << std::endl;
+
+        if (canonicalTriangles(expandIndexedMesh(mesh)) != canonicalTriangles(triangleList)) {
+            std::cout << "  the optimized mesh does not draw the same triangles" << std::endl;
+            correct = false;
+        }
+        if (after.acmr > before.acmr) {
+            std::cout << "  ACMR got worse" << std::endl;
+            correct = false;
+        }
+        if (after.overdraw > before.overdraw) {
+            std::cout << "  overdraw got worse" << std::endl;
+            correct = false;
+        }
+    }
+    return correct ? 0 : 1;
+}
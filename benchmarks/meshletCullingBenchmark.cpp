@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../extensions/loadOBJFile.h"
+#include "../extensions/meshletCulling.h"
+
+// Meshlets de cada modelo de models/ y cuántos sobreviven al cono y a la pirámide de la vista con la cámara girando
+// alrededor del modelo. Termina con error si un meshlet descartado tenía algún triángulo de frente dentro de la vista,
+// o si la pirámide de profundidad tapa una zona que tiene algo más lejos que la profundidad probada
+
+const int CAMERA_POSITIONS = 256;
+const int SCREEN_WIDTH_PIXELS = 720;
+const int SCREEN_HEIGHT_PIXELS = 480;
+const int OCCLUSION_QUERIES = 20000;
+
+int main(int argc, char* argv[]) {
+    const char* directory = argc > 1 ? argv[1] : "../models";
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".obj") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cout << "No models found in " << directory << std::endl;
+        return 1;
+    }
+
+    glm::mat4 viewport = glm::mat4(1.0f);
+    viewport = glm::scale(viewport, glm::vec3(SCREEN_WIDTH_PIXELS / 2.0f, SCREEN_HEIGHT_PIXELS / 2.0f, 0.5f));
+    viewport = glm::translate(viewport, glm::vec3(1.0f, 1.0f, 0.5f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(SCREEN_WIDTH_PIXELS) / SCREEN_HEIGHT_PIXELS, 0.1f, 100.0f);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    bool correct = true;
+    for (const std::filesystem::path& path : paths) {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<Face> faces;
+        if (!loadOBJ(path.string().c_str(), vertices, normals, faces)) {
+            return 1;
+        }
+        QuantizedMesh mesh = createQuantizedMesh(setupVertexArray(vertices, normals, faces), true);
+        float extent = glm::length(mesh.scale * 65535.0f);
+        glm::vec3 boxCenter = mesh.origin + mesh.scale * 65535.0f * 0.5f;
+
+        size_t surviving = 0;
+        size_t wrongRejections = 0;
+        for (int camera = 0; camera < CAMERA_POSITIONS; camera++) {
+            glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)));
+            glm::vec3 position = boxCenter + direction * extent * (0.75f + 1.5f * std::abs(unit(random)));
+            // La cámara mira cerca del centro para que parte del modelo quede fuera de la vista
+            glm::vec3 target = boxCenter + glm::vec3(unit(random), unit(random), unit(random)) * extent * 0.5f;
+            Uniform uniform{};
+            uniform.model = glm::mat4(1.0f);
+            uniform.view = glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+            uniform.projection = projection;
+            uniform.viewport = viewport;
+            MeshletView view = createMeshletView(uniform, mesh);
+            glm::mat4 viewProjection = projection * uniform.view;
+
+            for (const Meshlet& meshlet : mesh.meshlets) {
+                if (classifyMeshlet(meshlet, view, nullptr) == MESHLET_VISIBLE) {
+                    surviving++;
+                    continue;
+                }
+                // render no descarta caras de atrás, así que lo que cuenta es la cara geométrica: un triángulo de
+                // frente según su orden de esquinas con algún vértice en la vista no se podía descartar
+                for (Uint32 i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                    glm::vec3 corners[3];
+                    bool inside = false;
+                    for (int corner = 0; corner < 3; corner++) {
+                        corners[corner] = decodePosition(mesh, mesh.vertices[mesh.indices[i + corner]]);
+                        glm::vec4 clip = viewProjection * glm::vec4(corners[corner], 1.0f);
+                        inside |= clip.w > 0.0f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && std::abs(clip.z) <= clip.w;
+                    }
+                    glm::vec3 faceNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    bool facing = glm::dot(faceNormal, corners[0] - view.camera) < 0.0f;
+                    if (inside && facing) {
+                        wrongRejections++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        size_t largest = 0;
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            largest = std::max<size_t>(largest, meshlet.indexCount / 3);
+        }
+        std::cout << path.filename().string() << ": " << mesh.indices.size() / 3 << " triangles in " << mesh.meshlets.size() << " meshlets (largest "
+                  << largest << "), " << 100.0 * surviving / (mesh.meshlets.size() * CAMERA_POSITIONS) << "% survive the cone and frustum tests" << std::endl;
+        if (wrongRejections > 0) {
+            std::cout << "  " << wrongRejections << " rejected meshlets had a visible front-facing triangle" << std::endl;
+            correct = false;
+        }
+        if (largest > MESHLET_TRIANGLES) {
+            std::cout << "  a meshlet is larger than " << MESHLET_TRIANGLES << " triangles" << std::endl;
+            correct = false;
+        }
+    }
+
+    // La pirámide contra la profundidad más lejana de cada zona, buscada píxel por píxel
+    std::vector<double> depth(SCREEN_WIDTH_PIXELS * SCREEN_HEIGHT_PIXELS);
+    for (double& value : depth) {
+        value = std::abs(unit(random));
+    }
+    DepthPyramid pyramid;
+    buildDepthPyramid(pyramid, depth.data(), SCREEN_WIDTH_PIXELS, SCREEN_HEIGHT_PIXELS);
+    size_t wrongOcclusions = 0;
+    for (int query = 0; query < OCCLUSION_QUERIES; query++) {
+        glm::ivec2 minimum(static_cast<int>(random() % SCREEN_WIDTH_PIXELS), static_cast<int>(random() % SCREEN_HEIGHT_PIXELS));
+        glm::ivec2 size(static_cast<int>(random() % 200), static_cast<int>(random() % 200));
+        glm::ivec2 maximum(std::min(SCREEN_WIDTH_PIXELS - 1, minimum.x + size.x), std::min(SCREEN_HEIGHT_PIXELS - 1, minimum.y + size.y));
+        double tested = std::abs(unit(random));
+        double farthest = 0.0;
+        for (int y = minimum.y; y <= maximum.y; y++) {
+            for (int x = minimum.x; x <= maximum.x; x++) {
+                farthest = std::max(farthest, depth[y * SCREEN_WIDTH_PIXELS + x]);
+            }
+        }
+        if (depthPyramidOccludes(pyramid, minimum, maximum, tested) && tested <= farthest) {
+            wrongOcclusions++;
+        }
+    }
+    std::cout << "depth pyramid: " << pyramid.levels.size() << " levels, " << wrongOcclusions << " wrong occlusions in " << OCCLUSION_QUERIES << " queries" << std::endl;
+    if (wrongOcclusions > 0) {
+        correct = false;
+    }
+    return correct ? 0 : 1;
+}
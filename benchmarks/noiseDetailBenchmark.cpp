@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "../extensions/FastNoiseLite.h"
+
+// Media y rango del ruido de cada shader mientras se quitan octavas al alejarse. Con SetFractalOctaves el ruido se
+// vuelve a normalizar con las octavas que quedan y salta al cruzar cada corte; SetFractalDetail tiene que mantener la
+// media y no agrandar el rango. Termina con error si la media se aparta de la del ruido completo o si un paso pequeño
+// del detalle cambia la media o el rango de golpe
+
+const int SAMPLES = 20000;
+const float DETAIL_STEP = 1.0f / 16.0f;
+
+struct NoiseConfiguration {
+    std::string name;
+    FastNoiseLite noise;
+    int octaves;
+    float offset; // Desplazamiento y zoom con los que el shader muestrea la esfera
+    float zoom;
+};
+
+FastNoiseLite fractalNoise(FastNoiseLite::NoiseType type, int seed, float frequency, FastNoiseLite::FractalType fractal, int octaves,
+                           float lacunarity, float gain, float weightedStrength, float pingPongStrength) {
+    FastNoiseLite noise;
+    noise.SetNoiseType(type);
+    noise.SetSeed(seed);
+    noise.SetFrequency(frequency);
+    noise.SetFractalType(fractal);
+    noise.SetFractalOctaves(octaves);
+    noise.SetFractalLacunarity(lacunarity);
+    noise.SetFractalGain(gain);
+    noise.SetFractalWeightedStrength(weightedStrength);
+    noise.SetFractalPingPongStrength(pingPongStrength);
+    return noise;
+}
+
+std::vector<NoiseConfiguration> shaderConfigurations() {
+    std::vector<NoiseConfiguration> configurations;
+    configurations.push_back({"sky", fractalNoise(FastNoiseLite::NoiseType_Perlin, 18340, 0.035f, FastNoiseLite::FractalType_PingPong, 2, 8.0f, 0.9f, 0.8f, 10.0f), 2, 15.0f, 3000.0f});
+    FastNoiseLite sun = fractalNoise(FastNoiseLite::NoiseType_Cellular, 1500, 0.005f, FastNoiseLite::FractalType_PingPong, 2, 10.0f, 1.0f, 0.8f, 10.0f);
+    sun.SetCellularDistanceFunction(FastNoiseLite::CellularDistanceFunction_Euclidean);
+    sun.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance2Add);
+    sun.SetCellularJitter(20);
+    configurations.push_back({"sun", sun, 2, 3000.0f, 5000.0f});
+    configurations.push_back({"earth", fractalNoise(FastNoiseLite::NoiseType_OpenSimplex2, 12000, 0.0002f, FastNoiseLite::FractalType_Ridged, 3, 10.0f, 0.2f, 0.5f, 1.0f), 3, 3000.0f, 5000.0f});
+    configurations.push_back({"mars", fractalNoise(FastNoiseLite::NoiseType_OpenSimplex2, 2050, 0.006f, FastNoiseLite::FractalType_Ridged, 2, 4.0f, 0.8f, 0.8f, 1.0f), 2, 3000.0f, 5000.0f});
+    configurations.push_back({"jupiter", fractalNoise(FastNoiseLite::NoiseType_OpenSimplex2, 1384, 0.005f, FastNoiseLite::FractalType_Ridged, 3, 5.0f, 0.9f, 0.9f, 1.0f), 3, 3000.0f, 5000.0f});
+    configurations.push_back({"uranus", fractalNoise(FastNoiseLite::NoiseType_OpenSimplex2, 2000, 0.009f, FastNoiseLite::FractalType_Ridged, 2, 2.0f, 0.5f, 0.8f, 1.0f), 2, 1000.0f, 3000.0f});
+    return configurations;
+}
+
+struct NoiseStatistics {
+    float mean;
+    float minimum;
+    float maximum;
+};
+
+NoiseStatistics measure(const FastNoiseLite& noise, const std::vector<glm::vec3>& points, const NoiseConfiguration& configuration) {
+    double sum = 0.0;
+    NoiseStatistics statistics{0.0f, 1e9f, -1e9f};
+    for (const glm::vec3& point : points) {
+        float value = noise.GetNoise((point.x + configuration.offset) * configuration.zoom, (point.y + configuration.offset) * configuration.zoom, point.z * configuration.zoom);
+        sum += value;
+        statistics.minimum = std::min(statistics.minimum, value);
+        statistics.maximum = std::max(statistics.maximum, value);
+    }
+    statistics.mean = static_cast<float>(sum / points.size());
+    return statistics;
+}
+
+void printStatistics(const std::string& label, const NoiseStatistics& statistics) {
+    std::cout << "  " << label << ": mean " << statistics.mean << ", range [" << statistics.minimum << ", " << statistics.maximum << "]" << std::endl;
+}
+
+int main() {
+    // Puntos de la esfera unitaria, como fragment.original en los shaders
+    std::mt19937 random(11);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<glm::vec3> points(SAMPLES);
+    for (glm::vec3& point : points) {
+        point = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+    }
+
+    bool correct = true;
+    for (const NoiseConfiguration& configuration : shaderConfigurations()) {
+        NoiseStatistics full = measure(configuration.noise, points, configuration);
+        float fullRange = full.maximum - full.minimum;
+        std::cout << configuration.name << " (" << configuration.octaves << " octaves)" << std::endl;
+        printStatistics("all octaves", full);
+
+        for (int octaves = 1; octaves < configuration.octaves; octaves++) {
+            FastNoiseLite renormalized = configuration.noise;
+            renormalized.SetFractalOctaves(octaves);
+            printStatistics("SetFractalOctaves(" + std::to_string(octaves) + ")", measure(renormalized, points, configuration));
+            FastNoiseLite detail = configuration.noise;
+            detail.SetFractalDetail(static_cast<float>(octaves));
+            printStatistics("SetFractalDetail(" + std::to_string(octaves) + ")", measure(detail, points, configuration));
+        }
+
+        // Recorre el detalle de una octava al total; los saltos se miden contra el rango del ruido completo
+        NoiseStatistics previous{};
+        float largestMeanStep = 0.0f;
+        float largestRangeStep = 0.0f;
+        float largestMeanError = 0.0f;
+        float largestRange = 0.0f;
+        for (float level = 1.0f; level <= configuration.octaves + 0.001f; level += DETAIL_STEP) {
+            FastNoiseLite detail = configuration.noise;
+            detail.SetFractalDetail(level);
+            NoiseStatistics statistics = measure(detail, points, configuration);
+            if (level > 1.0f) {
+                largestMeanStep = std::max(largestMeanStep, std::abs(statistics.mean - previous.mean) / fullRange);
+                largestRangeStep = std::max(largestRangeStep, std::abs((statistics.maximum - statistics.minimum) - (previous.maximum - previous.minimum)) / fullRange);
+            }
+            largestMeanError = std::max(largestMeanError, std::abs(statistics.mean - full.mean) / fullRange);
+            largestRange = std::max(largestRange, (statistics.maximum - statistics.minimum) / fullRange);
+            previous = statistics;
+        }
+        std::cout << "  detail sweep: mean off by " << 100.0f * largestMeanError << "%, largest step " << 100.0f * largestMeanStep
+                  << "% (mean) and " << 100.0f * largestRangeStep << "% (range), range up to " << 100.0f * largestRange << "% of the full one" << std::endl;
+        if (largestMeanError > 0.02f || largestMeanStep > 0.01f || largestRangeStep > 0.1f || largestRange > 1.01f) {
+            std::cout << "  the noise jumps when octaves are removed" << std::endl;
+            correct = false;
+        }
+    }
+    return correct ? 0 : 1;
+}
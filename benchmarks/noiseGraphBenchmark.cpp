@@ -0,0 +1,138 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../extensions/noiseGraph.h"
+#include "../extensions/virtualTexture.h"
+
+// Compara los materiales de materials/ contra los shaders escritos a mano: mismos colores y píxeles por segundo.
+// Termina con error si algún color difiere, si un grafo es más lento que su shader o si un tile virtual sombreado con
+// el grafo no es igual al del shader. Se corre desde la carpeta de compilación, igual que SpaceTravel (los materiales
+// se leen de ../materials)
+
+const int FRAGMENT_COUNT = NOISE_GRAPH_BATCH * 4096;
+const int TIMING_RUNS = 3; // Se queda con la mejor corrida de cada lado para que el resultado no dependa de una pausa
+
+std::vector<Fragment> planetFragments(float radius) {
+    std::mt19937 generator(18340);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<Fragment> fragments(FRAGMENT_COUNT);
+    for (Fragment& fragment : fragments) {
+        glm::vec3 point(distribution(generator), distribution(generator), distribution(generator));
+        fragment.position = glm::ivec2(0, 0);
+        fragment.original = glm::normalize(point) * radius;
+        fragment.z = 0.5f + 0.5f * std::abs(distribution(generator));
+        fragment.footprint = 0.0f;
+    }
+    return fragments;
+}
+
+int main(int argc, char* argv[]) {
+    Uniform uniform{};
+    uniform.animationPhase = 1.5f;
+    std::vector<Fragment> fragments = planetFragments(0.5f);
+
+    struct Material {
+        const char* path;
+        Color (*shader)(Fragment&, const Uniform&);
+    };
+    Material materials[] = {{"../materials/earth.graph", fragmentShaderEarth}, {"../materials/jupiter.graph", fragmentShaderJupiter},
+                            {"../materials/earthFolding.graph", fragmentShaderEarth}};
+
+    bool identical = true;
+    bool faster = true;
+    for (const Material& material : materials) {
+        NoiseGraph graph;
+        if (!loadNoiseGraph(material.path, uniform.animationPhase, graph)) {
+            std::cout << "Failed to load " << material.path << std::endl;
+            return 1;
+        }
+
+        std::vector<Color> graphColors(fragments.size());
+        NoiseGraphContext context;
+        createNoiseGraphContext(context, graph);
+        NoiseGraphBatch batch;
+        double graphSeconds = 1e9;
+        for (int run = 0; run < TIMING_RUNS; run++) {
+            auto graphStart = std::chrono::steady_clock::now();
+            for (size_t start = 0; start < fragments.size(); start += NOISE_GRAPH_BATCH) {
+                batch.count = NOISE_GRAPH_BATCH;
+                for (int lane = 0; lane < NOISE_GRAPH_BATCH; lane++) {
+                    const Fragment& fragment = fragments[start + lane];
+                    batch.x[lane] = fragment.original.x;
+                    batch.y[lane] = fragment.original.y;
+                    batch.z[lane] = fragment.original.z;
+                    batch.depth[lane] = fragment.z;
+                    batch.footprint[lane] = fragment.footprint;
+                }
+                evaluateNoiseGraph(context, batch, &graphColors[start]);
+            }
+            graphSeconds = std::min(graphSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - graphStart).count());
+        }
+
+        std::vector<Color> shaderColors(fragments.size());
+        double shaderSeconds = 1e9;
+        for (int run = 0; run < TIMING_RUNS; run++) {
+            auto shaderStart = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < fragments.size(); i++) {
+                Fragment fragment = fragments[i];
+                shaderColors[i] = material.shader(fragment, uniform);
+            }
+            shaderSeconds = std::min(shaderSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - shaderStart).count());
+        }
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < fragments.size(); i++) {
+            const Color& expected = shaderColors[i];
+            const Color& actual = graphColors[i];
+            if (expected.r != actual.r || expected.g != actual.g || expected.b != actual.b || expected.a != actual.a) {
+                mismatches++;
+            }
+        }
+        identical = identical && mismatches == 0;
+        bool slower = graphSeconds > shaderSeconds;
+        faster = faster && !slower;
+
+        // Un tile del nivel 4 sombreado por el grafo, como lo genera el TileStreamer, contra el mismo tile con el shader
+        VirtualTexture shaderTexture;
+        shaderTexture.shader = material.shader;
+        shaderTexture.uniform = uniform;
+        shaderTexture.radius = 0.5f;
+        VirtualTexture graphTexture;
+        graphTexture.shader = material.shader;
+        graphTexture.graph = &graph;
+        graphTexture.uniform = uniform;
+        graphTexture.radius = 0.5f;
+        Uint64 key = virtualTileKey(1, 4, 5, 9);
+        size_t tileMismatches = 0;
+        std::vector<Uint32> shaderTile = generateVirtualTile(shaderTexture, key);
+        std::vector<Uint32> graphTile = generateVirtualTile(graphTexture, key);
+        for (size_t i = 0; i < shaderTile.size(); i++) {
+            tileMismatches += shaderTile[i] != graphTile[i];
+        }
+        identical = identical && tileMismatches == 0;
+
+        std::cout << material.path << ": " << graph.nodes.size() << " nodes (" << graph.foldedNodes << " folded, "
+                  << graph.sharedNodes << " shared, " << graph.removedNodes << " removed)" << std::endl;
+        std::cout << "  Mismatches against the shader: " << mismatches << std::endl;
+        std::cout << "  Mismatches in a virtual tile: " << tileMismatches << std::endl;
+        std::cout << "  Shader: " << fragments.size() / shaderSeconds << " pixels/s" << std::endl;
+        std::cout << "  Graph:  " << fragments.size() / graphSeconds << " pixels/s" << std::endl;
+        if (slower) {
+            std::cout << "  The graph is slower than the shader" << std::endl;
+        }
+    }
+
+    // earthFolding.graph es earth.graph con constantes derivadas y nodos repetidos: optimizado tiene que quedar igual
+    NoiseGraph reference;
+    NoiseGraph expanded;
+    if (!loadNoiseGraph("../materials/earth.graph", uniform.animationPhase, reference) || !loadNoiseGraph("../materials/earthFolding.graph", uniform.animationPhase, expanded)) {
+        return 1;
+    }
+    bool optimized = expanded.foldedNodes > 0 && expanded.sharedNodes > 0 && expanded.nodes.size() == reference.nodes.size();
+    if (!optimized) {
+        std::cout << "earthFolding.graph was not reduced to the " << reference.nodes.size() << " nodes of earth.graph" << std::endl;
+    }
+    return identical && faster && optimized ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include "../extensions/pixels.h"
+
+// Compara las operaciones en bloque de pixels.h con una versión escalar canal por canal, como hacía Color antes de
+// empaquetarse, y mide cuántos píxeles por segundo hace cada una. Termina con error si algún píxel difiere
+
+const int PIXELS = 1 << 16;
+const int REPETITIONS = 200;
+
+Uint8 channel(Uint32 pixel, int c) {
+    return static_cast<Uint8>(pixel >> (8 * c));
+}
+
+Uint32 addScalar(Uint32 a, Uint32 b) {
+    Uint32 sum = 0;
+    for (int c = 0; c < 4; c++) {
+        sum |= static_cast<Uint32>(std::min(255, channel(a, c) + channel(b, c))) << (8 * c);
+    }
+    return sum;
+}
+
+Uint32 scaleScalar(Uint32 pixel, float factor) {
+    Uint32 scaled = 0;
+    for (int c = 0; c < 4; c++) {
+        scaled |= static_cast<Uint32>(static_cast<Uint8>(std::clamp(channel(pixel, c) * factor, 0.0f, 255.0f))) << (8 * c);
+    }
+    return scaled;
+}
+
+Uint32 interpolateScalar(float u, float v, float w, Uint32 a, Uint32 b, Uint32 c) {
+    Uint32 interpolated = 0;
+    for (int i = 0; i < 4; i++) {
+        float value = u * channel(a, i) + v * channel(b, i) + w * channel(c, i);
+        interpolated |= static_cast<Uint32>(static_cast<Uint8>(std::clamp(value, 0.0f, 255.0f))) << (8 * i);
+    }
+    return interpolated;
+}
+
+template <typename Function>
+double pixelsPerSecond(Function operation) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPETITIONS; r++) {
+        operation();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(PIXELS) * REPETITIONS / seconds;
+}
+
+size_t mismatches(const std::vector<Uint32>& expected, const std::vector<Uint32>& actual) {
+    size_t count = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        count += expected[i] != actual[i];
+    }
+    return count;
+}
+
+int main() {
+    std::mt19937 random(3);
+    std::vector<Uint32> a(PIXELS), b(PIXELS);
+    std::vector<float> u(PIXELS), v(PIXELS), w(PIXELS);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < PIXELS; i++) {
+        a[i] = random();
+        b[i] = random();
+        u[i] = unit(random);
+        v[i] = unit(random) * (1.0f - u[i]);
+        w[i] = 1.0f - u[i] - v[i];
+    }
+    Uint32 first = a[0], second = a[1], third = a[2];
+    // Factores que atenúan, aumentan y saturan
+    const float factors[] = {0.0f, 0.37f, 1.0f, 1.9f, 300.0f};
+
+    std::vector<Uint32> expected(PIXELS), actual(PIXELS);
+    bool correct = true;
+    auto verify = [&](const std::string& name, size_t wrong) {
+        if (wrong > 0) {
+            std::cout << "  " << name << ": " << wrong << " pixels differ from the scalar version" << std::endl;
+            correct = false;
+        }
+    };
+    auto report = [&](const std::string& name, size_t wrong, double scalar, double packed) {
+        std::cout << name << ": scalar " << scalar / 1e6 << "M px/s, packed " << packed / 1e6 << "M px/s" << std::endl;
+        verify(name, wrong);
+    };
+
+    double scalar = pixelsPerSecond([&]() {
+        for (int i = 0; i < PIXELS; i++) {
+            expected[i] = addScalar(a[i], b[i]);
+        }
+    });
+    double packed = pixelsPerSecond([&]() { addPixelRowSaturate(a.data(), b.data(), actual.data(), PIXELS); });
+    report("saturating add", mismatches(expected, actual), scalar, packed);
+    // Filas que no son múltiplo de 8 pasan por los bloques de 4 y por el resto escalar; lo que sigue no se toca
+    std::fill(actual.begin(), actual.end(), 0u);
+    addPixelRowSaturate(a.data(), b.data(), actual.data(), PIXELS - 3);
+    size_t written = 0;
+    for (int i = PIXELS - 3; i < PIXELS; i++) {
+        written += actual[i] != 0;
+        actual[i] = expected[i];
+    }
+    verify("saturating add, row of " + std::to_string(PIXELS - 3), written + mismatches(expected, actual));
+
+    for (float factor : factors) {
+        scalar = pixelsPerSecond([&]() {
+            for (int i = 0; i < PIXELS; i++) {
+                expected[i] = scaleScalar(a[i], factor);
+            }
+        });
+        packed = pixelsPerSecond([&]() { scalePixelRowSaturate(a.data(), factor, actual.data(), PIXELS); });
+        report("saturating scale by " + std::to_string(factor), mismatches(expected, actual), scalar, packed);
+    }
+
+    scalar = pixelsPerSecond([&]() {
+        for (int i = 0; i < PIXELS; i++) {
+            expected[i] = interpolateScalar(u[i], v[i], w[i], first, second, third);
+        }
+    });
+    packed = pixelsPerSecond([&]() { interpolatePixelRow(u.data(), v.data(), w.data(), first, second, third, actual.data(), PIXELS); });
+    report("barycentric interpolation", mismatches(expected, actual), scalar, packed);
+    for (int i = 0; i < PIXELS; i++) {
+        actual[i] = interpolatePixel(u[i], v[i], w[i], first, second, third);
+    }
+    verify("barycentric interpolation, one pixel", mismatches(expected, actual));
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "../extensions/loadOBJFile.h"
+#include "../extensions/quantizedMesh.h"
+#include "../extensions/shaders.h"
+
+// Memoria de cada modelo de models/ como lista de triángulos, como malla cuantizada y en disco, y tiempo de la etapa
+// de vértices con cada formato. Termina con error si la memoria no baja al menos MINIMUM_MEMORY_RATIO veces, si la
+// cuantización se aleja más de medio paso o si la malla no vuelve igual del archivo
+
+const double MINIMUM_MEMORY_RATIO = 3.0;
+// Medio paso de cuantización más el redondeo de origin + q * scale en float
+const float MAXIMUM_POSITION_ERROR = 0.51f;
+const float MAXIMUM_NORMAL_ERROR = 0.001f;
+const int TRANSFORM_REPETITIONS = 200;
+
+int main(int argc, char* argv[]) {
+    const char* directory = argc > 1 ? argv[1] : "../models";
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".obj") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    Uniform uniform{};
+    uniform.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 17.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    uniform.projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    uniform.model = glm::mat4(1.0f);
+
+    bool correct = !paths.empty();
+    for (const std::filesystem::path& path : paths) {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<Face> faces;
+        if (!loadOBJ(path.string().c_str(), vertices, normals, faces)) {
+            return 1;
+        }
+        std::vector<Vertex> triangleList = setupVertexArray(vertices, normals, faces);
+        IndexedMesh indexed = weldVertices(triangleList);
+        optimizeMesh(indexed);
+        QuantizedMesh mesh = quantizeMesh(indexed);
+
+        float positionError = 0.0f, normalError = 0.0f;
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            Vertex decoded = decodeVertex(mesh, i);
+            glm::vec3 steps = glm::abs(decoded.position - indexed.vertices[i].position) / glm::max(mesh.scale, glm::vec3(1e-12f));
+            positionError = std::max({positionError, steps.x, steps.y, steps.z});
+            normalError = std::max(normalError, 1.0f - glm::dot(decoded.normal, glm::normalize(indexed.vertices[i].normal)));
+        }
+
+        std::string stored = (std::filesystem::temp_directory_path() / (path.stem().string() + ".qmesh")).string();
+        QuantizedMesh loaded;
+        bool roundTrip = saveQuantizedMesh(stored, mesh) && loadQuantizedMesh(stored, loaded) && loaded.indices == mesh.indices && loaded.meshlets.size() == mesh.meshlets.size()
+                         && std::memcmp(loaded.meshlets.data(), mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet)) == 0
+                         && loaded.vertices.size() == mesh.vertices.size()
+                         && std::equal(loaded.vertices.begin(), loaded.vertices.end(), mesh.vertices.begin(), [](const QuantizedVertex& a, const QuantizedVertex& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; });
+        size_t storedBytes = std::filesystem::file_size(stored);
+        std::remove(stored.c_str());
+
+        // La etapa de vértices de antes recorría la lista de triángulos; la de ahora decodifica cada vértice único
+        std::vector<Vertex> transformed(triangleList.size());
+        auto listStart = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < TRANSFORM_REPETITIONS; repetition++) {
+            for (size_t i = 0; i < triangleList.size(); i++) {
+                transformed[i] = vertexShader(triangleList[i], uniform);
+            }
+        }
+        std::chrono::duration<double, std::micro> listElapsed = std::chrono::steady_clock::now() - listStart;
+        auto quantizedStart = std::chrono::steady_clock::now();
+        for (int repetition = 0; repetition < TRANSFORM_REPETITIONS; repetition++) {
+            for (size_t i = 0; i < mesh.vertices.size(); i++) {
+                transformed[i] = vertexShader(decodeVertex(mesh, i), uniform);
+            }
+        }
+        std::chrono::duration<double, std::micro> quantizedElapsed = std::chrono::steady_clock::now() - quantizedStart;
+
+        size_t listBytes = triangleList.size() * sizeof(Vertex);
+        double ratio = static_cast<double>(listBytes) / quantizedMeshBytes(mesh);
+        std::cout << path.filename().string() << ": triangle list " << listBytes << " bytes, quantized " << quantizedMeshBytes(mesh) << " bytes ("
+                  << ratio << "x), stored " << storedBytes << " bytes; vertex stage " << listElapsed.count() / TRANSFORM_REPETITIONS << " -> "
+                  << quantizedElapsed.count() / TRANSFORM_REPETITIONS << " us; position error " << positionError << " steps, normal error "
+                  << normalError << std::endl;
+
+        if (ratio < MINIMUM_MEMORY_RATIO) {
+            std::cout << "  memory dropped less than " << MINIMUM_MEMORY_RATIO << " times" << std::endl;
+            correct = false;
+        }
+        if (positionError > MAXIMUM_POSITION_ERROR || normalError > MAXIMUM_NORMAL_ERROR) {
+            std::cout << "  quantization error is too large" << std::endl;
+            correct = false;
+        }
+        if (!roundTrip) {
+            std::cout << "  the stored mesh does not load back identical" << std::endl;
+            correct = false;
+        }
+    }
+    return correct ? 0 : 1;
+}
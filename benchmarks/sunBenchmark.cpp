@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "../extensions/shaders.h"
+
+// Mide píxeles por segundo del shader del sol antes y después de la búsqueda celular con SSE2
+// Antes: búsqueda escalar y dos llamadas a GetNoise por píxel (la segunda era el ruido de llamaradas sin usar)
+
+const int SUN_DIAMETER = 256;
+
+std::vector<glm::vec3> sunPixels() {
+    std::vector<glm::vec3> pixels;
+    float radius = 0.5f;
+    for (int y = 0; y < SUN_DIAMETER; y++) {
+        for (int x = 0; x < SUN_DIAMETER; x++) {
+            float px = ((x + 0.5f) / SUN_DIAMETER * 2.0f - 1.0f) * radius;
+            float py = ((y + 0.5f) / SUN_DIAMETER * 2.0f - 1.0f) * radius;
+            float squared = radius * radius - px * px - py * py;
+            if (squared >= 0.0f) {
+                pixels.push_back(glm::vec3(px, py, std::sqrt(squared)));
+            }
+        }
+    }
+    return pixels;
+}
+
+template <typename Function>
+double pixelsPerSecond(const std::vector<glm::vec3>& pixels, int repetitions, Function shadePixel) {
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        for (const glm::vec3& pixel : pixels) {
+            shadePixel(pixel);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return pixels.size() * repetitions / elapsed.count();
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = argc > 1 ? std::atoi(argv[1]) : 4;
+
+    Uniform uniform{};
+    uniform.animationPhase = 1.5f;
+    std::vector<glm::vec3> pixels = sunPixels();
+
+    float ox = 3000.0f;
+    float oy = 3000.0f;
+    float zoom = 5000.0f;
+    float oxf = 6000.0f;
+    float oyf = 6000.0f;
+    float zoomf = 8000.0f;
+
+    FastNoiseLite scalarNoise = createSunNoise(uniform);
+    scalarNoise.SetCellularSIMD(false);
+    FastNoiseLite simdNoise = createSunNoise(uniform);
+
+    size_t mismatches = 0;
+    for (const glm::vec3& pixel : pixels) {
+        float scalarValue = scalarNoise.GetNoise((pixel.x + ox) * zoom, (pixel.y + oy) * zoom, pixel.z * zoom);
+        float simdValue = simdNoise.GetNoise((pixel.x + ox) * zoom, (pixel.y + oy) * zoom, pixel.z * zoom);
+        if (std::memcmp(&scalarValue, &simdValue, sizeof(float)) != 0) {
+            mismatches++;
+        }
+    }
+
+    volatile float sink = 0.0f;
+    double before = pixelsPerSecond(pixels, repetitions, [&](const glm::vec3& pixel) {
+        float noiseValue = std::abs(scalarNoise.GetNoise((pixel.x + ox) * zoom, (pixel.y + oy) * zoom, pixel.z * zoom));
+        float noiseValuef = std::abs(scalarNoise.GetNoise((pixel.x + oxf) * zoomf, (pixel.y + oyf) * zoomf, pixel.z * zoomf));
+        sink = sink + noiseValue + noiseValuef;
+    });
+    double scalarShader = pixelsPerSecond(pixels, repetitions, [&](const glm::vec3& pixel) {
+        sink = sink + std::abs(scalarNoise.GetNoise((pixel.x + ox) * zoom, (pixel.y + oy) * zoom, pixel.z * zoom));
+    });
+    double after = pixelsPerSecond(pixels, repetitions, [&](const glm::vec3& pixel) {
+        Fragment fragment;
+        fragment.position = glm::ivec2(0, 0);
+        fragment.z = 1.0f;
+        fragment.original = pixel;
+        Color color = fragmentShaderSun(fragment, uniform);
+        sink = sink + color.g;
+    });
+
+    std::cout << "Sun pixels: " << pixels.size() << " x " << repetitions << std::endl;
+    std::cout << "Noise mismatches (scalar vs SSE2): " << mismatches << std::endl;
+    std::cout << "Before (scalar search, flare noise):  " << before << " pixels/s" << std::endl;
+    std::cout << "Scalar search, one noise call:        " << scalarShader << " pixels/s" << std::endl;
+    std::cout << "After (fragmentShaderSun, SSE2):      " << after << " pixels/s" << std::endl;
+    std::cout << "Speedup: " << after / before << "x" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
@@ -51,6 +51,13 @@
 #define FASTNOISELITE_H
 
 #include <cmath>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FNL_CELLULAR_SSE2
+#include <emmintrin.h>
+#endif
 
 class FastNoiseLite
 {
@@ -127,10 +134,14 @@ public:
         mPingPongStrength = 2.0f;
 
         mFractalBounding = 1 / 1.75f;
+        mFractalDetail = 1e9f;
+        mOctaveMean = 0.0f;
+        mOctaveWeightMean = 1.0f;
 
         mCellularDistanceFunction = CellularDistanceFunction_EuclideanSq;
         mCellularReturnType = CellularReturnType_Distance;
         mCellularJitterModifier = 1.0f;
+        mCellularSIMD = true;
 
         mDomainWarpType = DomainWarpType_OpenSimplex2;
         mWarpTransformType3D = TransformType3D_DefaultOpenSimplex2;
@@ -200,6 +211,26 @@ public:
         CalculateFractalBounding();
     }
 
+    /// <summary>
+    /// Limits how many of the fractal octaves are evaluated, for removing detail smaller than a pixel
+    /// </summary>
+    /// <remarks>
+    /// Unlike SetFractalOctaves this keeps the bounding of the full octave count, so the octaves that
+    /// remain are not rescaled. A fractional count fades the last octave out, and the part of every
+    /// octave that is not evaluated is replaced by that octave's mean, so the mean of the output does
+    /// not change either. Call it after the rest of the settings: the means are measured once per
+    /// noise configuration and thread.
+    /// Default: no limit
+    /// </remarks>
+    void SetFractalDetail(float octaves)
+    {
+        mFractalDetail = octaves;
+        if (octaves < mOctaves)
+        {
+            CalculateOctaveMeans();
+        }
+    }
+
     /// <summary>
     /// Sets octave lacunarity for all fractal noise types
     /// </summary>
@@ -263,6 +294,15 @@ public:
     /// </remarks> 
     void SetCellularJitter(float cellularJitter) { mCellularJitterModifier = cellularJitter; }
 
+    /// <summary>
+    /// Enables the SSE2 neighbour search for 3D cellular noise with Euclidean distance functions
+    /// </summary>
+    /// <remarks>
+    /// Default: true
+    /// Output is identical to the scalar search, this only exists to compare both
+    /// </remarks>
+    void SetCellularSIMD(bool cellularSIMD) { mCellularSIMD = cellularSIMD; }
+
 
     /// <summary>
     /// Sets the warp algorithm when using DomainWarp(...)
@@ -338,6 +378,82 @@ public:
         }
     }
 
+    /// <summary>
+    /// 3D noise at four positions using current settings
+    /// </summary>
+    /// <remarks>
+    /// Output is identical to four GetNoise calls. OpenSimplex2 evaluates the four points
+    /// together with SSE2; fractal sums stay per point, other noise types fall back to GetNoise
+    /// </remarks>
+    void GetNoise4(const float* x, const float* y, const float* z, float* out) const
+    {
+#ifdef FNL_CELLULAR_SSE2
+        if (mNoiseType == NoiseType_OpenSimplex2)
+        {
+            float tx[4], ty[4], tz[4];
+            for (int lane = 0; lane < 4; lane++)
+            {
+                tx[lane] = x[lane];
+                ty[lane] = y[lane];
+                tz[lane] = z[lane];
+                TransformNoiseCoordinate(tx[lane], ty[lane], tz[lane]);
+            }
+            switch (mFractalType)
+            {
+            default:
+                SingleOpenSimplex2SSE2(mSeed, tx, ty, tz, out);
+                break;
+            case FractalType_FBm:
+            case FractalType_Ridged:
+            case FractalType_PingPong:
+                GenFractalOpenSimplex2SSE2(tx, ty, tz, out);
+                break;
+            }
+            return;
+        }
+#endif
+        for (int lane = 0; lane < 4; lane++)
+        {
+            out[lane] = GetNoise(x[lane], y[lane], z[lane]);
+        }
+    }
+
+    /// <summary>
+    /// 3D noise at given position using current settings, together with its gradient
+    /// with respect to the input position
+    /// </summary>
+    /// <remarks>
+    /// OpenSimplex2 and Perlin return an analytic gradient from the same evaluation,
+    /// other noise types fall back to central differences.
+    /// Fractal weighted strength is treated as locally constant when differentiating.
+    /// </remarks>
+    /// <returns>
+    /// Noise output bounded between -1...1
+    /// </returns>
+    template <typename FNfloat>
+    float GetNoiseWithGradient(FNfloat x, FNfloat y, FNfloat z, float& dx, float& dy, float& dz) const
+    {
+        Arguments_must_be_floating_point_values<FNfloat>();
+
+        TransformNoiseCoordinate(x, y, z);
+
+        float value;
+        switch (mFractalType)
+        {
+        default:
+            value = GenNoiseSingleGradient(mSeed, x, y, z, dx, dy, dz);
+            break;
+        case FractalType_FBm:
+        case FractalType_Ridged:
+        case FractalType_PingPong:
+            value = GenFractalGradient(x, y, z, dx, dy, dz);
+            break;
+        }
+
+        TransformNoiseGradient(dx, dy, dz);
+        return value;
+    }
+
 
     /// <summary>
     /// 2D warps the input position using current domain warp settings
@@ -419,10 +535,14 @@ private:
     float mPingPongStrength;
 
     float mFractalBounding;
+    float mFractalDetail;
+    float mOctaveMean;       // Mean contribution of one octave before its amplitude
+    float mOctaveWeightMean; // Mean factor the weighted strength applies to the next amplitude
 
     CellularDistanceFunction mCellularDistanceFunction;
     CellularReturnType mCellularReturnType;
     float mCellularJitterModifier;
+    bool mCellularSIMD;
 
     DomainWarpType mDomainWarpType;
     TransformType3D mWarpTransformType3D;
@@ -483,6 +603,106 @@ private:
         mFractalBounding = 1 / ampFractal;
     }
 
+    // Ridged: 1 - 2|n| weighted by 1 - |n|; PingPong: 2 (p - 0.5) weighted by p; FBm: n weighted by (n + 1) / 2
+    void FractalOctaveTerm(float single, float& term, float& weight) const
+    {
+        float noise;
+        switch (mFractalType)
+        {
+        case FractalType_Ridged:
+            noise = FastAbs(single);
+            term = noise * -2 + 1;
+            weight = Lerp(1.0f, 1 - noise, mWeightedStrength);
+            break;
+        case FractalType_PingPong:
+            noise = PingPong((single + 1) * mPingPongStrength);
+            term = (noise - 0.5f) * 2;
+            weight = Lerp(1.0f, noise, mWeightedStrength);
+            break;
+        default:
+            term = single;
+            weight = Lerp(1.0f, (single + 1) * 0.5f, mWeightedStrength);
+            break;
+        }
+    }
+
+    void CalculateOctaveMeans()
+    {
+        struct OctaveMeans
+        {
+            NoiseType noiseType;
+            FractalType fractalType;
+            CellularDistanceFunction distanceFunction;
+            CellularReturnType returnType;
+            float jitter;
+            float pingPongStrength;
+            float weightedStrength;
+            int seed;
+            float octaveMean;
+            float weightMean;
+        };
+        static thread_local std::vector<OctaveMeans> cache;
+        for (const OctaveMeans& entry : cache)
+        {
+            if (entry.noiseType == mNoiseType && entry.fractalType == mFractalType && entry.distanceFunction == mCellularDistanceFunction &&
+                entry.returnType == mCellularReturnType && entry.jitter == mCellularJitterModifier && entry.pingPongStrength == mPingPongStrength &&
+                entry.weightedStrength == mWeightedStrength && entry.seed == mSeed)
+            {
+                mOctaveMean = entry.octaveMean;
+                mOctaveWeightMean = entry.weightMean;
+                return;
+            }
+        }
+
+        // Points scattered over a thousand noise cells with a fixed LCG, so every thread measures the same means
+        const int samples = 4096;
+        unsigned int state = 0x9E3779B9u;
+        auto next = [&state]() { state = state * 1664525u + 1013904223u; return (state >> 8) * (1000.0f / 16777216.0f); };
+        double termSum = 0, weightSum = 0;
+        for (int i = 0; i < samples; i++)
+        {
+            float x = next(), y = next(), z = next();
+            float term, weight;
+            FractalOctaveTerm(GenNoiseSingle(mSeed, x, y, z), term, weight);
+            termSum += term;
+            weightSum += weight;
+        }
+        mOctaveMean = (float)(termSum / samples);
+        mOctaveWeightMean = (float)(weightSum / samples);
+        cache.push_back({ mNoiseType, mFractalType, mCellularDistanceFunction, mCellularReturnType, mCellularJitterModifier,
+                          mPingPongStrength, mWeightedStrength, mSeed, mOctaveMean, mOctaveWeightMean });
+    }
+
+    // Octave i of the loop: 1 when it is evaluated in full, 0 when only its mean is left
+    float OctaveFade(int i) const { return FastMin(mFractalDetail - i, 1.0f); }
+
+    // Mean of the octaves from i on, starting at amplitude amp
+    float FractalRemainder(float amp, int i) const
+    {
+        float sum = 0;
+        for (; i < mOctaves; i++)
+        {
+            sum += mOctaveMean * amp;
+            amp *= mOctaveWeightMean * mGain;
+        }
+        return sum;
+    }
+
+    // Accumulates one evaluated octave, blending it toward its mean when it is fading out
+    void AddFractalOctave(float single, int i, float& sum, float& amp) const
+    {
+        float term, weight;
+        FractalOctaveTerm(single, term, weight);
+        float fade = OctaveFade(i);
+        if (fade < 1)
+        {
+            term = mOctaveMean + (term - mOctaveMean) * fade;
+            weight = mOctaveWeightMean + (weight - mOctaveWeightMean) * fade;
+        }
+        sum += term * amp;
+        amp *= weight;
+    }
+
     // Hashing
     static const int PrimeX = 501125321;
     static const int PrimeY = 1136930381;
@@ -658,6 +878,75 @@ private:
     }
 
 
+    template <typename FNfloat>
+    float GenNoiseSingleGradient(int seed, FNfloat x, FNfloat y, FNfloat z, float& dx, float& dy, float& dz) const
+    {
+        switch (mNoiseType)
+        {
+        case NoiseType_OpenSimplex2:
+            return SingleOpenSimplex2Gradient(seed, x, y, z, dx, dy, dz);
+        case NoiseType_Perlin:
+            return SinglePerlinGradient(seed, x, y, z, dx, dy, dz);
+        default:
+            {
+                const FNfloat h = (FNfloat)0.001;
+                dx = (GenNoiseSingle(seed, x + h, y, z) - GenNoiseSingle(seed, x - h, y, z)) / (float)(2 * h);
+                dy = (GenNoiseSingle(seed, x, y + h, z) - GenNoiseSingle(seed, x, y - h, z)) / (float)(2 * h);
+                dz = (GenNoiseSingle(seed, x, y, z + h) - GenNoiseSingle(seed, x, y, z - h)) / (float)(2 * h);
+                return GenNoiseSingle(seed, x, y, z);
+            }
+        }
+    }
+
+
+    // Noise Gradient Transforms (chain rule through TransformNoiseCoordinate)
+
+    void TransformNoiseGradient(float& dx, float& dy, float& dz) const
+    {
+        float gx = dx;
+        float gy = dy;
+        float gz = dz;
+
+        switch (mTransformType3D)
+        {
+        case TransformType3D_ImproveXYPlanes:
+            {
+                const float S = -0.211324865405187f;
+                const float C = 0.577350269189626f;
+                dx = (1 + S) * gx + S * gy + C * gz;
+                dy = S * gx + (1 + S) * gy + C * gz;
+                dz = C * (gz - gx - gy);
+            }
+            break;
+        case TransformType3D_ImproveXZPlanes:
+            {
+                const float S = -0.211324865405187f;
+                const float C = 0.577350269189626f;
+                dx = (1 + S) * gx + C * gy + S * gz;
+                dy = C * (gy - gx - gz);
+                dz = S * gx + C * gy + (1 + S) * gz;
+            }
+            break;
+        case TransformType3D_DefaultOpenSimplex2:
+            {
+                // The rotation matrix is symmetric, so its transpose is itself
+                const float R3 = (float)(2.0 / 3.0);
+                float r = (gx + gy + gz) * R3;
+                dx = r - gx;
+                dy = r - gy;
+                dz = r - gz;
+            }
+            break;
+        default:
+            break;
+        }
+
+        dx *= mFrequency;
+        dy *= mFrequency;
+        dz *= mFrequency;
+    }
+
+
     // Noise Coordinate Transforms (frequency, and possible skew or rotation)
 
     template <typename FNfloat>
@@ -850,9 +1139,21 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = GenNoiseSingle(seed++, x, y);
-            sum += noise * amp;
-            amp *= Lerp(1.0f, FastMin(noise + 1, 2) * 0.5f, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y), i, sum, amp);
+            }
+            else
+            {
+                float noise = GenNoiseSingle(seed++, x, y);
+                sum += noise * amp;
+                amp *= Lerp(1.0f, FastMin(noise + 1, 2) * 0.5f, mWeightedStrength);
+            }
 
             x *= mLacunarity;
             y *= mLacunarity;
@@ -871,9 +1172,21 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = GenNoiseSingle(seed++, x, y, z);
-            sum += noise * amp;
-            amp *= Lerp(1.0f, (noise + 1) * 0.5f, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y, z), i, sum, amp);
+            }
+            else
+            {
+                float noise = GenNoiseSingle(seed++, x, y, z);
+                sum += noise * amp;
+                amp *= Lerp(1.0f, (noise + 1) * 0.5f, mWeightedStrength);
+            }
 
             x *= mLacunarity;
             y *= mLacunarity;
@@ -896,9 +1209,21 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = FastAbs(GenNoiseSingle(seed++, x, y));
-            sum += (noise * -2 + 1) * amp;
-            amp *= Lerp(1.0f, 1 - noise, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y), i, sum, amp);
+            }
+            else
+            {
+                float noise = FastAbs(GenNoiseSingle(seed++, x, y));
+                sum += (noise * -2 + 1) * amp;
+                amp *= Lerp(1.0f, 1 - noise, mWeightedStrength);
+            }
 
             x *= mLacunarity;
             y *= mLacunarity;
@@ -917,9 +1242,21 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = FastAbs(GenNoiseSingle(seed++, x, y, z));
-            sum += (noise * -2 + 1) * amp;
-            amp *= Lerp(1.0f, 1 - noise, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y, z), i, sum, amp);
+            }
+            else
+            {
+                float noise = FastAbs(GenNoiseSingle(seed++, x, y, z));
+                sum += (noise * -2 + 1) * amp;
+                amp *= Lerp(1.0f, 1 - noise, mWeightedStrength);
+            }
 
             x *= mLacunarity;
             y *= mLacunarity;
@@ -942,9 +1279,21 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = PingPong((GenNoiseSingle(seed++, x, y) + 1) * mPingPongStrength);
-            sum += (noise - 0.5f) * 2 * amp;
-            amp *= Lerp(1.0f, noise, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y), i, sum, amp);
+            }
+            else
+            {
+                float noise = PingPong((GenNoiseSingle(seed++, x, y) + 1) * mPingPongStrength);
+                sum += (noise - 0.5f) * 2 * amp;
+                amp *= Lerp(1.0f, noise, mWeightedStrength);
+            }
 
             x *= mLacunarity;
             y *= mLacunarity;
@@ -963,13 +1312,90 @@ private:
 
         for (int i = 0; i < mOctaves; i++)
         {
-            float noise = PingPong((GenNoiseSingle(seed++, x, y, z) + 1) * mPingPongStrength);
-            sum += (noise - 0.5f) * 2 * amp;
-            amp *= Lerp(1.0f, noise, mWeightedStrength);
+            if (i + 1 > mFractalDetail)
+            {
+                if (i >= mFractalDetail)
+                {
+                    sum += FractalRemainder(amp, i);
+                    break;
+                }
+                AddFractalOctave(GenNoiseSingle(seed++, x, y, z), i, sum, amp);
+            }
+            else
+            {
+                float noise = PingPong((GenNoiseSingle(seed++, x, y, z) + 1) * mPingPongStrength);
+                sum += (noise - 0.5f) * 2 * amp;
+                amp *= Lerp(1.0f, noise, mWeightedStrength);
+            }
+
+            x *= mLacunarity;
+            y *= mLacunarity;
+            z *= mLacunarity;
+            amp *= mGain;
+        }
+
+        return sum;
+    }
+
+
+    // Fractal Gradient (FBm, Ridged and PingPong share the same octave loop)
+
+    template <typename FNfloat>
+    float GenFractalGradient(FNfloat x, FNfloat y, FNfloat z, float& dx, float& dy, float& dz) const
+    {
+        int seed = mSeed;
+        float sum = 0;
+        float amp = mFractalBounding;
+        float frequencyScale = 1;
+        dx = dy = dz = 0;
+
+        for (int i = 0; i < mOctaves; i++)
+        {
+            if (i >= mFractalDetail)
+            {
+                sum += FractalRemainder(amp, i);
+                break;
+            }
+            float gx, gy, gz;
+            float single = GenNoiseSingleGradient(seed++, x, y, z, gx, gy, gz);
+            float term, weight, slope;
+            FractalOctaveTerm(single, term, weight);
+
+            switch (mFractalType)
+            {
+            case FractalType_Ridged:
+                slope = (single < 0 ? 2.0f : -2.0f) * amp;
+                break;
+            case FractalType_PingPong:
+                {
+                    float t = (single + 1) * mPingPongStrength;
+                    t -= (int)(t * 0.5f) * 2;
+                    slope = (t < 1 ? 2.0f : -2.0f) * mPingPongStrength * amp;
+                }
+                break;
+            default:
+                slope = amp;
+                break;
+            }
+
+            float fade = OctaveFade(i);
+            if (fade < 1)
+            {
+                term = mOctaveMean + (term - mOctaveMean) * fade;
+                weight = mOctaveWeightMean + (weight - mOctaveWeightMean) * fade;
+                slope *= fade;
+            }
+            sum += term * amp;
+            amp *= weight;
+
+            dx += gx * slope * frequencyScale;
+            dy += gy * slope * frequencyScale;
+            dz += gz * slope * frequencyScale;
 
             x *= mLacunarity;
             y *= mLacunarity;
             z *= mLacunarity;
+            frequencyScale *= mLacunarity;
             amp *= mGain;
         }
 
@@ -1150,6 +1576,131 @@ private:
     }
 
 
+    void GradCoordVector(int seed, int xPrimed, int yPrimed, int zPrimed, float& xg, float& yg, float& zg) const
+    {
+        int hash = Hash(seed, xPrimed, yPrimed, zPrimed);
+        hash ^= hash >> 15;
+        hash &= 63 << 2;
+
+        xg = Lookup<float>::Gradients3D[hash];
+        yg = Lookup<float>::Gradients3D[hash | 1];
+        zg = Lookup<float>::Gradients3D[hash | 2];
+    }
+
+    // Accumulates the value and gradient of one OpenSimplex2 lattice contribution a^4 * dot(g, d), with a = 0.6 - |d|^2
+    void OpenSimplex2Contribution(int seed, int i, int j, int k, float a, float xd, float yd, float zd, float& value, float& dx, float& dy, float& dz) const
+    {
+        float xg, yg, zg;
+        GradCoordVector(seed, i, j, k, xg, yg, zg);
+        float dot = xd * xg + yd * yg + zd * zg;
+        float a2 = a * a;
+        float a4 = a2 * a2;
+        float falloff = -8 * a2 * a * dot;
+
+        value += a4 * dot;
+        dx += a4 * xg + falloff * xd;
+        dy += a4 * yg + falloff * yd;
+        dz += a4 * zg + falloff * zd;
+    }
+
+    template <typename FNfloat>
+    float SingleOpenSimplex2Gradient(int seed, FNfloat x, FNfloat y, FNfloat z, float& dx, float& dy, float& dz) const
+    {
+        // Same lattice walk as SingleOpenSimplex2, differentiating each contribution
+
+        int i = FastRound(x);
+        int j = FastRound(y);
+        int k = FastRound(z);
+        float x0 = (float)(x - i);
+        float y0 = (float)(y - j);
+        float z0 = (float)(z - k);
+
+        int xNSign = (int)(-1.0f - x0) | 1;
+        int yNSign = (int)(-1.0f - y0) | 1;
+        int zNSign = (int)(-1.0f - z0) | 1;
+
+        float ax0 = xNSign * -x0;
+        float ay0 = yNSign * -y0;
+        float az0 = zNSign * -z0;
+
+        i *= PrimeX;
+        j *= PrimeY;
+        k *= PrimeZ;
+
+        float value = 0;
+        dx = dy = dz = 0;
+        float a = (0.6f - x0 * x0) - (y0 * y0 + z0 * z0);
+
+        for (int l = 0; ; l++)
+        {
+            if (a > 0)
+            {
+                OpenSimplex2Contribution(seed, i, j, k, a, x0, y0, z0, value, dx, dy, dz);
+            }
+
+            float b = a + 1;
+            int i1 = i;
+            int j1 = j;
+            int k1 = k;
+            float x1 = x0;
+            float y1 = y0;
+            float z1 = z0;
+
+            if (ax0 >= ay0 && ax0 >= az0)
+            {
+                x1 += xNSign;
+                b -= xNSign * 2 * x1;
+                i1 -= xNSign * PrimeX;
+            }
+            else if (ay0 > ax0 && ay0 >= az0)
+            {
+                y1 += yNSign;
+                b -= yNSign * 2 * y1;
+                j1 -= yNSign * PrimeY;
+            }
+            else
+            {
+                z1 += zNSign;
+                b -= zNSign * 2 * z1;
+                k1 -= zNSign * PrimeZ;
+            }
+
+            if (b > 0)
+            {
+                OpenSimplex2Contribution(seed, i1, j1, k1, b, x1, y1, z1, value, dx, dy, dz);
+            }
+
+            if (l == 1) break;
+
+            ax0 = 0.5f - ax0;
+            ay0 = 0.5f - ay0;
+            az0 = 0.5f - az0;
+
+            x0 = xNSign * ax0;
+            y0 = yNSign * ay0;
+            z0 = zNSign * az0;
+
+            a += (0.75f - ax0) - (ay0 + az0);
+
+            i += (xNSign >> 1) & PrimeX;
+            j += (yNSign >> 1) & PrimeY;
+            k += (zNSign >> 1) & PrimeZ;
+
+            xNSign = -xNSign;
+            yNSign = -yNSign;
+            zNSign = -zNSign;
+
+            seed = ~seed;
+        }
+
+        const float scale = 32.69428253173828125f;
+        dx *= scale;
+        dy *= scale;
+        dz *= scale;
+        return value * scale;
+    }
+
+
     // OpenSimplex2S Noise
 
     template <typename FNfloat>
@@ -1626,6 +2177,17 @@ private:
         int yPrimedBase = (yr - 1) * PrimeY;
         int zPrimedBase = (zr - 1) * PrimeZ;
 
+        bool searched = false;
+#ifdef FNL_CELLULAR_SSE2
+        if (mCellularSIMD && std::is_same<FNfloat, float>::value &&
+            (mCellularDistanceFunction == CellularDistanceFunction_Euclidean || mCellularDistanceFunction == CellularDistanceFunction_EuclideanSq))
+        {
+            CellularEuclideanSSE2(seed, (float)x, (float)y, (float)z, xr, yr, zr, cellularJitter, distance0, distance1, closestHash);
+            searched = true;
+        }
+#endif
+
+        if (!searched)
         switch (mCellularDistanceFunction)
         {
         case CellularDistanceFunction_Euclidean:
@@ -1764,6 +2326,300 @@ private:
     }
 
 
+#ifdef FNL_CELLULAR_SSE2
+    static __m128i MulLo32SSE2(__m128i a, __m128i b)
+    {
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    // 3x3x3 Euclidean neighbour search, four cells per iteration.
+    // Cells are laid out in the scalar loop order (x outer, z inner) and padded to 28 with an empty cell,
+    // distances are combined with min/max only, so the result is bit-identical to the scalar search
+    // (as long as the compiler does not contract the scalar path into FMA instructions).
+    void CellularEuclideanSSE2(int seed, float x, float y, float z, int xr, int yr, int zr, float cellularJitter,
+        float& distance0, float& distance1, int& closestHash) const
+    {
+        struct NeighbourTable
+        {
+            alignas(16) int offsetX[28];
+            alignas(16) int offsetY[28];
+            alignas(16) int offsetZ[28];
+            alignas(16) int primedX[28];
+            alignas(16) int primedY[28];
+            alignas(16) int primedZ[28];
+
+            NeighbourTable()
+            {
+                for (int cell = 0; cell < 28; cell++)
+                {
+                    int c = cell < 27 ? cell : 13;
+                    offsetX[cell] = c / 9 - 1;
+                    offsetY[cell] = (c / 3) % 3 - 1;
+                    offsetZ[cell] = c % 3 - 1;
+                    primedX[cell] = offsetX[cell] * PrimeX;
+                    primedY[cell] = offsetY[cell] * PrimeY;
+                    primedZ[cell] = offsetZ[cell] * PrimeZ;
+                }
+            }
+        };
+        static const NeighbourTable table;
+
+        const __m128i seedVector = _mm_set1_epi32(seed);
+        const __m128i xBase = _mm_set1_epi32((int)((unsigned)xr * (unsigned)PrimeX));
+        const __m128i yBase = _mm_set1_epi32((int)((unsigned)yr * (unsigned)PrimeY));
+        const __m128i zBase = _mm_set1_epi32((int)((unsigned)zr * (unsigned)PrimeZ));
+        const __m128i hashMultiplier = _mm_set1_epi32(0x27d4eb2d);
+        const __m128i indexMask = _mm_set1_epi32(255 << 2);
+        const __m128 xVector = _mm_set1_ps(x);
+        const __m128 yVector = _mm_set1_ps(y);
+        const __m128 zVector = _mm_set1_ps(z);
+        const __m128 jitter = _mm_set1_ps(cellularJitter);
+
+        alignas(16) float distances[28];
+        alignas(16) int hashes[28];
+        __m128 minimum0 = _mm_set1_ps(1e10f);
+        __m128 minimum1 = _mm_set1_ps(1e10f);
+
+        for (int cell = 0; cell < 28; cell += 4)
+        {
+            __m128i hash = _mm_xor_si128(seedVector, _mm_add_epi32(xBase, _mm_load_si128((const __m128i*)(table.primedX + cell))));
+            hash = _mm_xor_si128(hash, _mm_add_epi32(yBase, _mm_load_si128((const __m128i*)(table.primedY + cell))));
+            hash = _mm_xor_si128(hash, _mm_add_epi32(zBase, _mm_load_si128((const __m128i*)(table.primedZ + cell))));
+            hash = MulLo32SSE2(hash, hashMultiplier);
+            _mm_store_si128((__m128i*)(hashes + cell), hash);
+
+            alignas(16) int index[4];
+            _mm_store_si128((__m128i*)index, _mm_and_si128(hash, indexMask));
+
+            // RandVecs3D entries are (x, y, z, 0) quads, transposing four of them gives SoA feature offsets
+            __m128 randX = _mm_loadu_ps(Lookup<float>::RandVecs3D + index[0]);
+            __m128 randY = _mm_loadu_ps(Lookup<float>::RandVecs3D + index[1]);
+            __m128 randZ = _mm_loadu_ps(Lookup<float>::RandVecs3D + index[2]);
+            __m128 randW = _mm_loadu_ps(Lookup<float>::RandVecs3D + index[3]);
+            _MM_TRANSPOSE4_PS(randX, randY, randZ, randW);
+
+            __m128 cellX = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(xr), _mm_load_si128((const __m128i*)(table.offsetX + cell))));
+            __m128 cellY = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(yr), _mm_load_si128((const __m128i*)(table.offsetY + cell))));
+            __m128 cellZ = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(zr), _mm_load_si128((const __m128i*)(table.offsetZ + cell))));
+
+            __m128 vecX = _mm_add_ps(_mm_sub_ps(cellX, xVector), _mm_mul_ps(randX, jitter));
+            __m128 vecY = _mm_add_ps(_mm_sub_ps(cellY, yVector), _mm_mul_ps(randY, jitter));
+            __m128 vecZ = _mm_add_ps(_mm_sub_ps(cellZ, zVector), _mm_mul_ps(randZ, jitter));
+            __m128 newDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vecX, vecX), _mm_mul_ps(vecY, vecY)), _mm_mul_ps(vecZ, vecZ));
+
+            if (cell == 24)
+            {
+                // Lane 3 of the last group is padding, it must not take part in the search
+                newDistance = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)), newDistance),
+                    _mm_andnot_ps(_mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)), _mm_set1_ps(1e10f)));
+            }
+            _mm_store_ps(distances + cell, newDistance);
+
+            minimum1 = _mm_max_ps(_mm_min_ps(minimum1, newDistance), minimum0);
+            minimum0 = _mm_min_ps(minimum0, newDistance);
+        }
+
+        // Merge the per-lane (smallest, second smallest) pairs
+        alignas(16) float lanes0[4];
+        alignas(16) float lanes1[4];
+        _mm_store_ps(lanes0, minimum0);
+        _mm_store_ps(lanes1, minimum1);
+        distance0 = lanes0[0];
+        distance1 = lanes1[0];
+        for (int lane = 1; lane < 4; lane++)
+        {
+            distance1 = FastMin(FastMax(distance0, lanes0[lane]), FastMin(distance1, lanes1[lane]));
+            distance0 = FastMin(distance0, lanes0[lane]);
+        }
+
+        if (mCellularReturnType == CellularReturnType_CellValue)
+        {
+            for (int cell = 0; cell < 27; cell++)
+            {
+                if (distances[cell] == distance0)
+                {
+                    closestHash = hashes[cell];
+                    break;
+                }
+            }
+        }
+    }
+
+    static __m128 SelectSSE2(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    static __m128i SelectSSE2(__m128i mask, __m128i a, __m128i b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    static __m128 GradCoordSSE2(__m128i seed, __m128i xPrimed, __m128i yPrimed, __m128i zPrimed, __m128 xd, __m128 yd, __m128 zd)
+    {
+        __m128i hash = MulLo32SSE2(_mm_xor_si128(_mm_xor_si128(seed, xPrimed), _mm_xor_si128(yPrimed, zPrimed)), _mm_set1_epi32(0x27d4eb2d));
+        hash = _mm_and_si128(_mm_xor_si128(hash, _mm_srai_epi32(hash, 15)), _mm_set1_epi32(63 << 2));
+        alignas(16) int index[4];
+        _mm_store_si128((__m128i*)index, hash);
+
+        const float* gradients = Lookup<float>::Gradients3D;
+        __m128 xg = _mm_setr_ps(gradients[index[0]], gradients[index[1]], gradients[index[2]], gradients[index[3]]);
+        __m128 yg = _mm_setr_ps(gradients[index[0] | 1], gradients[index[1] | 1], gradients[index[2] | 1], gradients[index[3] | 1]);
+        __m128 zg = _mm_setr_ps(gradients[index[0] | 2], gradients[index[1] | 2], gradients[index[2] | 2], gradients[index[3] | 2]);
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(xd, xg), _mm_mul_ps(yd, yg)), _mm_mul_ps(zd, zg));
+    }
+
+    // SingleOpenSimplex2 on four points. Branches become selects and every float operation keeps the scalar order,
+    // so the result is bit-identical (as long as the compiler does not contract the scalar path into FMA instructions).
+    // Coordinates are already transformed
+    static void SingleOpenSimplex2SSE2(int seed, const float* x, const float* y, const float* z, float* out)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i primeX = _mm_set1_epi32(PrimeX);
+        const __m128i primeY = _mm_set1_epi32(PrimeY);
+        const __m128i primeZ = _mm_set1_epi32(PrimeZ);
+
+        __m128 xv = _mm_loadu_ps(x);
+        __m128 yv = _mm_loadu_ps(y);
+        __m128 zv = _mm_loadu_ps(z);
+
+        // FastRound: +-0.5 with the sign of the coordinate, then truncate
+        __m128i i = _mm_cvttps_epi32(_mm_add_ps(xv, _mm_or_ps(_mm_and_ps(xv, signBit), half)));
+        __m128i j = _mm_cvttps_epi32(_mm_add_ps(yv, _mm_or_ps(_mm_and_ps(yv, signBit), half)));
+        __m128i k = _mm_cvttps_epi32(_mm_add_ps(zv, _mm_or_ps(_mm_and_ps(zv, signBit), half)));
+        __m128 x0 = _mm_sub_ps(xv, _mm_cvtepi32_ps(i));
+        __m128 y0 = _mm_sub_ps(yv, _mm_cvtepi32_ps(j));
+        __m128 z0 = _mm_sub_ps(zv, _mm_cvtepi32_ps(k));
+
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        __m128i xNSign = _mm_or_si128(_mm_cvttps_epi32(_mm_sub_ps(minusOne, x0)), one);
+        __m128i yNSign = _mm_or_si128(_mm_cvttps_epi32(_mm_sub_ps(minusOne, y0)), one);
+        __m128i zNSign = _mm_or_si128(_mm_cvttps_epi32(_mm_sub_ps(minusOne, z0)), one);
+
+        __m128 ax0 = _mm_mul_ps(_mm_cvtepi32_ps(xNSign), _mm_xor_ps(x0, signBit));
+        __m128 ay0 = _mm_mul_ps(_mm_cvtepi32_ps(yNSign), _mm_xor_ps(y0, signBit));
+        __m128 az0 = _mm_mul_ps(_mm_cvtepi32_ps(zNSign), _mm_xor_ps(z0, signBit));
+
+        i = MulLo32SSE2(i, primeX);
+        j = MulLo32SSE2(j, primeY);
+        k = MulLo32SSE2(k, primeZ);
+
+        __m128i seedVector = _mm_set1_epi32(seed);
+        __m128 value = _mm_setzero_ps();
+        __m128 a = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(x0, x0)), _mm_add_ps(_mm_mul_ps(y0, y0), _mm_mul_ps(z0, z0)));
+
+        for (int l = 0; ; l++)
+        {
+            __m128 a2 = _mm_mul_ps(a, a);
+            __m128 contribution = _mm_mul_ps(_mm_mul_ps(a2, a2), GradCoordSSE2(seedVector, i, j, k, x0, y0, z0));
+            value = SelectSSE2(_mm_cmpgt_ps(a, _mm_setzero_ps()), _mm_add_ps(value, contribution), value);
+
+            // Step along the axis with the largest offset; ties go to x, then y, like the scalar if chain
+            __m128 alongX = _mm_and_ps(_mm_cmpge_ps(ax0, ay0), _mm_cmpge_ps(ax0, az0));
+            __m128 alongY = _mm_andnot_ps(alongX, _mm_and_ps(_mm_cmpgt_ps(ay0, ax0), _mm_cmpge_ps(ay0, az0)));
+            __m128 alongZ = _mm_andnot_ps(_mm_or_ps(alongX, alongY), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+            __m128 xSign = _mm_cvtepi32_ps(xNSign);
+            __m128 ySign = _mm_cvtepi32_ps(yNSign);
+            __m128 zSign = _mm_cvtepi32_ps(zNSign);
+            __m128 x1 = SelectSSE2(alongX, _mm_add_ps(x0, xSign), x0);
+            __m128 y1 = SelectSSE2(alongY, _mm_add_ps(y0, ySign), y0);
+            __m128 z1 = SelectSSE2(alongZ, _mm_add_ps(z0, zSign), z0);
+            __m128 b = _mm_add_ps(a, _mm_set1_ps(1.0f));
+            __m128 stepped = SelectSSE2(alongX, _mm_mul_ps(_mm_add_ps(xSign, xSign), x1),
+                                        SelectSSE2(alongY, _mm_mul_ps(_mm_add_ps(ySign, ySign), y1), _mm_mul_ps(_mm_add_ps(zSign, zSign), z1)));
+            b = _mm_sub_ps(b, stepped);
+
+            // xNSign * PrimeX with xNSign = +-1: negate the prime where the sign is negative
+            __m128i xNegative = _mm_srai_epi32(xNSign, 31);
+            __m128i yNegative = _mm_srai_epi32(yNSign, 31);
+            __m128i zNegative = _mm_srai_epi32(zNSign, 31);
+            __m128i i1 = SelectSSE2(_mm_castps_si128(alongX), _mm_sub_epi32(i, _mm_sub_epi32(_mm_xor_si128(primeX, xNegative), xNegative)), i);
+            __m128i j1 = SelectSSE2(_mm_castps_si128(alongY), _mm_sub_epi32(j, _mm_sub_epi32(_mm_xor_si128(primeY, yNegative), yNegative)), j);
+            __m128i k1 = SelectSSE2(_mm_castps_si128(alongZ), _mm_sub_epi32(k, _mm_sub_epi32(_mm_xor_si128(primeZ, zNegative), zNegative)), k);
+
+            __m128 b2 = _mm_mul_ps(b, b);
+            contribution = _mm_mul_ps(_mm_mul_ps(b2, b2), GradCoordSSE2(seedVector, i1, j1, k1, x1, y1, z1));
+            value = SelectSSE2(_mm_cmpgt_ps(b, _mm_setzero_ps()), _mm_add_ps(value, contribution), value);
+
+            if (l == 1) break;
+
+            ax0 = _mm_sub_ps(half, ax0);
+            ay0 = _mm_sub_ps(half, ay0);
+            az0 = _mm_sub_ps(half, az0);
+
+            x0 = _mm_mul_ps(xSign, ax0);
+            y0 = _mm_mul_ps(ySign, ay0);
+            z0 = _mm_mul_ps(zSign, az0);
+
+            a = _mm_add_ps(a, _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.75f), ax0), _mm_add_ps(ay0, az0)));
+
+            i = _mm_add_epi32(i, _mm_and_si128(_mm_srai_epi32(xNSign, 1), primeX));
+            j = _mm_add_epi32(j, _mm_and_si128(_mm_srai_epi32(yNSign, 1), primeY));
+            k = _mm_add_epi32(k, _mm_and_si128(_mm_srai_epi32(zNSign, 1), primeZ));
+
+            xNSign = _mm_sub_epi32(_mm_setzero_si128(), xNSign);
+            yNSign = _mm_sub_epi32(_mm_setzero_si128(), yNSign);
+            zNSign = _mm_sub_epi32(_mm_setzero_si128(), zNSign);
+
+            seedVector = _mm_xor_si128(seedVector, _mm_set1_epi32(-1));
+        }
+
+        _mm_storeu_ps(out, _mm_mul_ps(value, _mm_set1_ps(32.69428253173828125f)));
+    }
+
+    // The octave loop of GenFractalFBm/Ridged/PingPong on four points: the noise of each octave comes from
+    // SingleOpenSimplex2SSE2 and the sums follow the scalar code point by point
+    void GenFractalOpenSimplex2SSE2(float* x, float* y, float* z, float* out) const
+    {
+        int seed = mSeed;
+        float sum[4] = {0, 0, 0, 0};
+        float amp[4] = {mFractalBounding, mFractalBounding, mFractalBounding, mFractalBounding};
+
+        for (int i = 0; i < mOctaves; i++)
+        {
+            if (i >= mFractalDetail)
+            {
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    sum[lane] += FractalRemainder(amp[lane], i);
+                }
+                break;
+            }
+            float single[4];
+            SingleOpenSimplex2SSE2(seed++, x, y, z, single);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (i + 1 > mFractalDetail)
+                {
+                    AddFractalOctave(single[lane], i, sum[lane], amp[lane]);
+                }
+                else
+                {
+                    float term, weight;
+                    FractalOctaveTerm(single[lane], term, weight);
+                    sum[lane] += term * amp[lane];
+                    amp[lane] *= weight;
+                }
+                x[lane] *= mLacunarity;
+                y[lane] *= mLacunarity;
+                z[lane] *= mLacunarity;
+                amp[lane] *= mGain;
+            }
+        }
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            out[lane] = sum[lane];
+        }
+    }
+#endif
+
+
     // Perlin Noise
 
     template <typename FNfloat>
@@ -1828,6 +2684,86 @@ private:
     }
 
 
+    static float InterpQuinticDerivative(float t) { return 30 * t * t * (t * (t - 2) + 1); }
+
+    template <typename FNfloat>
+    float SinglePerlinGradient(int seed, FNfloat x, FNfloat y, FNfloat z, float& dx, float& dy, float& dz) const
+    {
+        int x0 = FastFloor(x);
+        int y0 = FastFloor(y);
+        int z0 = FastFloor(z);
+
+        float xd0 = (float)(x - x0);
+        float yd0 = (float)(y - y0);
+        float zd0 = (float)(z - z0);
+        float xd1 = xd0 - 1;
+        float yd1 = yd0 - 1;
+        float zd1 = zd0 - 1;
+
+        float xs = InterpQuintic(xd0);
+        float ys = InterpQuintic(yd0);
+        float zs = InterpQuintic(zd0);
+        float dxs = InterpQuinticDerivative(xd0);
+        float dys = InterpQuinticDerivative(yd0);
+        float dzs = InterpQuinticDerivative(zd0);
+
+        x0 *= PrimeX;
+        y0 *= PrimeY;
+        z0 *= PrimeZ;
+        int x1 = x0 + PrimeX;
+        int y1 = y0 + PrimeY;
+        int z1 = z0 + PrimeZ;
+
+        float g[8][3];
+        GradCoordVector(seed, x0, y0, z0, g[0][0], g[0][1], g[0][2]);
+        GradCoordVector(seed, x1, y0, z0, g[1][0], g[1][1], g[1][2]);
+        GradCoordVector(seed, x0, y1, z0, g[2][0], g[2][1], g[2][2]);
+        GradCoordVector(seed, x1, y1, z0, g[3][0], g[3][1], g[3][2]);
+        GradCoordVector(seed, x0, y0, z1, g[4][0], g[4][1], g[4][2]);
+        GradCoordVector(seed, x1, y0, z1, g[5][0], g[5][1], g[5][2]);
+        GradCoordVector(seed, x0, y1, z1, g[6][0], g[6][1], g[6][2]);
+        GradCoordVector(seed, x1, y1, z1, g[7][0], g[7][1], g[7][2]);
+
+        float n000 = g[0][0] * xd0 + g[0][1] * yd0 + g[0][2] * zd0;
+        float n100 = g[1][0] * xd1 + g[1][1] * yd0 + g[1][2] * zd0;
+        float n010 = g[2][0] * xd0 + g[2][1] * yd1 + g[2][2] * zd0;
+        float n110 = g[3][0] * xd1 + g[3][1] * yd1 + g[3][2] * zd0;
+        float n001 = g[4][0] * xd0 + g[4][1] * yd0 + g[4][2] * zd1;
+        float n101 = g[5][0] * xd1 + g[5][1] * yd0 + g[5][2] * zd1;
+        float n011 = g[6][0] * xd0 + g[6][1] * yd1 + g[6][2] * zd1;
+        float n111 = g[7][0] * xd1 + g[7][1] * yd1 + g[7][2] * zd1;
+
+        // Trilinear blend written as a polynomial in (xs, ys, zs) so it can be differentiated directly
+        float k1 = n100 - n000;
+        float k2 = n010 - n000;
+        float k3 = n001 - n000;
+        float k4 = n000 - n100 - n010 + n110;
+        float k5 = n000 - n010 - n001 + n011;
+        float k6 = n000 - n100 - n001 + n101;
+        float k7 = -n000 + n100 + n010 - n110 + n001 - n101 - n011 + n111;
+
+        float value = n000 + k1 * xs + k2 * ys + k3 * zs + k4 * xs * ys + k5 * ys * zs + k6 * zs * xs + k7 * xs * ys * zs;
+
+        float w[8] = {
+            (1 - xs) * (1 - ys) * (1 - zs), xs * (1 - ys) * (1 - zs), (1 - xs) * ys * (1 - zs), xs * ys * (1 - zs),
+            (1 - xs) * (1 - ys) * zs, xs * (1 - ys) * zs, (1 - xs) * ys * zs, xs * ys * zs
+        };
+        float gx = 0, gy = 0, gz = 0;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            gx += w[corner] * g[corner][0];
+            gy += w[corner] * g[corner][1];
+            gz += w[corner] * g[corner][2];
+        }
+
+        const float scale = 0.964921414852142333984375f;
+        dx = (gx + dxs * (k1 + k4 * ys + k6 * zs + k7 * ys * zs)) * scale;
+        dy = (gy + dys * (k2 + k4 * xs + k5 * zs + k7 * xs * zs)) * scale;
+        dz = (gz + dzs * (k3 + k5 * ys + k6 * xs + k7 * xs * ys)) * scale;
+        return value * scale;
+    }
+
+
     // Value Cubic Noise
 
     template <typename FNfloat>
@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "framebuffer.h"
+#include "uniform.h"
+#pragma once
+
+// Dispersión de Rayleigh simple precalculada (al estilo de Bruneton). Todo se mide en radios del planeta: el suelo
+// está en r = 1 y el tope de la atmósfera en r = 1 + height
+constexpr int TRANSMITTANCE_HEIGHTS = 32;
+constexpr int TRANSMITTANCE_ANGLES = 128;
+constexpr int SCATTERING_VIEW_ANGLES = 64;
+constexpr int SCATTERING_SUN_ANGLES = 32;
+constexpr int SCATTERING_PHASE_ANGLES = 16;
+constexpr int ATMOSPHERE_STEPS = 48;
+constexpr Uint32 ATMOSPHERE_CACHE_VERSION = 2;
+
+struct AtmosphereParameters {
+    float height;
+    float scaleHeight;
+    // Profundidad óptica vertical desde el suelo por canal; define el color y qué tan densa se ve
+    glm::vec3 verticalDepth;
+    float sunIntensity;
+};
+
+// transmittance[r][mu]: luz que llega desde un punto a radio r hasta el tope, mirando con coseno cenital mu.
+// scattering[nu][muSun][mu]: luz dispersada hacia el observador a lo largo de un rayo que entra por el tope con coseno
+// cenital mu, con el sol a coseno cenital muSun en el punto de entrada y coseno nu entre el rayo y el sol; la función
+// de fase ya va incluida
+struct Atmosphere {
+    AtmosphereParameters parameters;
+    float radius = 0.0f;
+    std::vector<ColorF> transmittance;
+    std::vector<ColorF> scattering;
+};
+
+// Cámara y sol en el espacio del modelo del planeta, escalados a radios; se calcula una vez por planeta y cuadro
+struct AtmosphereView {
+    glm::vec3 camera;
+    glm::vec3 sun;
+    float cameraDistanceSquared;
+    float inverseRadius;
+};
+
+inline float atmosphereTop(const Atmosphere& atmosphere) {
+    return 1.0f + atmosphere.parameters.height;
+}
+
+// Más resolución cerca del horizonte, donde la transmitancia y el brillo del borde cambian más rápido
+inline float horizonCoordinate(float mu) {
+    return 0.5f + 0.5f * std::copysign(std::sqrt(std::abs(mu)), mu);
+}
+
+inline float horizonCosine(float coordinate) {
+    float signedRoot = coordinate * 2.0f - 1.0f;
+    return std::copysign(signedRoot * signedRoot, signedRoot);
+}
+
+inline bool rayHitsGround(float r, float mu) {
+    return mu < 0.0f && r * r * (mu * mu - 1.0f) + 1.0f >= 0.0f;
+}
+
+// Coseno cenital de un rayo que entra por el tope rozando el suelo
+inline float horizonViewCosine(float top) {
+    return -std::sqrt(1.0f - 1.0f / (top * top));
+}
+
+// Los rayos que entran van hacia abajo (mu <= 0). Los que chocan con el suelo ocupan la segunda mitad de las filas:
+// el brillo salta en el horizonte, donde el rayo deja de atravesar toda la atmósfera, y la interpolación no debe
+// cruzarlo. En cada mitad la raíz concentra las filas en los rayos rasantes
+inline float viewCoordinate(float mu, float horizon, bool ground) {
+    constexpr int half = SCATTERING_VIEW_ANGLES / 2;
+    if (ground) {
+        return half + std::sqrt(std::clamp((horizon - mu) / (1.0f + horizon), 0.0f, 1.0f)) * (half - 1);
+    }
+    return std::sqrt(std::clamp((mu - horizon) / -horizon, 0.0f, 1.0f)) * (half - 1);
+}
+
+inline float viewCosine(int row, float horizon) {
+    constexpr int half = SCATTERING_VIEW_ANGLES / 2;
+    float root = (row % half) / float(half - 1);
+    return row >= half ? horizon - root * root * (1.0f + horizon) : horizon * (1.0f - root * root);
+}
+
+inline float distanceToTop(float r, float mu, float top) {
+    float discriminant = r * r * (mu * mu - 1.0f) + top * top;
+    return std::max(0.0f, -r * mu + std::sqrt(std::max(discriminant, 0.0f)));
+}
+
+inline float distanceToGround(float r, float mu) {
+    float discriminant = r * r * (mu * mu - 1.0f) + 1.0f;
+    return std::max(0.0f, -r * mu - std::sqrt(std::max(discriminant, 0.0f)));
+}
+
+inline glm::vec3 rayleighCoefficients(const AtmosphereParameters& parameters) {
+    return parameters.verticalDepth / parameters.scaleHeight;
+}
+
+inline __m128 lerpColorF(__m128 a, __m128 b, float t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_set1_ps(t), _mm_sub_ps(b, a)));
+}
+
+// Muestra bilineal de la transmitancia; los rayos hacia el suelo devuelven 0
+inline __m128 sampleTransmittance(const Atmosphere& atmosphere, float r, float mu) {
+    float height = std::clamp((r - 1.0f) / atmosphere.parameters.height, 0.0f, 1.0f) * (TRANSMITTANCE_HEIGHTS - 1);
+    float angle = std::clamp(horizonCoordinate(mu), 0.0f, 1.0f) * (TRANSMITTANCE_ANGLES - 1);
+    int row = std::min(static_cast<int>(height), TRANSMITTANCE_HEIGHTS - 2);
+    int column = std::min(static_cast<int>(angle), TRANSMITTANCE_ANGLES - 2);
+    const ColorF* texels = &atmosphere.transmittance[row * TRANSMITTANCE_ANGLES + column];
+    __m128 lower = lerpColorF(loadColorF(texels[0]), loadColorF(texels[1]), angle - column);
+    __m128 upper = lerpColorF(loadColorF(texels[TRANSMITTANCE_ANGLES]), loadColorF(texels[TRANSMITTANCE_ANGLES + 1]), angle - column);
+    return lerpColorF(lower, upper, height - row);
+}
+
+// Muestra trilineal de la dispersión en el punto de entrada
+inline __m128 sampleScattering(const Atmosphere& atmosphere, float mu, float muSun, float nu) {
+    float top = atmosphereTop(atmosphere);
+    bool ground = rayHitsGround(top, mu);
+    float view = viewCoordinate(mu, horizonViewCosine(top), ground);
+    float sun = std::clamp(0.5f + 0.5f * muSun, 0.0f, 1.0f) * (SCATTERING_SUN_ANGLES - 1);
+    float phase = std::clamp(0.5f + 0.5f * nu, 0.0f, 1.0f) * (SCATTERING_PHASE_ANGLES - 1);
+    int i = std::min(static_cast<int>(view), (ground ? SCATTERING_VIEW_ANGLES : SCATTERING_VIEW_ANGLES / 2) - 2);
+    int j = std::min(static_cast<int>(sun), SCATTERING_SUN_ANGLES - 2);
+    int k = std::min(static_cast<int>(phase), SCATTERING_PHASE_ANGLES - 2);
+
+    auto slice = [&](int layer) {
+        const ColorF* texels = &atmosphere.scattering[(layer * SCATTERING_SUN_ANGLES + j) * SCATTERING_VIEW_ANGLES + i];
+        __m128 lower = lerpColorF(loadColorF(texels[0]), loadColorF(texels[1]), view - i);
+        __m128 upper = lerpColorF(loadColorF(texels[SCATTERING_VIEW_ANGLES]), loadColorF(texels[SCATTERING_VIEW_ANGLES + 1]), view - i);
+        return lerpColorF(lower, upper, sun - j);
+    };
+    return lerpColorF(slice(k), slice(k + 1), phase - k);
+}
+
+// Integra la profundidad óptica hasta el tope; los rayos que chocan con el suelo no llevan luz
+glm::vec3 computeTransmittance(const AtmosphereParameters& parameters, float r, float mu) {
+    if (rayHitsGround(r, mu)) {
+        return glm::vec3(0.0f);
+    }
+    float length = distanceToTop(r, mu, 1.0f + parameters.height);
+    float step = length / ATMOSPHERE_STEPS;
+    float density = 0.0f;
+    for (int i = 0; i < ATMOSPHERE_STEPS; i++) {
+        float t = (i + 0.5f) * step;
+        float sampleRadius = std::sqrt(r * r + t * t + 2.0f * r * mu * t);
+        density += std::exp(-(sampleRadius - 1.0f) / parameters.scaleHeight) * step;
+    }
+    glm::vec3 depth = rayleighCoefficients(parameters) * density;
+    return glm::vec3(std::exp(-depth.x), std::exp(-depth.y), std::exp(-depth.z));
+}
+
+// Recorre el rayo desde la entrada hasta el suelo o la salida, sumando lo que el sol ilumina en cada muestra. ground
+// elige el tramo en el horizonte, donde el redondeo podría decidir distinto que la fila de la tabla
+glm::vec3 computeScattering(const Atmosphere& atmosphere, float mu, float muSun, float nu, bool ground) {
+    const AtmosphereParameters& parameters = atmosphere.parameters;
+    float top = atmosphereTop(atmosphere);
+    float length = ground ? distanceToGround(top, mu) : distanceToTop(top, mu, top);
+    float step = length / ATMOSPHERE_STEPS;
+
+    // Entrada en (0, top, 0) y rayo en el plano xy; el sol queda fijado por muSun y nu. Las combinaciones imposibles de
+    // la tabla no se normalizan: como las muestras están en el plano xy solo importan sunX y muSun, y así la tabla
+    // sigue siendo suave junto a las combinaciones reales que se interpolan con ellas
+    glm::vec3 entry(0.0f, top, 0.0f);
+    float sine = std::sqrt(std::max(0.0f, 1.0f - mu * mu));
+    glm::vec3 direction(sine, mu, 0.0f);
+    float sunX = sine > 1e-4f ? (nu - mu * muSun) / sine : 0.0f;
+    glm::vec3 sun(sunX, muSun, std::sqrt(std::max(0.0f, 1.0f - muSun * muSun - sunX * sunX)));
+
+    glm::vec3 coefficients = rayleighCoefficients(parameters);
+    glm::vec3 inscattered(0.0f);
+    float viewDensity = 0.0f;
+    for (int i = 0; i < ATMOSPHERE_STEPS; i++) {
+        glm::vec3 point = entry + direction * ((i + 0.5f) * step);
+        float pointRadius = glm::length(point);
+        float density = std::exp(-(pointRadius - 1.0f) / parameters.scaleHeight) * step;
+        viewDensity += density * 0.5f;
+        glm::vec3 viewDepth = coefficients * viewDensity;
+        alignas(16) float sunlight[4];
+        _mm_store_ps(sunlight, sampleTransmittance(atmosphere, pointRadius, glm::dot(point, sun) / pointRadius));
+        inscattered += glm::vec3(std::exp(-viewDepth.x) * sunlight[0], std::exp(-viewDepth.y) * sunlight[1], std::exp(-viewDepth.z) * sunlight[2]) * density;
+        viewDensity += density * 0.5f;
+    }
+
+    float rayleighPhase = 3.0f / (16.0f * 3.14159265f) * (1.0f + nu * nu);
+    return inscattered * coefficients * (rayleighPhase * parameters.sunIntensity);
+}
+
+glm::vec3 computeScattering(const Atmosphere& atmosphere, float mu, float muSun, float nu) {
+    return computeScattering(atmosphere, mu, muSun, nu, rayHitsGround(atmosphereTop(atmosphere), mu));
+}
+
+void computeAtmosphereTables(Atmosphere& atmosphere) {
+    atmosphere.transmittance.resize(TRANSMITTANCE_HEIGHTS * TRANSMITTANCE_ANGLES);
+    for (int row = 0; row < TRANSMITTANCE_HEIGHTS; row++) {
+        float r = 1.0f + atmosphere.parameters.height * row / (TRANSMITTANCE_HEIGHTS - 1);
+        for (int column = 0; column < TRANSMITTANCE_ANGLES; column++) {
+            glm::vec3 transmittance = computeTransmittance(atmosphere.parameters, r, horizonCosine(column / float(TRANSMITTANCE_ANGLES - 1)));
+            atmosphere.transmittance[row * TRANSMITTANCE_ANGLES + column] = ColorF(transmittance.x, transmittance.y, transmittance.z, 0.0f);
+        }
+    }
+
+    // Un hilo por capa de nu; todos leen la transmitancia ya terminada
+    atmosphere.scattering.resize(SCATTERING_PHASE_ANGLES * SCATTERING_SUN_ANGLES * SCATTERING_VIEW_ANGLES);
+    std::vector<std::thread> layers;
+    float horizon = horizonViewCosine(atmosphereTop(atmosphere));
+    for (int k = 0; k < SCATTERING_PHASE_ANGLES; k++) {
+        layers.emplace_back([&atmosphere, horizon, k]() {
+            float nu = k / float(SCATTERING_PHASE_ANGLES - 1) * 2.0f - 1.0f;
+            for (int j = 0; j < SCATTERING_SUN_ANGLES; j++) {
+                float muSun = j / float(SCATTERING_SUN_ANGLES - 1) * 2.0f - 1.0f;
+                for (int i = 0; i < SCATTERING_VIEW_ANGLES; i++) {
+                    glm::vec3 scattering = computeScattering(atmosphere, viewCosine(i, horizon), muSun, nu, i >= SCATTERING_VIEW_ANGLES / 2);
+                    atmosphere.scattering[(k * SCATTERING_SUN_ANGLES + j) * SCATTERING_VIEW_ANGLES + i] = ColorF(scattering.x, scattering.y, scattering.z, 0.0f);
+                }
+            }
+        });
+    }
+    for (std::thread& layer : layers) {
+        layer.join();
+    }
+}
+
+// El caché guarda la versión, los tamaños y los parámetros; si algo no coincide se recalcula
+struct AtmosphereCacheHeader {
+    char magic[4];
+    Uint32 version;
+    Uint32 sizes[5];
+    AtmosphereParameters parameters;
+};
+
+AtmosphereCacheHeader atmosphereCacheHeader(const AtmosphereParameters& parameters) {
+    AtmosphereCacheHeader header{};
+    std::memcpy(header.magic, "ATMO", 4);
+    header.version = ATMOSPHERE_CACHE_VERSION;
+    Uint32 sizes[5] = {TRANSMITTANCE_HEIGHTS, TRANSMITTANCE_ANGLES, SCATTERING_VIEW_ANGLES, SCATTERING_SUN_ANGLES, SCATTERING_PHASE_ANGLES};
+    std::memcpy(header.sizes, sizes, sizeof(sizes));
+    header.parameters = parameters;
+    return header;
+}
+
+bool loadAtmosphereCache(const std::string& path, Atmosphere& atmosphere) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    AtmosphereCacheHeader expected = atmosphereCacheHeader(atmosphere.parameters);
+    AtmosphereCacheHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        std::cout << "Atmosphere cache " << path << " is stale, recomputing" << std::endl;
+        return false;
+    }
+    atmosphere.transmittance.resize(TRANSMITTANCE_HEIGHTS * TRANSMITTANCE_ANGLES);
+    atmosphere.scattering.resize(SCATTERING_PHASE_ANGLES * SCATTERING_SUN_ANGLES * SCATTERING_VIEW_ANGLES);
+    file.read(reinterpret_cast<char*>(atmosphere.transmittance.data()), atmosphere.transmittance.size() * sizeof(ColorF));
+    file.read(reinterpret_cast<char*>(atmosphere.scattering.data()), atmosphere.scattering.size() * sizeof(ColorF));
+    if (!file) {
+        std::cout << "Atmosphere cache " << path << " is truncated, recomputing" << std::endl;
+        atmosphere.transmittance.clear();
+        atmosphere.scattering.clear();
+        return false;
+    }
+    return true;
+}
+
+bool saveAtmosphereCache(const std::string& path, const Atmosphere& atmosphere) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to write atmosphere cache " << path << std::endl;
+        return false;
+    }
+    AtmosphereCacheHeader header = atmosphereCacheHeader(atmosphere.parameters);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(atmosphere.transmittance.data()), atmosphere.transmittance.size() * sizeof(ColorF));
+    file.write(reinterpret_cast<const char*>(atmosphere.scattering.data()), atmosphere.scattering.size() * sizeof(ColorF));
+    return static_cast<bool>(file);
+}
+
+// radius es el radio del planeta en el espacio del modelo; con cachePath vacío siempre se calcula
+std::unique_ptr<Atmosphere> createAtmosphere(const AtmosphereParameters& parameters, float radius, const std::string& cachePath) {
+    std::unique_ptr<Atmosphere> atmosphere = std::make_unique<Atmosphere>();
+    atmosphere->parameters = parameters;
+    atmosphere->radius = radius;
+    if (cachePath.empty() || !loadAtmosphereCache(cachePath, *atmosphere)) {
+        computeAtmosphereTables(*atmosphere);
+        if (!cachePath.empty()) {
+            saveAtmosphereCache(cachePath, *atmosphere);
+        }
+    }
+    return atmosphere;
+}
+
+// La atmósfera es una esfera, así que la rotación del modelo no cambia nada y todo se evalúa en su espacio
+AtmosphereView createAtmosphereView(const Atmosphere& atmosphere, const Uniform& uniform) {
+    glm::mat4 inverseModel = glm::inverse(uniform.model);
+    AtmosphereView view;
+    view.camera = glm::vec3(inverseModel * glm::vec4(uniform.frame.cameraPosition, 1.0f)) / atmosphere.radius;
+    // El planeta está en el origen de su modelo, así que la dirección al sol es la posición del sol en ese espacio
+    view.sun = glm::normalize(glm::vec3(inverseModel * glm::vec4(uniform.frame.sunPosition, 1.0f)));
+    view.cameraDistanceSquared = glm::dot(view.camera, view.camera);
+    view.inverseRadius = 1.0f / atmosphere.radius;
+    return view;
+}
+
+// Entrada del rayo desde la cámara al tope de la atmósfera; si la cámara ya está adentro, la entrada es la cámara
+inline bool atmosphereEntry(const Atmosphere& atmosphere, const AtmosphereView& view, const glm::vec3& direction, float& mu, float& muSun, float& nu) {
+    float top = atmosphereTop(atmosphere);
+    float b = glm::dot(view.camera, direction);
+    float discriminant = b * b - view.cameraDistanceSquared + top * top;
+    if (discriminant < 0.0f) {
+        return false;
+    }
+    float distance = std::max(0.0f, -b - std::sqrt(discriminant));
+    glm::vec3 entry = view.camera + direction * distance;
+    float inverseEntryRadius = 1.0f / std::sqrt(glm::dot(entry, entry));
+    mu = glm::dot(entry, direction) * inverseEntryRadius;
+    muSun = glm::dot(entry, view.sun) * inverseEntryRadius;
+    nu = glm::dot(direction, view.sun);
+    return true;
+}
+
+// Superficie vista a través de la atmósfera: se atenúa por la transmitancia hacia la cámara y se le suma la luz
+// dispersada en el camino. Dos lecturas de tabla por píxel
+ColorF shadeAtmosphereSurface(const Atmosphere& atmosphere, const AtmosphereView& view, const glm::vec3& original, const ColorF& surface) {
+    glm::vec3 point = original * view.inverseRadius;
+    glm::vec3 toPoint = point - view.camera;
+    glm::vec3 direction = toPoint * (1.0f / std::sqrt(glm::dot(toPoint, toPoint)));
+    float mu, muSun, nu;
+    if (!atmosphereEntry(atmosphere, view, direction, mu, muSun, nu)) {
+        return surface;
+    }
+    float inversePointRadius = 1.0f / std::sqrt(glm::dot(point, point));
+    __m128 transmittance = sampleTransmittance(atmosphere, 1.0f / inversePointRadius, -glm::dot(point, direction) * inversePointRadius);
+    __m128 scattering = sampleScattering(atmosphere, mu, muSun, nu);
+    ColorF shaded;
+    storeColorF(shaded, _mm_add_ps(_mm_mul_ps(loadColorF(surface), transmittance), scattering));
+    shaded.a = surface.a;
+    return shaded;
+}
+
+// Borde de la atmósfera fuera del disco: solo los rayos que atraviesan la capa sin tocar el suelo. Una lectura
+inline bool shadeAtmosphereLimb(const Atmosphere& atmosphere, const AtmosphereView& view, const glm::vec3& direction, ColorF& inscattered) {
+    float b = glm::dot(view.camera, direction);
+    if (b * b - view.cameraDistanceSquared + 1.0f >= 0.0f && b < 0.0f) {
+        return false;
+    }
+    float mu, muSun, nu;
+    if (!atmosphereEntry(atmosphere, view, direction, mu, muSun, nu)) {
+        return false;
+    }
+    storeColorF(inscattered, sampleScattering(atmosphere, mu, muSun, nu));
+    return true;
+}
+
+// Se dibuja después del cielo sobre el rectángulo de pantalla que cubre la capa, sin escribir profundidad. Lo que ya
+// está más cerca que la entrada del rayo tapa el borde; lo que está detrás recibe la luz encima
+void renderAtmosphereLimb(const Atmosphere& atmosphere, const Uniform& uniform, const std::array<double, SCREEN_WIDTH * SCREEN_HEIGHT>& depthBuffer, bool hdr) {
+    AtmosphereView view = createAtmosphereView(atmosphere, uniform);
+    glm::mat4 inverseModel = glm::inverse(uniform.model);
+    glm::mat4 screenTransform = uniform.viewport * uniform.projection * uniform.view;
+    glm::mat4 inverseViewProjection = glm::inverse(uniform.projection * uniform.view);
+    glm::vec3 camera = uniform.frame.cameraPosition;
+
+    // Rectángulo que contiene la proyección de la esfera del tope; si la cámara está cerca se recorre toda la pantalla
+    int minX = 0, minY = 1, maxX = SCREEN_WIDTH - 1, maxY = SCREEN_HEIGHT - 1;
+    glm::vec4 center = screenTransform * uniform.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float top = atmosphereTop(atmosphere);
+    float cameraDistance = std::sqrt(view.cameraDistanceSquared);
+    if (center.w > 0.0f && cameraDistance > top * 1.5f) {
+        float screenRadius = top / std::sqrt(view.cameraDistanceSquared - top * top) * uniform.projection[1][1] * (SCREEN_HEIGHT / 2.0f) * 1.25f;
+        float centerX = center.x / center.w;
+        float centerY = center.y / center.w;
+        minX = std::max(minX, static_cast<int>(centerX - screenRadius));
+        maxX = std::min(maxX, static_cast<int>(centerX + screenRadius));
+        minY = std::max(minY, static_cast<int>(centerY - screenRadius));
+        maxY = std::min(maxY, static_cast<int>(centerY + screenRadius));
+    } else if (center.w <= 0.0f && cameraDistance > top) {
+        return;
+    }
+
+    glm::vec4 origin = inverseViewProjection * glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+    glm::vec4 stepX = inverseViewProjection[0] * (2.0f / SCREEN_WIDTH);
+    glm::vec4 stepY = inverseViewProjection[1] * (2.0f / SCREEN_HEIGHT);
+    glm::vec3 baseDirection = glm::vec3(origin) - camera * origin.w;
+    glm::vec3 directionStepX = glm::vec3(stepX) - camera * stepX.w;
+    glm::vec3 directionStepY = glm::vec3(stepY) - camera * stepY.w;
+    glm::mat3 toModel(inverseModel);
+
+    const double clearDepth = std::numeric_limits<double>::max();
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            glm::vec3 worldDirection = baseDirection + directionStepX * (x + 0.5f) + directionStepY * (y + 0.5f);
+            glm::vec3 direction = glm::normalize(toModel * worldDirection);
+            ColorF inscattered;
+            if (!shadeAtmosphereLimb(atmosphere, view, direction, inscattered)) {
+                continue;
+            }
+
+            double depth = depthBuffer[y * SCREEN_WIDTH + x];
+            if (depth != clearDepth) {
+                float b = glm::dot(view.camera, direction);
+                float entryDistance = std::max(0.0f, -b - std::sqrt(std::max(0.0f, b * b - view.cameraDistanceSquared + top * top)));
+                glm::vec4 entry = screenTransform * uniform.model * glm::vec4((view.camera + direction * entryDistance) * atmosphere.radius, 1.0f);
+                if (depth < entry.z / entry.w) {
+                    continue;
+                }
+            }
+            // La parte cubierta del píxel HDR está multiplicada por su cobertura; el fondo de 8 bits recibe el resto
+            float coverage = hdr ? hdrCoverage[SCREEN_HEIGHT - y][x] : 0.0f;
+            if (coverage > 0.0f) {
+                ColorF& pixel = hdrFramebuffer[SCREEN_HEIGHT - y][x];
+                storeColorF(pixel, _mm_add_ps(loadColorF(pixel), _mm_mul_ps(loadColorF(inscattered), _mm_set1_ps(coverage))));
+                if (coverage >= 1.0f) {
+                    continue;
+                }
+            }
+            Color& pixel = framebuffer[SCREEN_HEIGHT - y][x];
+            ColorF background = toLinear(pixel);
+            storeColorF(background, _mm_add_ps(loadColorF(background), loadColorF(inscattered)));
+            pixel = fromLinear(background);
+        }
+    }
+}
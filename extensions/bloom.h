@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
+#include "color.h"
+#include "framebuffer.h"
+#include "pixels.h"
+#pragma once
+
+constexpr int BLOOM_LEVELS = 4;
+constexpr float BLOOM_THRESHOLD = 0.75f;
+constexpr float BLOOM_INTENSITY = 0.8f;
+constexpr double BLOOM_BUDGET_MILLISECONDS = 2.0;
+
+// Pesos del gaussiano separable de 9 muestras (sigma ~2), del centro hacia afuera
+constexpr std::array<float, 5> BLOOM_WEIGHTS = {0.227027f, 0.1945946f, 0.1216216f, 0.054054f, 0.016216f};
+
+struct BloomLevel {
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<ColorF> pixels;
+    std::vector<ColorF> scratch;
+    // Filas con algún valor distinto de cero; casi todo el espacio queda fuera y se salta al componer
+    std::vector<Uint8> activeRows;
+};
+
+// Pirámide de brillo en luz lineal; baseShift es la reducción del nivel 0 respecto a la pantalla (1 = mitad,
+// 2 = cuarto) y se ajusta sola para que el pase quepa en BLOOM_BUDGET_MILLISECONDS. Solo se vuelve a la mitad si el
+// costo cabe cuatro veces en el presupuesto, para no alternar entre cuadros
+struct Bloom {
+    std::array<BloomLevel, BLOOM_LEVELS> levels;
+    int baseShift = 1;
+    double lastMilliseconds = 0.0;
+};
+
+// Se queda con la parte del color que pasa el umbral según su canal más brillante; el alfa queda en 0
+inline __m128 bloomBrightPass(__m128 color) {
+    __m128 brightness = _mm_max_ps(color, _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 0, 2, 1)));
+    brightness = _mm_max_ps(brightness, _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 1, 0, 2)));
+    brightness = _mm_shuffle_ps(brightness, brightness, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 excess = _mm_max_ps(_mm_sub_ps(brightness, _mm_set1_ps(BLOOM_THRESHOLD)), _mm_setzero_ps());
+    __m128 contribution = _mm_div_ps(excess, _mm_max_ps(brightness, _mm_set1_ps(1e-4f)));
+    const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    return _mm_and_ps(_mm_mul_ps(color, contribution), rgbMask);
+}
+
+// Nivel 0: promedio de cada bloque de la pantalla y pase de brillo. Con el framebuffer HDR activo la parte cubierta de
+// cada píxel sale de él y el resto del framebuffer de 8 bits
+void extractBloomRows(BloomLevel& level, int shift, bool hdr, size_t firstRow, size_t lastRow) {
+    size_t block = size_t(1) << shift;
+    __m128 average = _mm_set1_ps(1.0f / (block * block));
+    for (size_t y = firstRow; y < lastRow; y++) {
+        for (size_t x = 0; x < level.width; x++) {
+            __m128 sum = _mm_setzero_ps();
+            for (size_t row = y * block; row < (y + 1) * block; row++) {
+                for (size_t column = x * block; column < (x + 1) * block; column++) {
+                    float coverage = hdr ? hdrCoverage[row][column] : 0.0f;
+                    __m128 color = loadColorF(toLinear(framebuffer[row][column]));
+                    if (coverage > 0.0f) {
+                        color = _mm_add_ps(loadColorF(hdrFramebuffer[row][column]), _mm_mul_ps(color, _mm_set1_ps(1.0f - coverage)));
+                    }
+                    sum = _mm_add_ps(sum, color);
+                }
+            }
+            storeColorF(level.pixels[y * level.width + x], bloomBrightPass(_mm_mul_ps(sum, average)));
+        }
+    }
+}
+
+void downsampleBloomRows(const BloomLevel& source, BloomLevel& level, size_t firstRow, size_t lastRow) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (size_t y = firstRow; y < lastRow; y++) {
+        const ColorF* top = &source.pixels[std::min(2 * y, source.height - 1) * source.width];
+        const ColorF* bottom = &source.pixels[std::min(2 * y + 1, source.height - 1) * source.width];
+        for (size_t x = 0; x < level.width; x++) {
+            size_t left = std::min(2 * x, source.width - 1);
+            size_t right = std::min(2 * x + 1, source.width - 1);
+            __m128 sum = _mm_add_ps(_mm_add_ps(loadColorF(top[left]), loadColorF(top[right])), _mm_add_ps(loadColorF(bottom[left]), loadColorF(bottom[right])));
+            storeColorF(level.pixels[y * level.width + x], _mm_mul_ps(sum, quarter));
+        }
+    }
+}
+
+// Pase horizontal de pixels a scratch
+void blurBloomRowsHorizontal(BloomLevel& level, size_t firstRow, size_t lastRow) {
+    int width = static_cast<int>(level.width);
+    for (size_t y = firstRow; y < lastRow; y++) {
+        const ColorF* input = &level.pixels[y * level.width];
+        ColorF* output = &level.scratch[y * level.width];
+        for (int x = 0; x < width; x++) {
+            __m128 sum = _mm_mul_ps(loadColorF(input[x]), _mm_set1_ps(BLOOM_WEIGHTS[0]));
+            for (int tap = 1; tap < static_cast<int>(BLOOM_WEIGHTS.size()); tap++) {
+                __m128 pair = _mm_add_ps(loadColorF(input[std::max(x - tap, 0)]), loadColorF(input[std::min(x + tap, width - 1)]));
+                sum = _mm_add_ps(sum, _mm_mul_ps(pair, _mm_set1_ps(BLOOM_WEIGHTS[tap])));
+            }
+            storeColorF(output[x], sum);
+        }
+    }
+}
+
+// Pase vertical de scratch de vuelta a pixels
+void blurBloomRowsVertical(BloomLevel& level, size_t firstRow, size_t lastRow) {
+    int height = static_cast<int>(level.height);
+    for (size_t y = firstRow; y < lastRow; y++) {
+        std::array<const ColorF*, 2 * BLOOM_WEIGHTS.size() - 1> rows;
+        for (int tap = 0; tap < static_cast<int>(rows.size()); tap++) {
+            int row = std::clamp(static_cast<int>(y) + tap - static_cast<int>(BLOOM_WEIGHTS.size()) + 1, 0, height - 1);
+            rows[tap] = &level.scratch[row * level.width];
+        }
+        ColorF* output = &level.pixels[y * level.width];
+        const int center = static_cast<int>(BLOOM_WEIGHTS.size()) - 1;
+        for (size_t x = 0; x < level.width; x++) {
+            __m128 sum = _mm_mul_ps(loadColorF(rows[center][x]), _mm_set1_ps(BLOOM_WEIGHTS[0]));
+            for (int tap = 1; tap <= center; tap++) {
+                __m128 pair = _mm_add_ps(loadColorF(rows[center - tap][x]), loadColorF(rows[center + tap][x]));
+                sum = _mm_add_ps(sum, _mm_mul_ps(pair, _mm_set1_ps(BLOOM_WEIGHTS[tap])));
+            }
+            storeColorF(output[x], sum);
+        }
+    }
+}
+
+void markActiveBloomRows(BloomLevel& level, size_t firstRow, size_t lastRow) {
+    for (size_t y = firstRow; y < lastRow; y++) {
+        const ColorF* row = &level.pixels[y * level.width];
+        __m128 maximum = _mm_setzero_ps();
+        for (size_t x = 0; x < level.width; x++) {
+            maximum = _mm_max_ps(maximum, loadColorF(row[x]));
+        }
+        level.activeRows[y] = _mm_movemask_ps(_mm_cmpgt_ps(maximum, _mm_setzero_ps())) != 0;
+    }
+}
+
+// Interpola una fila de un nivel a otra resolución: primero entre las dos filas vecinas y después a lo ancho.
+// y va en píxeles de destino y scale pasa de destino a nivel. Devuelve false si ninguna de las dos filas tiene bloom
+bool sampleBloomRow(const BloomLevel& level, size_t y, float scale, size_t width, ColorF* blended, ColorF* output) {
+    float sourceY = std::clamp((y + 0.5f) * scale - 0.5f, 0.0f, float(level.height - 1));
+    size_t y0 = static_cast<size_t>(sourceY);
+    size_t y1 = std::min(y0 + 1, level.height - 1);
+    if (!level.activeRows[y0] && !level.activeRows[y1]) {
+        return false;
+    }
+
+    __m128 fy = _mm_set1_ps(sourceY - y0);
+    const ColorF* row0 = &level.pixels[y0 * level.width];
+    const ColorF* row1 = &level.pixels[y1 * level.width];
+    for (size_t x = 0; x < level.width; x++) {
+        __m128 top = loadColorF(row0[x]);
+        storeColorF(blended[x], _mm_add_ps(top, _mm_mul_ps(fy, _mm_sub_ps(loadColorF(row1[x]), top))));
+    }
+
+    int lastColumn = static_cast<int>(level.width) - 1;
+    for (int x = 0; x < static_cast<int>(width); x++) {
+        float sourceX = std::clamp((x + 0.5f) * scale - 0.5f, 0.0f, float(lastColumn));
+        int x0 = static_cast<int>(sourceX);
+        int x1 = std::min(x0 + 1, lastColumn);
+        __m128 left = loadColorF(blended[x0]);
+        storeColorF(output[x], _mm_add_ps(left, _mm_mul_ps(_mm_set1_ps(sourceX - x0), _mm_sub_ps(loadColorF(blended[x1]), left))));
+    }
+    return true;
+}
+
+// Suma el nivel más grueso, ya desenfocado, sobre el siguiente más fino
+void upsampleBloomRows(const BloomLevel& coarse, BloomLevel& level, size_t firstRow, size_t lastRow) {
+    std::vector<ColorF> blended(coarse.width);
+    std::vector<ColorF> sampled(level.width);
+    for (size_t y = firstRow; y < lastRow; y++) {
+        if (!sampleBloomRow(coarse, y, 0.5f, level.width, blended.data(), sampled.data())) {
+            continue;
+        }
+        ColorF* row = &level.pixels[y * level.width];
+        for (size_t x = 0; x < level.width; x++) {
+            storeColorF(row[x], _mm_add_ps(loadColorF(row[x]), loadColorF(sampled[x])));
+        }
+    }
+    markActiveBloomRows(level, firstRow, lastRow);
+}
+
+// Composición a resolución completa, de a 4 píxeles: la parte cubierta de los píxeles HDR recibe la luz lineal y el fondo
+// de 8 bits la suma saturada, que se hace con addPixelRowSaturate sobre la fila entera. El brillo se codifica con raíz
+// cuadrada (gamma 2) en vez de la tabla sRGB, que para un halo aditivo no se distingue y evita leer la tabla canal por
+// canal. Cada nivel aporta su parte, así que la suma se divide entre BLOOM_LEVELS
+void compositeBloomRows(const BloomLevel& level, int shift, bool hdr, size_t firstRow, size_t lastRow) {
+    const __m128 intensity = _mm_set1_ps(BLOOM_INTENSITY / BLOOM_LEVELS);
+    const __m128 byteScale = _mm_set1_ps(255.0f);
+    float scale = 1.0f / (1 << shift);
+
+    std::vector<ColorF> blended(level.width);
+    std::vector<ColorF> sampled(SCREEN_WIDTH);
+    std::vector<Uint32> glow(SCREEN_WIDTH);
+    for (size_t row = firstRow; row < lastRow; row++) {
+        if (!sampleBloomRow(level, row, scale, SCREEN_WIDTH, blended.data(), sampled.data())) {
+            continue;
+        }
+        const float* coverageRow = hdr ? hdrCoverage[row].data() : nullptr;
+        for (size_t x = 0; x < SCREEN_WIDTH; x += 4) {
+            __m128 bloom[4];
+            for (size_t lane = 0; lane < 4; lane++) {
+                bloom[lane] = _mm_mul_ps(loadColorF(sampled[x + lane]), intensity);
+                // El color HDR está multiplicado por la cobertura, así que la luz también; el fondo recibe la suya
+                // en 8 bits mientras se vea algo de él
+                if (coverageRow && coverageRow[x + lane] > 0.0f) {
+                    ColorF& pixel = hdrFramebuffer[row][x + lane];
+                    storeColorF(pixel, _mm_add_ps(loadColorF(pixel), _mm_mul_ps(bloom[lane], _mm_set1_ps(coverageRow[x + lane]))));
+                    if (coverageRow[x + lane] >= 1.0f) {
+                        bloom[lane] = _mm_setzero_ps();
+                    }
+                }
+                bloom[lane] = _mm_mul_ps(_mm_sqrt_ps(bloom[lane]), byteScale);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(glow.data() + x), floatsToBytes(bloom[0], bloom[1], bloom[2], bloom[3]));
+        }
+        Uint32* pixels = reinterpret_cast<Uint32*>(framebuffer[row].data());
+        addPixelRowSaturate(pixels, glow.data(), pixels, SCREEN_WIDTH);
+    }
+}
+
+// Después de rasterizar y dibujar el cielo, antes de presentar. Cada hilo toma una banda de filas de cada nivel y
+// todos esperan en la barrera entre pases, así los hilos se crean una sola vez por cuadro
+void applyBloom(Bloom& bloom, bool hdr) {
+    static_assert(SCREEN_WIDTH % 4 == 0, "La composición suma de a 4 píxeles");
+    auto start = std::chrono::steady_clock::now();
+
+    int shift = bloom.baseShift;
+    for (int i = 0; i < BLOOM_LEVELS; i++) {
+        BloomLevel& level = bloom.levels[i];
+        level.width = std::max<size_t>(1, SCREEN_WIDTH >> (shift + i));
+        level.height = std::max<size_t>(1, SCREEN_HEIGHT >> (shift + i));
+        level.pixels.resize(level.width * level.height);
+        level.scratch.resize(level.width * level.height);
+        level.activeRows.resize(level.height);
+    }
+
+    size_t bandCount = std::max(1u, std::thread::hardware_concurrency());
+    std::barrier sync(static_cast<std::ptrdiff_t>(bandCount));
+    std::vector<std::thread> bands;
+    for (size_t band = 0; band < bandCount; band++) {
+        bands.emplace_back([&, band]() {
+            auto rows = [&](size_t height) {
+                return std::pair<size_t, size_t>(band * height / bandCount, (band + 1) * height / bandCount);
+            };
+
+            auto [first, last] = rows(bloom.levels[0].height);
+            extractBloomRows(bloom.levels[0], shift, hdr, first, last);
+            sync.arrive_and_wait();
+            for (int i = 1; i < BLOOM_LEVELS; i++) {
+                auto [first, last] = rows(bloom.levels[i].height);
+                downsampleBloomRows(bloom.levels[i - 1], bloom.levels[i], first, last);
+                sync.arrive_and_wait();
+            }
+
+            for (BloomLevel& level : bloom.levels) {
+                auto [first, last] = rows(level.height);
+                blurBloomRowsHorizontal(level, first, last);
+            }
+            sync.arrive_and_wait();
+            for (BloomLevel& level : bloom.levels) {
+                auto [first, last] = rows(level.height);
+                blurBloomRowsVertical(level, first, last);
+            }
+            auto [firstCoarse, lastCoarse] = rows(bloom.levels[BLOOM_LEVELS - 1].height);
+            markActiveBloomRows(bloom.levels[BLOOM_LEVELS - 1], firstCoarse, lastCoarse);
+            sync.arrive_and_wait();
+
+            for (int i = BLOOM_LEVELS - 1; i > 0; i--) {
+                auto [first, last] = rows(bloom.levels[i - 1].height);
+                upsampleBloomRows(bloom.levels[i], bloom.levels[i - 1], first, last);
+                sync.arrive_and_wait();
+            }
+
+            auto [firstScreenRow, lastScreenRow] = rows(SCREEN_HEIGHT);
+            compositeBloomRows(bloom.levels[0], shift, hdr, firstScreenRow, lastScreenRow);
+        });
+    }
+    for (std::thread& band : bands) {
+        band.join();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    bloom.lastMilliseconds = elapsed.count();
+    if (bloom.lastMilliseconds > BLOOM_BUDGET_MILLISECONDS && bloom.baseShift < 2) {
+        bloom.baseShift++;
+    } else if (bloom.lastMilliseconds * 4.0 < BLOOM_BUDGET_MILLISECONDS && bloom.baseShift > 1) {
+        bloom.baseShift--;
+    }
+}
@@ -1,6 +1,10 @@
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
 #include <SDL.h>
+#include "pixels.h"
 #pragma once
 
 struct Color {
@@ -8,23 +12,86 @@ struct Color {
 
     Color(Uint8 red = 0, Uint8 green = 0, Uint8 blue = 0, Uint8 alpha = 255) : r(red), g(green), b(blue), a(alpha) {}
 
+    // Las operaciones pasan por pixels.h con el color empaquetado en un Uint32 (mismo orden de bytes que en memoria)
+    Uint32 toPixel() const {
+        Uint32 pixel;
+        std::memcpy(&pixel, this, sizeof(pixel));
+        return pixel;
+    }
+
+    static Color fromPixel(Uint32 pixel) {
+        return Color(pixel & 0xFF, (pixel >> 8) & 0xFF, (pixel >> 16) & 0xFF, pixel >> 24);
+    }
+
     Color operator+(const Color& other) const {
-        return Color(
-                std::min(255, int(r) + int(other.r)),
-                std::min(255, int(g) + int(other.g)),
-                std::min(255, int(b) + int(other.b)),
-                std::min(255, int(a) + int(other.a))
-        );
+        return fromPixel(addPixelSaturate(toPixel(), other.toPixel()));
     }
 
+    // Se satura antes de convertir a Uint8; convertir primero hacía que los valores mayores a 255 dieran la vuelta
     Color operator*(float factor) const {
-        return Color(
-                std::clamp(static_cast<Uint8>(r * factor), Uint8(0), Uint8(255)),
-                std::clamp(static_cast<Uint8>(g * factor), Uint8(0), Uint8(255)),
-                std::clamp(static_cast<Uint8>(b * factor), Uint8(0), Uint8(255)),
-                std::clamp(static_cast<Uint8>(a * factor), Uint8(0), Uint8(255))
-        );
+        return fromPixel(scalePixelSaturate(toPixel(), factor));
     }
 
     friend Color operator*(float factor, const Color& color);
-};
\ No newline at end of file
+};
+
+static_assert(sizeof(Color) == sizeof(Uint32), "Color se empaqueta como un píxel RGBA8");
+
+// Color lineal en punto flotante para el framebuffer HDR; los valores pueden pasar de 1
+struct ColorF {
+    float r, g, b, a;
+
+    ColorF(float red = 0.0f, float green = 0.0f, float blue = 0.0f, float alpha = 1.0f) : r(red), g(green), b(blue), a(alpha) {}
+
+    ColorF operator+(const ColorF& other) const {
+        return ColorF(r + other.r, g + other.g, b + other.b, a + other.a);
+    }
+
+    ColorF operator*(float factor) const {
+        return ColorF(r * factor, g * factor, b * factor, a * factor);
+    }
+};
+
+inline __m128 loadColorF(const ColorF& color) {
+    return _mm_loadu_ps(&color.r);
+}
+
+inline void storeColorF(ColorF& color, __m128 value) {
+    _mm_storeu_ps(&color.r, value);
+}
+
+// Los colores de los shaders están en sRGB; se decodifican con una tabla de 256 entradas
+inline ColorF toLinear(const Color& color) {
+    static const std::array<float, 256> decode = []() {
+        std::array<float, 256> table;
+        for (int i = 0; i < 256; i++) {
+            float value = i / 255.0f;
+            table[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    return ColorF(decode[color.r], decode[color.g], decode[color.b], color.a / 255.0f);
+}
+
+// Codificación sRGB de valores lineales en [0, 1] muestreados en 4096 pasos
+inline const std::array<Uint8, 4096>& srgbEncodeTable() {
+    static const std::array<Uint8, 4096> encode = []() {
+        std::array<Uint8, 4096> table;
+        for (int i = 0; i < 4096; i++) {
+            float value = i / 4095.0f;
+            float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            table[i] = static_cast<Uint8>(encoded * 255.0f + 0.5f);
+        }
+        return table;
+    }();
+    return encode;
+}
+
+// Vuelve a 8 bits un color lineal ya en [0, 1] (lo que pase de 1 se satura)
+inline Color fromLinear(const ColorF& color) {
+    const std::array<Uint8, 4096>& encode = srgbEncodeTable();
+    __m128 clamped = _mm_min_ps(_mm_max_ps(loadColorF(color), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    alignas(16) int indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(4095.0f)), _mm_set1_ps(0.5f))));
+    return Color(encode[indices[0]], encode[indices[1]], encode[indices[2]], static_cast<Uint8>(indices[3] * 255 / 4095));
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <vector>
+#include "glm/glm.hpp"
+#include "lights.h"
+#include "uniform.h"
+#pragma once
+
+// Eclipses entre esferas sin mapa de sombras: cada tile de pantalla guarda una máscara con los oclusores cuyo cono de
+// penumbra toca a algún receptor del tile, y el píxel solo cruza el rayo hacia el sol con esos
+constexpr int MAX_ECLIPSE_OCCLUDERS = 32;
+
+struct Occluder {
+    glm::vec3 center;
+    float radius; // 0 si el cuerpo no tapa al sol
+};
+
+struct EclipseTiles {
+    std::vector<Occluder> occluders; // El índice de cada oclusor es su bit en las máscaras
+    std::array<Uint32, LIGHT_TILES_X * LIGHT_TILES_Y> masks{};
+    glm::vec3 sunPosition;
+    float sunRadius = 0.0f;
+    size_t shadowedTiles = 0; // Tiles con algún oclusor en el último cuadro
+};
+
+// El cono de penumbra nace en el vértice de las tangentes cruzadas entre el sol y el oclusor y se abre con el seno
+// (Rs + Ro) / D. Un receptor lo toca si su centro está a menos de su radio de la superficie del cono
+bool touchesPenumbra(const EclipseTiles& eclipses, const Occluder& occluder, const Occluder& receiver) {
+    glm::vec3 axis = occluder.center - eclipses.sunPosition;
+    float sunDistance = glm::length(axis);
+    float sine = (eclipses.sunRadius + occluder.radius) / sunDistance;
+    if (sine >= 1.0f) {
+        return false;
+    }
+    axis /= sunDistance;
+    glm::vec3 offset = receiver.center - occluder.center;
+    float along = glm::dot(offset, axis);
+    if (along + receiver.radius <= 0.0f) {
+        return false;
+    }
+    float cosine = std::sqrt(1.0f - sine * sine);
+    float apexDistance = sunDistance * occluder.radius / (eclipses.sunRadius + occluder.radius);
+    float coneRadius = (apexDistance + std::max(along, 0.0f)) * sine / cosine;
+    return glm::length(offset - axis * along) < coneRadius + receiver.radius / cosine;
+}
+
+// Los oclusores también son los receptores: cada uno marca los tiles de su rectángulo en pantalla con los bits de los
+// demás que le pueden hacer sombra. Son pocas esferas, así que alcanza con un hilo
+void buildEclipseTiles(EclipseTiles& eclipses, const std::vector<Occluder>& occluders, const glm::vec3& sunPosition, float sunRadius, const Uniform& uniform) {
+    eclipses.occluders.assign(occluders.begin(), occluders.begin() + std::min<size_t>(occluders.size(), MAX_ECLIPSE_OCCLUDERS));
+    eclipses.sunPosition = sunPosition;
+    eclipses.sunRadius = sunRadius;
+    eclipses.masks.fill(0);
+
+    for (size_t receiver = 0; receiver < eclipses.occluders.size(); receiver++) {
+        const Occluder& body = eclipses.occluders[receiver];
+        if (body.radius <= 0.0f) {
+            continue;
+        }
+        Uint32 mask = 0;
+        for (size_t occluder = 0; occluder < eclipses.occluders.size(); occluder++) {
+            if (occluder != receiver && eclipses.occluders[occluder].radius > 0.0f && touchesPenumbra(eclipses, eclipses.occluders[occluder], body)) {
+                mask |= 1u << occluder;
+            }
+        }
+        int minTileX, maxTileX, minTileY, maxTileY;
+        glm::vec3 center(uniform.view * glm::vec4(body.center, 1.0f));
+        if (mask == 0 || !sphereTileRect(center, body.radius, uniform.projection, minTileX, maxTileX, minTileY, maxTileY)) {
+            continue;
+        }
+        for (int ty = minTileY; ty <= maxTileY; ty++) {
+            for (int tx = minTileX; tx <= maxTileX; tx++) {
+                eclipses.masks[ty * LIGHT_TILES_X + tx] |= mask;
+            }
+        }
+    }
+    eclipses.shadowedTiles = std::count_if(eclipses.masks.begin(), eclipses.masks.end(), [](Uint32 mask) { return mask != 0; });
+}
+
+// Bits de los oclusores centrados en center; el cuerpo que se dibuja no se hace sombra a sí mismo
+Uint32 eclipseOccluderBits(const EclipseTiles& eclipses, const glm::vec3& center) {
+    Uint32 bits = 0;
+    for (size_t i = 0; i < eclipses.occluders.size(); i++) {
+        glm::vec3 offset = eclipses.occluders[i].center - center;
+        if (eclipses.occluders[i].radius > 0.0f && glm::dot(offset, offset) < 1e-8f) {
+            bits |= 1u << i;
+        }
+    }
+    return bits;
+}
+
+// Parte visible del disco del sol desde position (en el mundo). Cada oclusor tapa según cuánto se solapan los dos
+// discos en el cielo: la transición va con un smoothstep de la separación y el máximo es la razón de sus áreas
+inline float eclipseVisibility(const EclipseTiles& eclipses, int x, int y, const glm::vec3& position, Uint32 ignored) {
+    int tileX = std::clamp(x / LIGHT_TILE_SIZE, 0, LIGHT_TILES_X - 1);
+    int tileY = std::clamp(y / LIGHT_TILE_SIZE, 0, LIGHT_TILES_Y - 1);
+    Uint32 mask = eclipses.masks[tileY * LIGHT_TILES_X + tileX] & ~ignored;
+    if (mask == 0) {
+        return 1.0f;
+    }
+
+    glm::vec3 toSun = eclipses.sunPosition - position;
+    float sunDistance = glm::length(toSun);
+    toSun /= sunDistance;
+    float sunAngle = std::asin(std::min(eclipses.sunRadius / sunDistance, 1.0f));
+    float visibility = 1.0f;
+    for (; mask != 0; mask &= mask - 1) {
+        const Occluder& occluder = eclipses.occluders[std::countr_zero(mask)];
+        glm::vec3 toOccluder = occluder.center - position;
+        float along = glm::dot(toOccluder, toSun);
+        if (along <= 0.0f || along >= sunDistance) {
+            continue;
+        }
+        float occluderDistance = glm::length(toOccluder);
+        float occluderAngle = std::asin(std::min(occluder.radius / occluderDistance, 1.0f));
+        float separation = std::acos(std::min(along / occluderDistance, 1.0f));
+        if (separation >= sunAngle + occluderAngle) {
+            continue;
+        }
+        float overlap = std::min((sunAngle + occluderAngle - separation) / (2.0f * std::min(sunAngle, occluderAngle)), 1.0f);
+        float coverage = overlap * overlap * (3.0f - 2.0f * overlap) * std::min(occluderAngle * occluderAngle / (sunAngle * sunAngle), 1.0f);
+        visibility *= 1.0f - coverage;
+    }
+    return visibility;
+}
@@ -7,4 +7,6 @@ struct Fragment {
     Color color;
     float z;
     glm::vec3 original;
+    float footprint = 0.0f;
+    glm::vec3 normal = glm::vec3(0.0f, 0.0f, 1.0f);
 };
\ No newline at end of file
@@ -1,35 +1,124 @@
 #include <array>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
 #include "color.h"
 #pragma once
 
-constexpr size_t SCREEN_WIDTH = 800;
-constexpr size_t SCREEN_HEIGHT = 800;
+constexpr size_t SCREEN_WIDTH = 720;
+constexpr size_t SCREEN_HEIGHT = 480;
 
 std::array<std::array<Color, SCREEN_WIDTH>, SCREEN_HEIGHT> framebuffer;
 
+// Framebuffer lineal HDR con las mismas filas que framebuffer. Guarda el color multiplicado por hdrCoverage, la parte
+// del píxel que cubren las mallas; el resto es el fondo de 8 bits y se mezcla al resolver
+std::array<std::array<ColorF, SCREEN_WIDTH>, SCREEN_HEIGHT> hdrFramebuffer;
+std::array<std::array<float, SCREEN_WIDTH>, SCREEN_HEIGHT> hdrCoverage;
+
+void clearFramebuffer(const Color& clearColor) {
+    for (auto& row : framebuffer) {
+        row.fill(clearColor);
+    }
+}
+
+// Con cobertura 0 el color HDR que haya quedado del cuadro anterior no se lee
+void clearHDRCoverage() {
+    for (auto& row : hdrCoverage) {
+        row.fill(0.0f);
+    }
+}
+
+// La textura se crea una sola vez y se reutiliza en cada cuadro
+SDL_Texture* presentTexture(SDL_Renderer* renderer) {
+    static SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    return texture;
+}
+
+void presentBuffer(SDL_Renderer* renderer, SDL_Texture* texture) {
+    SDL_UnlockTexture(texture);
+    SDL_Rect textureRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    SDL_RenderCopy(renderer, texture, NULL, &textureRect);
+    SDL_RenderPresent(renderer);
+}
+
 void renderBuffer(SDL_Renderer* renderer) {
-    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_Texture* texture = presentTexture(renderer);
 
     void* texturePixels;
     int pitch;
     SDL_LockTexture(texture, NULL, &texturePixels, &pitch);
 
-    Uint32 format = SDL_PIXELFORMAT_ARGB8888;
-    SDL_PixelFormat* mappingFormat = SDL_AllocFormat(format);
+    Uint8* textureRows = static_cast<Uint8*>(texturePixels);
+    for (size_t y = 0; y < SCREEN_HEIGHT; y++) {
+        convertRowToARGB8888(&framebuffer[y][0].r, reinterpret_cast<Uint32*>(textureRows + y * pitch), SCREEN_WIDTH);
+    }
+
+    presentBuffer(renderer, texture);
+}
 
-    Uint32* texturePixels32 = static_cast<Uint32*>(texturePixels);
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            std::cout << "x: " << x << ", y: " << y << std::endl;
-            int index = y * (pitch / sizeof(Uint32)) + x;
-            const Color& color = framebuffer[y][x];
-            texturePixels32[index] = SDL_MapRGBA(mappingFormat, color.r, color.g, color.b, color.a);
+// Curva fílmica ACES (aproximación de Narkowicz) y codificación sRGB por tabla; cada píxel es un __m128 RGBA. Los
+// píxeles cubiertos en parte mezclan el color ya codificado con el fondo de 8 bits según su cobertura
+inline void toneMapRow(const ColorF* hdrRow, const Color* ldrRow, const float* coverageRow, float exposure, Uint32* output) {
+    const std::array<Uint8, 4096>& encode = srgbEncodeTable();
+
+    const __m128 a = _mm_set1_ps(2.51f);
+    const __m128 b = _mm_set1_ps(0.03f);
+    const __m128 c = _mm_set1_ps(2.43f);
+    const __m128 d = _mm_set1_ps(0.59f);
+    const __m128 e = _mm_set1_ps(0.14f);
+    const __m128 tableScale = _mm_set1_ps(4095.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (size_t x = 0; x < SCREEN_WIDTH; x++) {
+        // El fondo (cielo y estrellas) ya viene en 8 bits y se copia tal cual
+        float coverage = coverageRow[x];
+        Uint32 background = pixelToARGB8888(ldrRow[x].toPixel());
+        if (coverage <= 0.0f) {
+            output[x] = background;
+            continue;
+        }
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(&hdrRow[x].r), _mm_set1_ps(exposure / coverage));
+        value = _mm_max_ps(value, _mm_setzero_ps());
+        __m128 numerator = _mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, a), b));
+        __m128 denominator = _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, c), d)), e);
+        __m128 mapped = _mm_min_ps(_mm_div_ps(numerator, denominator), one);
+
+        alignas(16) int indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(mapped, tableScale), half)));
+        output[x] = 0xFF000000u | Uint32(encode[indices[0]]) << 16 | Uint32(encode[indices[1]]) << 8 | Uint32(encode[indices[2]]);
+        if (coverage < 1.0f) {
+            output[x] = interpolatePixel(coverage, 1.0f - coverage, 0.0f, output[x], background, 0);
         }
     }
+}
 
-    SDL_UnlockTexture(texture);
-    SDL_Rect textureRect = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
-    SDL_RenderCopy(renderer, texture, NULL, &textureRect);
-    SDL_DestroyTexture(texture);
-    SDL_RenderPresent(renderer);
-}
\ No newline at end of file
+// Resuelve el framebuffer HDR directo a la textura de presentación: la conversión a 8 bits ocurre una vez por píxel.
+// Las filas se reparten en bandas, una por hilo
+void renderHDRBuffer(SDL_Renderer* renderer, float exposure) {
+    SDL_Texture* texture = presentTexture(renderer);
+
+    void* texturePixels;
+    int pitch;
+    SDL_LockTexture(texture, NULL, &texturePixels, &pitch);
+    Uint32* texturePixels32 = static_cast<Uint32*>(texturePixels);
+    size_t rowPitch = pitch / sizeof(Uint32);
+
+    size_t bandCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t rowsPerBand = (SCREEN_HEIGHT + bandCount - 1) / bandCount;
+    std::vector<std::thread> bands;
+    for (size_t band = 0; band < bandCount; band++) {
+        bands.emplace_back([&, band]() {
+            size_t lastRow = std::min(SCREEN_HEIGHT, (band + 1) * rowsPerBand);
+            for (size_t row = band * rowsPerBand; row < lastRow; row++) {
+                toneMapRow(hdrFramebuffer[row].data(), framebuffer[row].data(), hdrCoverage[row].data(), exposure, texturePixels32 + row * rowPitch);
+            }
+        });
+    }
+    for (std::thread& band : bands) {
+        band.join();
+    }
+
+    presentBuffer(renderer, texture);
+}
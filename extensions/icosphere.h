@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+#include "glm/glm.hpp"
+#include "meshOptimizer.h"
+#include "quantizedMesh.h"
+#include "vertexArray.h"
+#pragma once
+
+// Cadena de niveles de detalle de una esfera generada a partir de un icosaedro: cada nivel divide cada triángulo en
+// cuatro (20, 80, 320, ... triángulos) y lleva las normales exactas de la esfera. Para el geomorphing cada vértice
+// guarda dónde estaba en el nivel anterior: los puntos medios nuevos salen de la cuerda entre sus dos padres
+struct SphereLevel {
+    MeshHandle mesh;
+    std::vector<glm::vec3> coarse;  // Posición de cada vértice en el nivel anterior
+    float edgeAngle;                // Ángulo que abarca una arista vista desde el centro
+};
+
+struct SphereLODChain {
+    std::vector<SphereLevel> levels;
+    float radius;
+};
+
+struct SphereLODSelection {
+    int level;
+    float morph; // 0 se ve como el nivel anterior, 1 es el nivel completo
+};
+
+SphereLODChain generateSphereLODs(float radius, int levelCount) {
+    const float goldenRatio = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    std::vector<glm::vec3> directions = {
+        {-1, goldenRatio, 0}, {1, goldenRatio, 0}, {-1, -goldenRatio, 0}, {1, -goldenRatio, 0},
+        {0, -1, goldenRatio}, {0, 1, goldenRatio}, {0, -1, -goldenRatio}, {0, 1, -goldenRatio},
+        {goldenRatio, 0, -1}, {goldenRatio, 0, 1}, {-goldenRatio, 0, -1}, {-goldenRatio, 0, 1}};
+    for (glm::vec3& direction : directions) {
+        direction = glm::normalize(direction);
+    }
+    std::vector<glm::vec3> parents = directions;
+    std::vector<std::array<int, 3>> triangles = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11}, {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9}, {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}};
+
+    SphereLODChain chain;
+    chain.radius = radius;
+    float edgeAngle = std::acos(glm::dot(directions[0], directions[11]));
+    for (int level = 0; level < levelCount; level++) {
+        if (level > 0) {
+            // Cada arista se parte una sola vez aunque la compartan dos triángulos
+            std::map<std::pair<int, int>, int> midpoints;
+            auto midpoint = [&](int a, int b) {
+                std::pair<int, int> key = std::minmax(a, b);
+                auto found = midpoints.find(key);
+                if (found != midpoints.end()) {
+                    return found->second;
+                }
+                glm::vec3 chord = (directions[a] + directions[b]) * 0.5f;
+                directions.push_back(glm::normalize(chord));
+                parents.push_back(chord);
+                int index = static_cast<int>(directions.size()) - 1;
+                midpoints.emplace(key, index);
+                return index;
+            };
+            // Los vértices que ya existían no se mueven al pasar a este nivel
+            parents = directions;
+            std::vector<std::array<int, 3>> subdivided;
+            for (const std::array<int, 3>& triangle : triangles) {
+                int ab = midpoint(triangle[0], triangle[1]);
+                int bc = midpoint(triangle[1], triangle[2]);
+                int ca = midpoint(triangle[2], triangle[0]);
+                subdivided.push_back({triangle[0], ab, ca});
+                subdivided.push_back({triangle[1], bc, ab});
+                subdivided.push_back({triangle[2], ca, bc});
+                subdivided.push_back({ab, bc, ca});
+            }
+            triangles = std::move(subdivided);
+            edgeAngle *= 0.5f;
+        }
+
+        // La subdivisión siguiente no depende del orden, así que solo la copia que se dibuja pasa por el optimizador
+        IndexedMesh indexed;
+        for (const glm::vec3& direction : directions) {
+            glm::vec3 position = direction * radius;
+            indexed.vertices.push_back(Vertex {position, direction, position, 0.0});
+        }
+        for (const std::array<int, 3>& triangle : triangles) {
+            indexed.indices.insert(indexed.indices.end(), triangle.begin(), triangle.end());
+        }
+        std::vector<size_t> clusters;
+        optimizeVertexCache(indexed.indices, directions.size(), clusters);
+        optimizeOverdraw(indexed.indices, directions, clusters);
+        std::vector<Uint32> remap = optimizeVertexFetch(indexed);
+
+        SphereLevel sphereLevel;
+        sphereLevel.edgeAngle = edgeAngle;
+        sphereLevel.mesh = createMeshHandle(quantizeMesh(indexed));
+        sphereLevel.coarse.resize(indexed.vertices.size());
+        for (size_t v = 0; v < remap.size(); v++) {
+            if (remap[v] != std::numeric_limits<Uint32>::max()) {
+                sphereLevel.coarse[remap[v]] = parents[v] * radius;
+            }
+        }
+        chain.levels.push_back(std::move(sphereLevel));
+    }
+    return chain;
+}
+
+// El error de una arista es la flecha entre la cuerda y el arco, r (1 - cos(θ / 2)), medida en píxeles. Se busca el
+// nivel fraccionario con ese error igual a maxPixelError; la parte fraccionaria es el morph del nivel siguiente
+SphereLODSelection selectSphereLOD(const SphereLODChain& chain, float projectedRadius, float maxPixelError) {
+    int lastLevel = static_cast<int>(chain.levels.size()) - 1;
+    if (projectedRadius <= maxPixelError) {
+        return {0, 1.0f};
+    }
+    float neededAngle = 2.0f * std::acos(std::max(1.0f - maxPixelError / projectedRadius, -1.0f));
+    float continuousLevel = std::log2(chain.levels[0].edgeAngle / std::max(neededAngle, 1e-6f));
+    if (continuousLevel <= 0.0f) {
+        return {0, 1.0f};
+    }
+    if (continuousLevel >= lastLevel) {
+        return {lastLevel, 1.0f};
+    }
+    int level = static_cast<int>(std::ceil(continuousLevel));
+    return {level, continuousLevel - (level - 1)};
+}
+
+// Copia del nivel con los vértices a medio camino entre su posición en el nivel anterior y la final; la normal es
+// siempre la exacta de la dirección morfada. Las cuerdas quedan dentro de la caja de la esfera, así que sirve la misma
+// cuantización
+void morphSphereLevel(const SphereLevel& level, float morph, QuantizedMesh& out) {
+    const QuantizedMesh& mesh = *level.mesh;
+    out.origin = mesh.origin;
+    out.scale = mesh.scale;
+    out.indices = mesh.indices;
+    // Los meshlets del nivel no cubren las posiciones morfadas, así que la copia se dibuja entera
+    out.meshlets.clear();
+    out.vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        glm::vec3 fine = decodePosition(mesh, mesh.vertices[i]);
+        glm::vec3 position = level.coarse[i] + (fine - level.coarse[i]) * morph;
+        out.vertices[i] = quantizeVertex(out, position, glm::normalize(position));
+    }
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "framebuffer.h"
+#include "uniform.h"
+#pragma once
+
+// Luces puntuales repartidas en clusters: tiles de pantalla por rebanadas de profundidad exponenciales entre los planos
+// de la proyección. Cada píxel recorre solo las luces de su cluster
+constexpr int LIGHT_TILE_SIZE = 32;
+constexpr int LIGHT_TILES_X = (SCREEN_WIDTH + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+constexpr int LIGHT_TILES_Y = (SCREEN_HEIGHT + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+constexpr int LIGHT_DEPTH_SLICES = 16;
+constexpr int MAX_LIGHTS_PER_CLUSTER = 32;
+constexpr float LIGHT_CLUSTER_NEAR = 0.1f;
+constexpr float LIGHT_CLUSTER_FAR = 100.0f;
+
+struct PointLight {
+    glm::vec3 position;
+    float radius; // La luz cae suavemente hasta 0 en este radio
+    ColorF color; // Lineal, ya multiplicado por la intensidad
+    bool eclipsed = false; // Los planetas la tapan (solo el sol, que es lo bastante grande para dar sombras)
+};
+
+struct LightCluster {
+    int count = 0;
+    std::array<Uint16, MAX_LIGHTS_PER_CLUSTER> lights;
+};
+
+struct LightClusters {
+    std::vector<PointLight> lights;
+    std::vector<LightCluster> clusters = std::vector<LightCluster>(LIGHT_TILES_X * LIGHT_TILES_Y * LIGHT_DEPTH_SLICES);
+    ColorF ambient = ColorF(0.06f, 0.06f, 0.07f);
+    glm::vec4 depthRow;   // Fila de la vista que da la profundidad positiva de un punto del mundo
+    float sliceScale = 0; // Rebanadas por unidad de log(profundidad / cerca)
+    size_t assigned = 0;  // Entradas escritas en el último cuadro
+    size_t dropped = 0;   // Entradas que no cupieron en su cluster
+};
+
+// Luz ya proyectada: rango de tiles y de rebanadas que puede tocar
+struct LightBounds {
+    glm::vec3 center;
+    int minTileX, maxTileX, minTileY, maxTileY, minSlice, maxSlice;
+};
+
+inline int lightSlice(const LightClusters& clusters, float depth) {
+    if (depth <= LIGHT_CLUSTER_NEAR) {
+        return 0;
+    }
+    return std::min(static_cast<int>(std::log(depth / LIGHT_CLUSTER_NEAR) * clusters.sliceScale), LIGHT_DEPTH_SLICES - 1);
+}
+
+inline float sliceDepth(int slice) {
+    return LIGHT_CLUSTER_NEAR * std::pow(LIGHT_CLUSTER_FAR / LIGHT_CLUSTER_NEAR, static_cast<float>(slice) / LIGHT_DEPTH_SLICES);
+}
+
+inline int lightTile(float ndc, size_t size, int tiles) {
+    return std::clamp(static_cast<int>((ndc + 1.0f) * 0.5f * size / LIGHT_TILE_SIZE), 0, tiles - 1);
+}
+
+// Rectángulo conservador de una esfera de la vista en tiles: cada borde de su caja se divide por la profundidad que lo
+// agranda más. Si la esfera cruza el plano cercano cubre toda la pantalla; devuelve false si queda fuera de ella
+bool sphereTileRect(const glm::vec3& center, float radius, const glm::mat4& projection, int& minTileX, int& maxTileX, int& minTileY, int& maxTileY) {
+    float nearest = -center.z - radius;
+    float farthest = -center.z + radius;
+    if (farthest < LIGHT_CLUSTER_NEAR) {
+        return false;
+    }
+    if (nearest <= LIGHT_CLUSTER_NEAR) {
+        minTileX = 0;
+        maxTileX = LIGHT_TILES_X - 1;
+        minTileY = 0;
+        maxTileY = LIGHT_TILES_Y - 1;
+        return true;
+    }
+    auto project = [&](float coordinate, float scale, float& minimum, float& maximum) {
+        float low = coordinate - radius;
+        float high = coordinate + radius;
+        minimum = scale * std::min(low / nearest, low / farthest);
+        maximum = scale * std::max(high / nearest, high / farthest);
+    };
+    float minX, maxX, minY, maxY;
+    project(center.x, projection[0][0], minX, maxX);
+    project(center.y, projection[1][1], minY, maxY);
+    minTileX = lightTile(minX, SCREEN_WIDTH, LIGHT_TILES_X);
+    maxTileX = lightTile(maxX, SCREEN_WIDTH, LIGHT_TILES_X);
+    minTileY = lightTile(minY, SCREEN_HEIGHT, LIGHT_TILES_Y);
+    maxTileY = lightTile(maxY, SCREEN_HEIGHT, LIGHT_TILES_Y);
+    return minX <= 1.0f && maxX >= -1.0f && minY <= 1.0f && maxY >= -1.0f;
+}
+
+LightBounds boundLight(const LightClusters& clusters, const PointLight& light, const glm::mat4& view, const glm::mat4& projection) {
+    LightBounds bounds;
+    bounds.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+    bounds.minSlice = lightSlice(clusters, -bounds.center.z - light.radius);
+    bounds.maxSlice = lightSlice(clusters, -bounds.center.z + light.radius);
+    if (!sphereTileRect(bounds.center, light.radius, projection, bounds.minTileX, bounds.maxTileX, bounds.minTileY, bounds.maxTileY)) {
+        bounds.maxSlice = -1;
+    }
+    return bounds;
+}
+
+// Llena las rebanadas first, first + step, ...; cada hilo es dueño de sus rebanadas y no necesita candado. La esfera se
+// prueba contra la caja del cluster en la vista para no llenar las esquinas del rectángulo
+void assignLightSlices(LightClusters& clusters, const std::vector<LightBounds>& bounds, const glm::mat4& projection, int first, int step, size_t& assigned, size_t& dropped) {
+    std::array<float, LIGHT_TILES_X + 1> tileX;
+    std::array<float, LIGHT_TILES_Y + 1> tileY;
+    for (int i = 0; i <= LIGHT_TILES_X; i++) {
+        tileX[i] = (std::min<float>(i * LIGHT_TILE_SIZE, SCREEN_WIDTH) * 2.0f / SCREEN_WIDTH - 1.0f) / projection[0][0];
+    }
+    for (int i = 0; i <= LIGHT_TILES_Y; i++) {
+        tileY[i] = (std::min<float>(i * LIGHT_TILE_SIZE, SCREEN_HEIGHT) * 2.0f / SCREEN_HEIGHT - 1.0f) / projection[1][1];
+    }
+
+    for (int slice = first; slice < LIGHT_DEPTH_SLICES; slice += step) {
+        float nearDepth = slice == 0 ? 0.0f : sliceDepth(slice);
+        float farDepth = slice == LIGHT_DEPTH_SLICES - 1 ? std::numeric_limits<float>::max() : sliceDepth(slice + 1);
+        LightCluster* sliceClusters = &clusters.clusters[slice * LIGHT_TILES_X * LIGHT_TILES_Y];
+        for (int i = 0; i < LIGHT_TILES_X * LIGHT_TILES_Y; i++) {
+            sliceClusters[i].count = 0;
+        }
+
+        for (size_t light = 0; light < bounds.size(); light++) {
+            const LightBounds& bound = bounds[light];
+            if (slice < bound.minSlice || slice > bound.maxSlice) {
+                continue;
+            }
+            float radius = clusters.lights[light].radius;
+            float depth = std::clamp(-bound.center.z, nearDepth, farDepth);
+            float depthDistance = -bound.center.z - depth;
+            float nearestDepth = std::max(nearDepth, 1e-4f);
+            float farthestDepth = std::min(farDepth, LIGHT_CLUSTER_FAR);
+            for (int ty = bound.minTileY; ty <= bound.maxTileY; ty++) {
+                // Extremos del tile en la vista a las dos profundidades de la rebanada
+                float lowY = std::min(tileY[ty] * nearestDepth, tileY[ty] * farthestDepth);
+                float highY = std::max(tileY[ty + 1] * nearestDepth, tileY[ty + 1] * farthestDepth);
+                float dy = bound.center.y - std::clamp(bound.center.y, lowY, highY);
+                for (int tx = bound.minTileX; tx <= bound.maxTileX; tx++) {
+                    float lowX = std::min(tileX[tx] * nearestDepth, tileX[tx] * farthestDepth);
+                    float highX = std::max(tileX[tx + 1] * nearestDepth, tileX[tx + 1] * farthestDepth);
+                    float dx = bound.center.x - std::clamp(bound.center.x, lowX, highX);
+                    if (dx * dx + dy * dy + depthDistance * depthDistance > radius * radius) {
+                        continue;
+                    }
+                    LightCluster& cluster = sliceClusters[ty * LIGHT_TILES_X + tx];
+                    if (cluster.count == MAX_LIGHTS_PER_CLUSTER) {
+                        dropped++;
+                        continue;
+                    }
+                    cluster.lights[cluster.count++] = static_cast<Uint16>(light);
+                    assigned++;
+                }
+            }
+        }
+    }
+}
+
+// Se llama una vez por cuadro antes de lanzar los hilos de dibujo, que después solo leen los clusters
+void buildLightClusters(LightClusters& clusters, const std::vector<PointLight>& lights, const Uniform& uniform) {
+    clusters.lights.assign(lights.begin(), lights.begin() + std::min<size_t>(lights.size(), 65536));
+    clusters.sliceScale = LIGHT_DEPTH_SLICES / std::log(LIGHT_CLUSTER_FAR / LIGHT_CLUSTER_NEAR);
+    clusters.depthRow = glm::vec4(-uniform.view[0][2], -uniform.view[1][2], -uniform.view[2][2], -uniform.view[3][2]);
+
+    std::vector<LightBounds> bounds(clusters.lights.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        bounds[i] = boundLight(clusters, clusters.lights[i], uniform.view, uniform.projection);
+    }
+
+    int threadCount = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, LIGHT_DEPTH_SLICES);
+    std::vector<size_t> assigned(threadCount, 0);
+    std::vector<size_t> dropped(threadCount, 0);
+    std::vector<std::thread> threads;
+    for (int thread = 1; thread < threadCount; thread++) {
+        threads.emplace_back(assignLightSlices, std::ref(clusters), std::cref(bounds), std::cref(uniform.projection), thread, threadCount, std::ref(assigned[thread]), std::ref(dropped[thread]));
+    }
+    assignLightSlices(clusters, bounds, uniform.projection, 0, threadCount, assigned[0], dropped[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    clusters.assigned = 0;
+    clusters.dropped = 0;
+    for (int thread = 0; thread < threadCount; thread++) {
+        clusters.assigned += assigned[thread];
+        clusters.dropped += dropped[thread];
+    }
+}
+
+inline const LightCluster& findLightCluster(const LightClusters& clusters, int x, int y, const glm::vec3& position) {
+    float depth = glm::dot(clusters.depthRow, glm::vec4(position, 1.0f));
+    int tileX = std::clamp(x / LIGHT_TILE_SIZE, 0, LIGHT_TILES_X - 1);
+    int tileY = std::clamp(y / LIGHT_TILE_SIZE, 0, LIGHT_TILES_Y - 1);
+    return clusters.clusters[(lightSlice(clusters, depth) * LIGHT_TILES_Y + tileY) * LIGHT_TILES_X + tileX];
+}
+
+// Suma de Lambert con caída (1 - d²/r²)² de una luz; no tiene singularidad en d = 0
+inline __m128 accumulatePointLight(__m128 sum, const PointLight& light, const glm::vec3& position, const glm::vec3& normal, float visibility = 1.0f) {
+    glm::vec3 toLight = light.position - position;
+    float distanceSquared = glm::dot(toLight, toLight);
+    float radiusSquared = light.radius * light.radius;
+    if (distanceSquared >= radiusSquared) {
+        return sum;
+    }
+    float facing = glm::dot(normal, toLight);
+    if (facing <= 0.0f) {
+        return sum;
+    }
+    float window = 1.0f - distanceSquared / radiusSquared;
+    float intensity = facing / std::sqrt(distanceSquared) * window * window * visibility;
+    return _mm_add_ps(sum, _mm_mul_ps(loadColorF(light.color), _mm_set1_ps(intensity)));
+}
+
+// Superficie iluminada por el ambiente y las luces del cluster del píxel (x, y); position y normal van en el mundo.
+// eclipseVisibility es la parte del sol que se ve desde el punto
+ColorF shadeClusteredLights(const LightClusters& clusters, int x, int y, const glm::vec3& position, const glm::vec3& normal, const ColorF& surface, float eclipseVisibility = 1.0f) {
+    const LightCluster& cluster = findLightCluster(clusters, x, y, position);
+    __m128 irradiance = loadColorF(clusters.ambient);
+    for (int i = 0; i < cluster.count; i++) {
+        const PointLight& light = clusters.lights[cluster.lights[i]];
+        irradiance = accumulatePointLight(irradiance, light, position, normal, light.eclipsed ? eclipseVisibility : 1.0f);
+    }
+    ColorF shaded;
+    storeColorF(shaded, _mm_mul_ps(loadColorF(surface), irradiance));
+    shaded.a = surface.a;
+    return shaded;
+}
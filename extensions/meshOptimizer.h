@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <vector>
+#include <SDL.h>
+#include "glm/glm.hpp"
+#include "vertexArray.h"
+#pragma once
+
+// Orden de una malla para el pipeline: se sueldan los vértices repetidos, los triángulos se ordenan para la caché de
+// vértices transformados (Tipsify, Sander, Nehab y Barczak 2007), los grupos que resultan se ordenan para que las
+// caras de afuera se dibujen primero y la prueba de profundidad descarte las de atrás, y los vértices se renumeran en
+// el orden en que se usan
+const int VERTEX_CACHE_SIZE = 16;
+// Un grupo se corta cuando su ACMR local ya está así de cerca del de toda la malla
+const float OVERDRAW_CLUSTER_THRESHOLD = 1.05f;
+const int OVERDRAW_VIEWS = 16;
+const int OVERDRAW_RESOLUTION = 128;
+// Con más grupos que estos no se prueban intercambios: cada prueba vuelve a dibujar la malla en todas las vistas
+const size_t OVERDRAW_SWAP_CLUSTERS = 16;
+
+struct IndexedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<Uint32> indices;
+};
+
+struct MeshStats {
+    float acmr;     // Vértices transformados por triángulo con una caché FIFO de VERTEX_CACHE_SIZE
+    float overdraw; // Píxeles que pasan la prueba de profundidad por píxel cubierto, promedio de varias vistas
+};
+
+// Junta las esquinas con la misma posición y normal
+IndexedMesh weldVertices(const std::vector<Vertex>& triangleList) {
+    IndexedMesh mesh;
+    std::map<std::array<float, 6>, Uint32> welded;
+    for (const Vertex& vertex : triangleList) {
+        std::array<float, 6> key = {vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x, vertex.normal.y, vertex.normal.z};
+        auto [entry, inserted] = welded.emplace(key, static_cast<Uint32>(mesh.vertices.size()));
+        if (inserted) {
+            mesh.vertices.push_back(vertex);
+        }
+        mesh.indices.push_back(entry->second);
+    }
+    return mesh;
+}
+
+std::vector<Vertex> expandIndexedMesh(const IndexedMesh& mesh) {
+    std::vector<Vertex> triangleList;
+    triangleList.reserve(mesh.indices.size());
+    for (Uint32 index : mesh.indices) {
+        triangleList.push_back(mesh.vertices[index]);
+    }
+    return triangleList;
+}
+
+float computeACMR(const std::vector<Uint32>& indices, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE) {
+    if (indices.empty()) {
+        return 0.0f;
+    }
+    // Con la FIFO un vértice está en la caché si entró hace menos de cacheSize fallos
+    std::vector<size_t> insertedAt(vertexCount, std::numeric_limits<size_t>::max());
+    size_t misses = 0;
+    for (Uint32 index : indices) {
+        if (insertedAt[index] == std::numeric_limits<size_t>::max() || misses - insertedAt[index] >= static_cast<size_t>(cacheSize)) {
+            insertedAt[index] = misses++;
+        }
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+// Tipsify: se avanza en abanico alrededor de un vértice y el siguiente es el vecino que sigue en la caché y al que le
+// quedan triángulos; si no hay ninguno se retoma un vértice reciente de la pila o el siguiente sin terminar. clusters
+// recibe el primer triángulo de cada tramo que empieza con la caché fría
+void optimizeVertexCache(std::vector<Uint32>& indices, size_t vertexCount, std::vector<size_t>& clusters, int cacheSize = VERTEX_CACHE_SIZE) {
+    size_t triangleCount = indices.size() / 3;
+    std::vector<Uint32> offsets(vertexCount + 1, 0);
+    for (Uint32 index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<Uint32> adjacency(indices.size());
+    std::vector<Uint32> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<Uint32>(i / 3);
+    }
+    std::vector<int> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        liveTriangles[v] = offsets[v + 1] - offsets[v];
+    }
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<Uint32> deadEnd;
+    std::vector<Uint32> output;
+    output.reserve(indices.size());
+    clusters.clear();
+    int timeStamp = cacheSize + 1;
+    size_t cursor = 0;
+    long fanning = vertexCount > 0 ? 0 : -1;
+    bool coldStart = true;
+
+    while (fanning >= 0) {
+        std::vector<Uint32> candidates;
+        if (coldStart) {
+            clusters.push_back(output.size() / 3);
+            coldStart = false;
+        }
+        for (Uint32 a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            Uint32 triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                Uint32 v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timeStamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timeStamp++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // El mejor candidato es el que entró antes a la caché pero todavía va a estar cuando se terminen sus triángulos
+        long best = -1;
+        int bestPriority = -1;
+        for (Uint32 v : candidates) {
+            if (liveTriangles[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = timeStamp - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        if (best < 0) {
+            while (!deadEnd.empty() && best < 0) {
+                Uint32 v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    best = v;
+                }
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) {
+                    best = static_cast<long>(cursor);
+                    coldStart = true;
+                }
+                cursor++;
+            }
+        }
+        fanning = best;
+    }
+    indices = std::move(output);
+}
+
+// Dibuja la malla con proyección ortográfica desde OVERDRAW_VIEWS direcciones repartidas en la esfera y cuenta cuántas
+// veces se escribe cada píxel cubierto, en el orden del índice
+float computeOverdraw(const std::vector<Uint32>& indices, const std::vector<glm::vec3>& positions) {
+    glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+    for (const glm::vec3& p : positions) {
+        minimum = glm::min(minimum, p);
+        maximum = glm::max(maximum, p);
+    }
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float extent = std::max(glm::length(maximum - minimum) * 0.5f, 1e-6f);
+
+    size_t written = 0, covered = 0;
+    std::vector<float> depth(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION);
+    for (int view = 0; view < OVERDRAW_VIEWS; view++) {
+        float y = 1.0f - 2.0f * (view + 0.5f) / OVERDRAW_VIEWS;
+        float ring = std::sqrt(1.0f - y * y);
+        float angle = view * 2.39996323f;
+        glm::vec3 forward(std::cos(angle) * ring, y, std::sin(angle) * ring);
+        glm::vec3 right = glm::normalize(glm::cross(std::abs(forward.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), forward));
+        glm::vec3 up = glm::cross(forward, right);
+
+        std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+        auto project = [&](const glm::vec3& p) {
+            glm::vec3 offset = p - center;
+            float scale = 0.5f * OVERDRAW_RESOLUTION / extent;
+            return glm::vec3((glm::dot(offset, right) + extent) * scale, (glm::dot(offset, up) + extent) * scale, glm::dot(offset, forward));
+        };
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            glm::vec3 a = project(positions[indices[i]]);
+            glm::vec3 b = project(positions[indices[i + 1]]);
+            glm::vec3 c = project(positions[indices[i + 2]]);
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area == 0.0f) {
+                continue;
+            }
+            int minX = std::max(0, static_cast<int>(std::min({a.x, b.x, c.x})));
+            int maxX = std::min(OVERDRAW_RESOLUTION - 1, static_cast<int>(std::max({a.x, b.x, c.x})));
+            int minY = std::max(0, static_cast<int>(std::min({a.y, b.y, c.y})));
+            int maxY = std::min(OVERDRAW_RESOLUTION - 1, static_cast<int>(std::max({a.y, b.y, c.y})));
+            for (int py = minY; py <= maxY; py++) {
+                for (int px = minX; px <= maxX; px++) {
+                    float sx = px + 0.5f, sy = py + 0.5f;
+                    float w0 = ((b.x - sx) * (c.y - sy) - (b.y - sy) * (c.x - sx)) / area;
+                    float w1 = ((c.x - sx) * (a.y - sy) - (c.y - sy) * (a.x - sx)) / area;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                        continue;
+                    }
+                    float z = w0 * a.z + w1 * b.z + w2 * c.z;
+                    float& stored = depth[py * OVERDRAW_RESOLUTION + px];
+                    if (z < stored) {
+                        covered += stored == std::numeric_limits<float>::max();
+                        stored = z;
+                        written++;
+                    }
+                }
+            }
+        }
+    }
+    return covered > 0 ? static_cast<float>(written) / covered : 0.0f;
+}
+
+// Orden lineal de Sander et al.: los tramos de Tipsify se parten donde su ACMR local ya se acerca al global, y los
+// grupos se ordenan por cuánto mira su normal hacia afuera desde el centro de la malla. Así desde casi cualquier vista
+// las caras de adelante se dibujan antes que las que tapan
+void optimizeOverdraw(std::vector<Uint32>& indices, const std::vector<glm::vec3>& positions, const std::vector<size_t>& hardClusters, float threshold = OVERDRAW_CLUSTER_THRESHOLD) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    float meshACMR = computeACMR(indices, positions.size());
+
+    std::vector<size_t> clusters;
+    std::vector<size_t> insertedAt(positions.size(), std::numeric_limits<size_t>::max());
+    size_t misses = 0;
+    for (size_t c = 0; c < hardClusters.size(); c++) {
+        size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+        clusters.push_back(hardClusters[c]);
+        // Cada grupo empieza con la caché vacía: adelantar el contador de fallos saca de la FIFO todo lo anterior
+        misses += VERTEX_CACHE_SIZE;
+        size_t clusterMisses = 0;
+        for (size_t t = hardClusters[c]; t < end; t++) {
+            for (int corner = 0; corner < 3; corner++) {
+                Uint32 v = indices[t * 3 + corner];
+                if (insertedAt[v] == std::numeric_limits<size_t>::max() || misses - insertedAt[v] >= static_cast<size_t>(VERTEX_CACHE_SIZE)) {
+                    insertedAt[v] = misses++;
+                    clusterMisses++;
+                }
+            }
+            size_t local = t - clusters.back() + 1;
+            if (t + 1 < end && static_cast<float>(clusterMisses) / local <= threshold * meshACMR) {
+                clusters.push_back(t + 1);
+                clusterMisses = 0;
+                misses += VERTEX_CACHE_SIZE;
+            }
+        }
+    }
+
+    std::vector<glm::vec3> centers(clusters.size());
+    std::vector<glm::vec3> normals(clusters.size());
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < end; t++) {
+            const glm::vec3& a = positions[indices[t * 3]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& d = positions[indices[t * 3 + 2]];
+            glm::vec3 cross = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(cross) * 0.5f;
+            center += (a + b + d) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCenter += center;
+        meshArea += area;
+        centers[c] = area > 0.0f ? center / area : positions[indices[clusters[c] * 3]];
+        float normalLength = glm::length(normal);
+        normals[c] = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+    }
+    if (meshArea > 0.0f) {
+        meshCenter /= meshArea;
+    }
+
+    std::vector<size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<float> outward(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        outward[c] = glm::dot(centers[c] - meshCenter, normals[c]);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return outward[a] > outward[b]; });
+
+    auto assemble = [&](const std::vector<size_t>& clusterOrder) {
+        std::vector<Uint32> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : clusterOrder) {
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+        }
+        return sorted;
+    };
+
+    // El orden por normal es una heurística: en mallas convexas casi todos los grupos empatan y puede salir peor que
+    // el de entrada. Se queda el mejor de los dos medido con computeOverdraw y, si hay pocos grupos, se prueba
+    // intercambiar cada par y se deja el cambio sólo si baja
+    std::vector<size_t> inputOrder(clusters.size());
+    std::iota(inputOrder.begin(), inputOrder.end(), 0);
+    float bestOverdraw = computeOverdraw(indices, positions);
+    float sortedOverdraw = order == inputOrder ? bestOverdraw : computeOverdraw(assemble(order), positions);
+    if (sortedOverdraw < bestOverdraw) {
+        bestOverdraw = sortedOverdraw;
+    } else {
+        order = inputOrder;
+    }
+    for (size_t a = 0; a < order.size() && order.size() <= OVERDRAW_SWAP_CLUSTERS; a++) {
+        for (size_t b = a + 1; b < order.size(); b++) {
+            std::swap(order[a], order[b]);
+            float overdraw = computeOverdraw(assemble(order), positions);
+            if (overdraw < bestOverdraw) {
+                bestOverdraw = overdraw;
+            } else {
+                std::swap(order[a], order[b]);
+            }
+        }
+    }
+    indices = assemble(order);
+}
+
+// Renumera los vértices en el orden en que los lee el índice; devuelve el número nuevo de cada vértice viejo para
+// reordenar los datos que el llamador guarde aparte
+std::vector<Uint32> optimizeVertexFetch(IndexedMesh& mesh) {
+    std::vector<Uint32> remap(mesh.vertices.size(), std::numeric_limits<Uint32>::max());
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (Uint32& index : mesh.indices) {
+        if (remap[index] == std::numeric_limits<Uint32>::max()) {
+            remap[index] = static_cast<Uint32>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+    return remap;
+}
+
+MeshStats computeMeshStats(const IndexedMesh& mesh) {
+    std::vector<glm::vec3> positions(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        positions[i] = mesh.vertices[i].position;
+    }
+    return {computeACMR(mesh.indices, mesh.vertices.size()), computeOverdraw(mesh.indices, positions)};
+}
+
+// Las cuatro pasadas en orden; el resultado dibuja exactamente los mismos triángulos
+void optimizeMesh(IndexedMesh& mesh) {
+    std::vector<glm::vec3> positions(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        positions[i] = mesh.vertices[i].position;
+    }
+    std::vector<size_t> clusters;
+    optimizeVertexCache(mesh.indices, mesh.vertices.size(), clusters);
+    optimizeOverdraw(mesh.indices, positions, clusters);
+    optimizeVertexFetch(mesh);
+}
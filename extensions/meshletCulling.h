@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "glm/glm.hpp"
+#include "quantizedMesh.h"
+#include "sphere.h"
+#include "uniform.h"
+#pragma once
+
+// Descarte de meshlets antes de la etapa de vértices: por el cono de normales, por la pirámide de la vista y por una
+// pirámide de profundidad (Hi-Z) armada con el zBuffer
+
+// Cada nivel guarda la profundidad más lejana de los cuatro texels del anterior, así que un texel de cualquier nivel
+// está detrás de todo lo que se dibujó en su zona. Con anchos impares el último texel toma el borde que sobra
+struct DepthPyramid {
+    std::vector<std::vector<double>> levels;
+    std::vector<glm::ivec2> sizes;
+};
+
+void buildDepthPyramid(DepthPyramid& pyramid, const double* depth, int width, int height) {
+    pyramid.sizes.assign(1, glm::ivec2(width, height));
+    while (pyramid.sizes.back().x > 1 || pyramid.sizes.back().y > 1) {
+        glm::ivec2 previous = pyramid.sizes.back();
+        pyramid.sizes.push_back(glm::ivec2((previous.x + 1) / 2, (previous.y + 1) / 2));
+    }
+    pyramid.levels.resize(pyramid.sizes.size());
+    pyramid.levels[0].assign(depth, depth + width * height);
+    for (size_t level = 1; level < pyramid.levels.size(); level++) {
+        const std::vector<double>& source = pyramid.levels[level - 1];
+        glm::ivec2 sourceSize = pyramid.sizes[level - 1];
+        glm::ivec2 size = pyramid.sizes[level];
+        std::vector<double>& target = pyramid.levels[level];
+        target.resize(size.x * size.y);
+        for (int y = 0; y < size.y; y++) {
+            int y0 = 2 * y;
+            int y1 = std::min(2 * y + 1, sourceSize.y - 1);
+            for (int x = 0; x < size.x; x++) {
+                int x0 = 2 * x;
+                int x1 = std::min(2 * x + 1, sourceSize.x - 1);
+                target[y * size.x + x] = std::max({source[y0 * sourceSize.x + x0], source[y0 * sourceSize.x + x1],
+                                                   source[y1 * sourceSize.x + x0], source[y1 * sourceSize.x + x1]});
+            }
+        }
+    }
+}
+
+// Si toda la zona de píxeles [minimum, maximum] ya tiene algo más cerca que depth. Se baja hasta el nivel donde la zona
+// ocupa a lo sumo 2x2 texels
+bool depthPyramidOccludes(const DepthPyramid& pyramid, glm::ivec2 minimum, glm::ivec2 maximum, double depth) {
+    int level = 0;
+    while (level + 1 < static_cast<int>(pyramid.levels.size())
+           && ((maximum.x >> level) - (minimum.x >> level) > 1 || (maximum.y >> level) - (minimum.y >> level) > 1)) {
+        level++;
+    }
+    glm::ivec2 size = pyramid.sizes[level];
+    const std::vector<double>& texels = pyramid.levels[level];
+    double farthest = 0.0;
+    for (int y = minimum.y >> level; y <= std::min(maximum.y >> level, size.y - 1); y++) {
+        for (int x = minimum.x >> level; x <= std::min(maximum.x >> level, size.x - 1); x++) {
+            farthest = std::max(farthest, texels[y * size.x + x]);
+        }
+    }
+    return depth > farthest;
+}
+
+enum MeshletVisibility {
+    MESHLET_CULLED,   // De espaldas o fuera de la vista
+    MESHLET_OCCLUDED, // Detrás de la pirámide de profundidad
+    MESHLET_VISIBLE
+};
+
+// Lo que comparten los meshlets de una instancia
+struct MeshletView {
+    glm::mat4 modelView;
+    glm::mat4 projection;
+    glm::mat4 screenProjection; // viewport * projection, para llegar a la misma profundidad que el zBuffer
+    glm::vec3 camera;           // Cámara en el espacio del modelo
+    float scale;                // Escala más grande del modelo, para llevar los radios a la vista
+    bool coneCulling;
+};
+
+MeshletView createMeshletView(const Uniform& uniform, const QuantizedMesh& mesh) {
+    MeshletView view;
+    view.modelView = uniform.view * uniform.model;
+    view.projection = uniform.projection;
+    view.screenProjection = uniform.viewport * uniform.projection;
+    view.camera = glm::vec3(glm::inverse(view.modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    view.scale = std::max({glm::length(glm::vec3(uniform.model[0])), glm::length(glm::vec3(uniform.model[1])), glm::length(glm::vec3(uniform.model[2]))});
+    // El signo de dot(normal, posición - cámara) no cambia con la matriz del modelo, así que el cono se prueba en el
+    // espacio del modelo. Desde adentro de una malla cerrada, como la cúpula del cielo, solo se ven caras traseras
+    glm::vec3 extent = mesh.scale * 65535.0f;
+    glm::vec3 boxCenter = mesh.origin + extent * 0.5f;
+    view.coneCulling = glm::length(view.camera - boxCenter) > glm::length(extent) * 0.5f;
+    return view;
+}
+
+// Un meshlet mira hacia atrás si todas sus normales se alejan de la cámara desde cualquier punto de su esfera:
+// cos(ángulo al eje) >= seno de la apertura + seno del radio visto desde la cámara (Kapoulkine, meshoptimizer).
+// pyramid puede ser nulo para no probar oclusión
+MeshletVisibility classifyMeshlet(const Meshlet& meshlet, const MeshletView& view, const DepthPyramid* pyramid) {
+    if (view.coneCulling) {
+        glm::vec3 toMeshlet = meshlet.center - view.camera;
+        if (glm::dot(toMeshlet, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toMeshlet) + meshlet.radius) {
+            return MESHLET_CULLED;
+        }
+    }
+
+    glm::vec3 center(view.modelView * glm::vec4(meshlet.center, 1.0f));
+    float radius = meshlet.radius * view.scale;
+    if (!sphereInFrustum(center, radius, view.projection)) {
+        return MESHLET_CULLED;
+    }
+    if (!pyramid || pyramid->levels.empty()) {
+        return MESHLET_VISIBLE;
+    }
+    float nearPlane = view.projection[3][2] / (view.projection[2][2] - 1.0f);
+    if (-center.z - radius <= nearPlane) {
+        return MESHLET_VISIBLE;
+    }
+
+    glm::ivec2 size = pyramid->sizes[0];
+    glm::vec4 bounds = projectedSphereBounds(center, radius, view.projection);
+    glm::ivec2 minimum(std::clamp(static_cast<int>(std::floor((bounds.x + 1.0f) * 0.5f * size.x)), 0, size.x - 1),
+                       std::clamp(static_cast<int>(std::floor((bounds.z + 1.0f) * 0.5f * size.y)), 0, size.y - 1));
+    glm::ivec2 maximum(std::clamp(static_cast<int>(std::floor((bounds.y + 1.0f) * 0.5f * size.x)), 0, size.x - 1),
+                       std::clamp(static_cast<int>(std::floor((bounds.w + 1.0f) * 0.5f * size.y)), 0, size.y - 1));
+    // La profundidad solo depende de z en la proyección perspectiva, así que alcanza con el punto más cercano del eje
+    glm::vec4 nearest = view.screenProjection * glm::vec4(center.x, center.y, center.z + radius, 1.0f);
+    return depthPyramidOccludes(*pyramid, minimum, maximum, nearest.z / nearest.w) ? MESHLET_OCCLUDED : MESHLET_VISIBLE;
+}
@@ -0,0 +1,553 @@
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <emmintrin.h>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "FastNoiseLite.h"
+#include "shaders.h"
+#pragma once
+
+constexpr int NOISE_GRAPH_BATCH = 64;
+
+// Los escalares usan solo el canal 0; los colores usan los cuatro (RGBA de 0 a 255)
+enum NoiseGraphOp {
+    GRAPH_CONSTANT,
+    GRAPH_DEPTH,
+    GRAPH_SAMPLE,
+    GRAPH_ABS,
+    GRAPH_ADD,
+    GRAPH_MULTIPLY,
+    GRAPH_LESS,
+    GRAPH_GREATER,
+    GRAPH_RADIAL,
+    GRAPH_MIX,
+    GRAPH_SCALE
+};
+
+struct NoiseGraphNode {
+    NoiseGraphOp op = GRAPH_CONSTANT;
+    std::array<int, 3> inputs = {-1, -1, -1};
+    glm::vec4 value = glm::vec4(0.0f);
+    glm::vec3 offset = glm::vec3(0.0f);
+    float zoom = 1.0f;
+    int source = -1;
+};
+
+struct NoiseGraphSource {
+    FastNoiseLite noise;
+    int octaves = 1;
+    float frequency = 0.01f;
+    float lacunarity = 2.0f;
+};
+
+struct NoiseGraph {
+    std::vector<NoiseGraphSource> sources;
+    std::vector<NoiseGraphNode> nodes;
+    int output = -1;
+    int foldedNodes = 0;
+    int sharedNodes = 0;
+    int removedNodes = 0;
+};
+
+// Misma aritmética que Color: cada producto se trunca a entero y las sumas saturan en 255
+inline float graphChannelScale(float channel, float factor) {
+    return std::clamp(std::trunc(channel * factor), 0.0f, 255.0f);
+}
+
+glm::vec4 foldGraphNode(const NoiseGraphNode& node, const std::vector<NoiseGraphNode>& nodes) {
+    glm::vec4 a = node.inputs[0] >= 0 ? nodes[node.inputs[0]].value : glm::vec4(0.0f);
+    glm::vec4 b = node.inputs[1] >= 0 ? nodes[node.inputs[1]].value : glm::vec4(0.0f);
+    glm::vec4 t = node.inputs[2] >= 0 ? nodes[node.inputs[2]].value : glm::vec4(0.0f);
+    switch (node.op) {
+        case GRAPH_ABS: return glm::vec4(std::abs(a.x), 0.0f, 0.0f, 0.0f);
+        case GRAPH_ADD: return glm::vec4(a.x + b.x, 0.0f, 0.0f, 0.0f);
+        case GRAPH_MULTIPLY: return glm::vec4(a.x * b.x, 0.0f, 0.0f, 0.0f);
+        case GRAPH_LESS: return glm::vec4(a.x < b.x ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+        case GRAPH_GREATER: return glm::vec4(a.x > b.x ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+        case GRAPH_SCALE: {
+            glm::vec4 result;
+            for (int channel = 0; channel < 4; channel++) {
+                result[channel] = graphChannelScale(a[channel], b.x);
+            }
+            return result;
+        }
+        case GRAPH_MIX: {
+            glm::vec4 result;
+            for (int channel = 0; channel < 4; channel++) {
+                result[channel] = std::min(255.0f, graphChannelScale(a[channel], 1.0f - t.x) + graphChannelScale(b[channel], t.x));
+            }
+            return result;
+        }
+        default: return node.value;
+    }
+}
+
+// Inserta un nodo ya plegando constantes y reutilizando uno idéntico si existe; devuelve su índice
+int addGraphNode(NoiseGraph& graph, NoiseGraphNode node, std::map<std::string, int>& existing) {
+    bool foldable = node.op != GRAPH_CONSTANT && node.op != GRAPH_DEPTH && node.op != GRAPH_SAMPLE && node.op != GRAPH_RADIAL;
+    for (int input : node.inputs) {
+        if (input >= 0 && graph.nodes[input].op != GRAPH_CONSTANT) {
+            foldable = false;
+        }
+    }
+    if (foldable) {
+        node.value = foldGraphNode(node, graph.nodes);
+        node.op = GRAPH_CONSTANT;
+        node.inputs = {-1, -1, -1};
+        graph.foldedNodes++;
+    }
+
+    std::ostringstream key;
+    key << std::hexfloat << node.op << ' ' << node.inputs[0] << ' ' << node.inputs[1] << ' ' << node.inputs[2] << ' '
+        << node.value.x << ' ' << node.value.y << ' ' << node.value.z << ' ' << node.value.w << ' '
+        << node.offset.x << ' ' << node.offset.y << ' ' << node.offset.z << ' ' << node.zoom << ' ' << node.source;
+    auto found = existing.find(key.str());
+    if (found != existing.end()) {
+        graph.sharedNodes++;
+        return found->second;
+    }
+    graph.nodes.push_back(node);
+    existing.emplace(key.str(), static_cast<int>(graph.nodes.size()) - 1);
+    return static_cast<int>(graph.nodes.size()) - 1;
+}
+
+// Quita los nodos que no llegan a la salida y renumera los demás conservando el orden topológico
+void removeDeadGraphNodes(NoiseGraph& graph) {
+    std::vector<bool> live(graph.nodes.size(), false);
+    live[graph.output] = true;
+    for (int i = static_cast<int>(graph.nodes.size()) - 1; i >= 0; i--) {
+        if (live[i]) {
+            for (int input : graph.nodes[i].inputs) {
+                if (input >= 0) {
+                    live[input] = true;
+                }
+            }
+        }
+    }
+    std::vector<int> remap(graph.nodes.size(), -1);
+    std::vector<NoiseGraphNode> liveNodes;
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        if (live[i]) {
+            NoiseGraphNode node = graph.nodes[i];
+            for (int& input : node.inputs) {
+                input = input >= 0 ? remap[input] : -1;
+            }
+            remap[i] = static_cast<int>(liveNodes.size());
+            liveNodes.push_back(node);
+        }
+    }
+    graph.removedNodes = static_cast<int>(graph.nodes.size() - liveNodes.size());
+    graph.output = remap[graph.output];
+    graph.nodes = std::move(liveNodes);
+}
+
+// Un número o una suma de términos donde "phase" es la fase de animación, p. ej. "10+phase"
+float parseGraphNumber(const std::string& text, float animationPhase) {
+    float total = 0.0f;
+    std::istringstream terms(text);
+    std::string term;
+    while (std::getline(terms, term, '+')) {
+        total += term == "phase" ? animationPhase : std::stof(term);
+    }
+    return total;
+}
+
+bool configureGraphSource(NoiseGraphSource& source, const std::string& type, const std::string& key, const std::string& value, float animationPhase) {
+    static const std::map<std::string, FastNoiseLite::NoiseType> noiseTypes = {
+            {"opensimplex2", FastNoiseLite::NoiseType_OpenSimplex2}, {"opensimplex2s", FastNoiseLite::NoiseType_OpenSimplex2S},
+            {"cellular", FastNoiseLite::NoiseType_Cellular}, {"perlin", FastNoiseLite::NoiseType_Perlin},
+            {"valuecubic", FastNoiseLite::NoiseType_ValueCubic}, {"value", FastNoiseLite::NoiseType_Value}};
+    static const std::map<std::string, FastNoiseLite::FractalType> fractalTypes = {
+            {"none", FastNoiseLite::FractalType_None}, {"fbm", FastNoiseLite::FractalType_FBm},
+            {"ridged", FastNoiseLite::FractalType_Ridged}, {"pingpong", FastNoiseLite::FractalType_PingPong}};
+    static const std::map<std::string, FastNoiseLite::CellularDistanceFunction> distanceFunctions = {
+            {"euclidean", FastNoiseLite::CellularDistanceFunction_Euclidean}, {"euclideansq", FastNoiseLite::CellularDistanceFunction_EuclideanSq},
+            {"manhattan", FastNoiseLite::CellularDistanceFunction_Manhattan}, {"hybrid", FastNoiseLite::CellularDistanceFunction_Hybrid}};
+    static const std::map<std::string, FastNoiseLite::CellularReturnType> returnTypes = {
+            {"cellvalue", FastNoiseLite::CellularReturnType_CellValue}, {"distance", FastNoiseLite::CellularReturnType_Distance},
+            {"distance2", FastNoiseLite::CellularReturnType_Distance2}, {"distance2add", FastNoiseLite::CellularReturnType_Distance2Add},
+            {"distance2sub", FastNoiseLite::CellularReturnType_Distance2Sub}, {"distance2mul", FastNoiseLite::CellularReturnType_Distance2Mul},
+            {"distance2div", FastNoiseLite::CellularReturnType_Distance2Div}};
+
+    if (key.empty()) {
+        if (!noiseTypes.contains(type)) {
+            return false;
+        }
+        source.noise.SetNoiseType(noiseTypes.at(type));
+    } else if (key == "seed") {
+        source.noise.SetSeed(std::stoi(value));
+    } else if (key == "frequency") {
+        source.frequency = parseGraphNumber(value, animationPhase);
+        source.noise.SetFrequency(source.frequency);
+    } else if (key == "fractal" && fractalTypes.contains(value)) {
+        source.noise.SetFractalType(fractalTypes.at(value));
+    } else if (key == "octaves") {
+        source.octaves = std::stoi(value);
+        source.noise.SetFractalOctaves(source.octaves);
+    } else if (key == "lacunarity") {
+        source.lacunarity = parseGraphNumber(value, animationPhase);
+        source.noise.SetFractalLacunarity(source.lacunarity);
+    } else if (key == "gain") {
+        source.noise.SetFractalGain(parseGraphNumber(value, animationPhase));
+    } else if (key == "weighted") {
+        source.noise.SetFractalWeightedStrength(parseGraphNumber(value, animationPhase));
+    } else if (key == "pingpong") {
+        source.noise.SetFractalPingPongStrength(parseGraphNumber(value, animationPhase));
+    } else if (key == "jitter") {
+        source.noise.SetCellularJitter(parseGraphNumber(value, animationPhase));
+    } else if (key == "distance" && distanceFunctions.contains(value)) {
+        source.noise.SetCellularDistanceFunction(distanceFunctions.at(value));
+    } else if (key == "return" && returnTypes.contains(value)) {
+        source.noise.SetCellularReturnType(returnTypes.at(value));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Lee un material: una línea por nodo "operación nombre argumentos...", en orden, y "#" para comentarios.
+// Los argumentos son nombres de nodos anteriores, "depth" (la z del fragmento) o números
+bool loadNoiseGraph(const char* path, float animationPhase, NoiseGraph& graph) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Failed to open the file: " << path << std::endl;
+        return false;
+    }
+
+    graph = NoiseGraph();
+    std::map<std::string, int> names;
+    std::map<std::string, int> sourceNames;
+    std::map<std::string, int> existing;
+
+    NoiseGraphNode depthNode;
+    depthNode.op = GRAPH_DEPTH;
+    names["depth"] = addGraphNode(graph, depthNode, existing);
+
+    auto constant = [&](glm::vec4 value) {
+        NoiseGraphNode node;
+        node.value = value;
+        return addGraphNode(graph, node, existing);
+    };
+    auto operand = [&](const std::string& token) {
+        if (names.contains(token)) {
+            return names.at(token);
+        }
+        return constant(glm::vec4(std::stof(token), 0.0f, 0.0f, 0.0f));
+    };
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream iss(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (iss >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        try {
+            const std::string& op = tokens[0];
+            if (op == "output" && tokens.size() == 2) {
+                graph.output = names.at(tokens[1]);
+            } else if (op == "source" && tokens.size() >= 3) {
+                NoiseGraphSource source;
+                bool valid = configureGraphSource(source, tokens[2], "", "", animationPhase);
+                for (size_t i = 3; i < tokens.size() && valid; i++) {
+                    size_t equals = tokens[i].find('=');
+                    valid = equals != std::string::npos && configureGraphSource(source, tokens[2], tokens[i].substr(0, equals), tokens[i].substr(equals + 1), animationPhase);
+                }
+                if (!valid) {
+                    throw std::invalid_argument(op);
+                }
+                sourceNames[tokens[1]] = static_cast<int>(graph.sources.size());
+                graph.sources.push_back(source);
+            } else if (op == "sample" && tokens.size() >= 3) {
+                NoiseGraphNode node;
+                node.op = GRAPH_SAMPLE;
+                node.source = sourceNames.at(tokens[2]);
+                for (size_t i = 3; i < tokens.size(); i++) {
+                    if (tokens[i].starts_with("zoom=")) {
+                        node.zoom = parseGraphNumber(tokens[i].substr(5), animationPhase);
+                    } else if (tokens[i].starts_with("offset=")) {
+                        std::istringstream components(tokens[i].substr(7));
+                        std::string component;
+                        for (int axis = 0; axis < 3 && std::getline(components, component, ','); axis++) {
+                            node.offset[axis] = parseGraphNumber(component, animationPhase);
+                        }
+                    } else {
+                        throw std::invalid_argument(tokens[i]);
+                    }
+                }
+                names[tokens[1]] = addGraphNode(graph, node, existing);
+            } else if (op == "color" && (tokens.size() == 5 || tokens.size() == 6)) {
+                float alpha = tokens.size() == 6 ? std::stof(tokens[5]) : 255.0f;
+                names[tokens[1]] = constant(glm::vec4(std::stof(tokens[2]), std::stof(tokens[3]), std::stof(tokens[4]), alpha));
+            } else if (op == "radial" && tokens.size() == 5) {
+                NoiseGraphNode node;
+                node.op = GRAPH_RADIAL;
+                node.value = glm::vec4(std::stof(tokens[2]), std::stof(tokens[3]), std::stof(tokens[4]), 0.0f);
+                names[tokens[1]] = addGraphNode(graph, node, existing);
+            } else {
+                static const std::map<std::string, std::pair<NoiseGraphOp, size_t>> operators = {
+                        {"abs", {GRAPH_ABS, 1}}, {"add", {GRAPH_ADD, 2}}, {"multiply", {GRAPH_MULTIPLY, 2}},
+                        {"less", {GRAPH_LESS, 2}}, {"greater", {GRAPH_GREATER, 2}}, {"mix", {GRAPH_MIX, 3}}, {"scale", {GRAPH_SCALE, 2}}};
+                auto found = operators.find(op);
+                if (found == operators.end() || tokens.size() != found->second.second + 2) {
+                    throw std::invalid_argument(op);
+                }
+                NoiseGraphNode node;
+                node.op = found->second.first;
+                for (size_t i = 0; i < found->second.second; i++) {
+                    node.inputs[i] = operand(tokens[i + 2]);
+                }
+                names[tokens[1]] = addGraphNode(graph, node, existing);
+            }
+        } catch (const std::exception&) {
+            std::cout << "Invalid noise graph line " << lineNumber << " in " << path << ": " << line << std::endl;
+            graph = NoiseGraph();
+            return false;
+        }
+    }
+
+    if (graph.output < 0) {
+        std::cout << "Noise graph without output: " << path << std::endl;
+        return false;
+    }
+    removeDeadGraphNodes(graph);
+    return true;
+}
+
+// Entradas de un lote de fragmentos en forma SoA; los carriles sobrantes del último grupo de cuatro se ignoran
+struct NoiseGraphBatch {
+    int count = 0;
+    alignas(16) float x[NOISE_GRAPH_BATCH];
+    alignas(16) float y[NOISE_GRAPH_BATCH];
+    alignas(16) float z[NOISE_GRAPH_BATCH];
+    alignas(16) float depth[NOISE_GRAPH_BATCH];
+    alignas(16) float footprint[NOISE_GRAPH_BATCH];
+};
+
+struct alignas(16) NoiseGraphSlot {
+    float channels[4][NOISE_GRAPH_BATCH];
+};
+
+// Estado de evaluación de un hilo: una copia del ruido por nodo de muestreo (cada uno ajusta sus octavas) y los
+// resultados intermedios; las constantes se escriben una sola vez al crearlo. demand guarda un bit por carril
+struct NoiseGraphContext {
+    const NoiseGraph* graph = nullptr;
+    std::vector<FastNoiseLite> noises;
+    std::vector<float> detail;
+    std::vector<bool> dependsOnSample;
+    std::vector<Uint64> demand;
+    std::vector<NoiseGraphSlot> slots;
+};
+
+void createNoiseGraphContext(NoiseGraphContext& context, const NoiseGraph& graph) {
+    context.graph = &graph;
+    context.noises.clear();
+    context.detail.assign(graph.nodes.size(), -1.0f);
+    context.dependsOnSample.assign(graph.nodes.size(), false);
+    context.demand.assign(graph.nodes.size(), 0);
+    context.slots.resize(graph.nodes.size());
+    for (size_t i = 0; i < graph.nodes.size(); i++) {
+        const NoiseGraphNode& node = graph.nodes[i];
+        context.dependsOnSample[i] = node.op == GRAPH_SAMPLE;
+        for (int input : node.inputs) {
+            if (input >= 0 && context.dependsOnSample[input]) {
+                context.dependsOnSample[i] = true;
+            }
+        }
+        context.noises.push_back(node.op == GRAPH_SAMPLE ? graph.sources[node.source].noise : FastNoiseLite());
+        if (node.op == GRAPH_CONSTANT) {
+            for (int channel = 0; channel < 4; channel++) {
+                std::fill(context.slots[i].channels[channel], context.slots[i].channels[channel] + NOISE_GRAPH_BATCH, node.value[channel]);
+            }
+        }
+    }
+}
+
+inline __m128 graphChannelScaleSSE2(__m128 channel, __m128 factor) {
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(channel, factor)));
+    return _mm_min_ps(_mm_max_ps(truncated, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+}
+
+void evaluateNoiseGraphNode(NoiseGraphContext& context, const NoiseGraphBatch& batch, size_t index) {
+    const NoiseGraph& graph = *context.graph;
+    int lanes = (batch.count + 3) & ~3;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    const NoiseGraphNode& node = graph.nodes[index];
+    float (*out)[NOISE_GRAPH_BATCH] = context.slots[index].channels;
+    float (*a)[NOISE_GRAPH_BATCH] = node.inputs[0] >= 0 ? context.slots[node.inputs[0]].channels : nullptr;
+    float (*b)[NOISE_GRAPH_BATCH] = node.inputs[1] >= 0 ? context.slots[node.inputs[1]].channels : nullptr;
+    float (*t)[NOISE_GRAPH_BATCH] = node.inputs[2] >= 0 ? context.slots[node.inputs[2]].channels : nullptr;
+
+    switch (node.op) {
+        case GRAPH_CONSTANT:
+            break;
+        case GRAPH_DEPTH:
+            std::copy(batch.depth, batch.depth + lanes, out[0]);
+            break;
+        case GRAPH_SAMPLE: {
+            // Los carriles pedidos se agrupan de cuatro en cuatro con el mismo detalle y GetNoise4 los evalúa juntos;
+            // un grupo incompleto repite su último carril
+            const NoiseGraphSource& source = graph.sources[node.source];
+            FastNoiseLite& noise = context.noises[index];
+            alignas(16) float groupX[4], groupY[4], groupZ[4], groupNoise[4];
+            int groupLanes[4];
+            int grouped = 0;
+            auto flush = [&]() {
+                for (int slot = grouped; slot < 4; slot++) {
+                    groupX[slot] = groupX[grouped - 1];
+                    groupY[slot] = groupY[grouped - 1];
+                    groupZ[slot] = groupZ[grouped - 1];
+                }
+                noise.GetNoise4(groupX, groupY, groupZ, groupNoise);
+                for (int slot = 0; slot < grouped; slot++) {
+                    out[0][groupLanes[slot]] = groupNoise[slot];
+                }
+                grouped = 0;
+            };
+            for (int lane = 0; lane < batch.count; lane++) {
+                if (!(context.demand[index] >> lane & 1)) {
+                    out[0][lane] = 0.0f;
+                    continue;
+                }
+                float detail = octavesForFootprint(source.octaves, source.frequency * node.zoom, source.lacunarity, batch.footprint[lane]);
+                if (detail != context.detail[index]) {
+                    if (grouped > 0) {
+                        flush();
+                    }
+                    noise.SetFractalDetail(detail);
+                    context.detail[index] = detail;
+                }
+                groupX[grouped] = (batch.x[lane] + node.offset.x) * node.zoom;
+                groupY[grouped] = (batch.y[lane] + node.offset.y) * node.zoom;
+                groupZ[grouped] = (batch.z[lane] + node.offset.z) * node.zoom;
+                groupLanes[grouped++] = lane;
+                if (grouped == 4) {
+                    flush();
+                }
+            }
+            if (grouped > 0) {
+                flush();
+            }
+            break;
+        }
+        case GRAPH_RADIAL: {
+            __m128 centerX = _mm_set1_ps(node.value.x);
+            __m128 centerY = _mm_set1_ps(node.value.y);
+            __m128 radius = _mm_set1_ps(node.value.z);
+            for (int lane = 0; lane < lanes; lane += 4) {
+                __m128 dx = _mm_sub_ps(_mm_load_ps(batch.x + lane), centerX);
+                __m128 dy = _mm_sub_ps(_mm_load_ps(batch.y + lane), centerY);
+                __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+                _mm_store_ps(out[0] + lane, _mm_and_ps(_mm_cmple_ps(distance, radius), one));
+            }
+            break;
+        }
+        case GRAPH_ABS:
+            for (int lane = 0; lane < lanes; lane += 4) {
+                _mm_store_ps(out[0] + lane, _mm_andnot_ps(signMask, _mm_load_ps(a[0] + lane)));
+            }
+            break;
+        case GRAPH_ADD:
+            for (int lane = 0; lane < lanes; lane += 4) {
+                _mm_store_ps(out[0] + lane, _mm_add_ps(_mm_load_ps(a[0] + lane), _mm_load_ps(b[0] + lane)));
+            }
+            break;
+        case GRAPH_MULTIPLY:
+            for (int lane = 0; lane < lanes; lane += 4) {
+                _mm_store_ps(out[0] + lane, _mm_mul_ps(_mm_load_ps(a[0] + lane), _mm_load_ps(b[0] + lane)));
+            }
+            break;
+        case GRAPH_LESS:
+            for (int lane = 0; lane < lanes; lane += 4) {
+                _mm_store_ps(out[0] + lane, _mm_and_ps(_mm_cmplt_ps(_mm_load_ps(a[0] + lane), _mm_load_ps(b[0] + lane)), one));
+            }
+            break;
+        case GRAPH_GREATER:
+            for (int lane = 0; lane < lanes; lane += 4) {
+                _mm_store_ps(out[0] + lane, _mm_and_ps(_mm_cmpgt_ps(_mm_load_ps(a[0] + lane), _mm_load_ps(b[0] + lane)), one));
+            }
+            break;
+        case GRAPH_SCALE:
+            for (int channel = 0; channel < 4; channel++) {
+                for (int lane = 0; lane < lanes; lane += 4) {
+                    _mm_store_ps(out[channel] + lane, graphChannelScaleSSE2(_mm_load_ps(a[channel] + lane), _mm_load_ps(b[0] + lane)));
+                }
+            }
+            break;
+        case GRAPH_MIX:
+            for (int channel = 0; channel < 4; channel++) {
+                for (int lane = 0; lane < lanes; lane += 4) {
+                    __m128 weight = _mm_load_ps(t[0] + lane);
+                    __m128 first = graphChannelScaleSSE2(_mm_load_ps(a[channel] + lane), _mm_sub_ps(one, weight));
+                    __m128 second = graphChannelScaleSSE2(_mm_load_ps(b[channel] + lane), weight);
+                    _mm_store_ps(out[channel] + lane, _mm_min_ps(_mm_add_ps(first, second), _mm_set1_ps(255.0f)));
+                }
+            }
+            break;
+    }
+}
+
+// Primero se evalúa todo lo que no depende del ruido (máscaras, constantes); con eso, un mix cuyo peso ya vale 0 o 1
+// en un carril deja de pedir la rama descartada, y el ruido solo se muestrea en los carriles que alguien usa
+void evaluateNoiseGraph(NoiseGraphContext& context, const NoiseGraphBatch& batch, Color* colors) {
+    const NoiseGraph& graph = *context.graph;
+    for (size_t index = 0; index < graph.nodes.size(); index++) {
+        if (!context.dependsOnSample[index]) {
+            evaluateNoiseGraphNode(context, batch, index);
+        }
+    }
+
+    std::fill(context.demand.begin(), context.demand.end(), 0);
+    context.demand[graph.output] = batch.count == NOISE_GRAPH_BATCH ? ~Uint64(0) : (Uint64(1) << batch.count) - 1;
+    for (int index = static_cast<int>(graph.nodes.size()) - 1; index >= 0; index--) {
+        const NoiseGraphNode& node = graph.nodes[index];
+        Uint64 demand = context.demand[index];
+        if (demand == 0) {
+            continue;
+        }
+        Uint64 firstDemand = demand;
+        Uint64 secondDemand = demand;
+        if (node.op == GRAPH_MIX && !context.dependsOnSample[node.inputs[2]]) {
+            const float* weights = context.slots[node.inputs[2]].channels[0];
+            for (int lane = 0; lane < batch.count; lane++) {
+                if (weights[lane] == 1.0f) {
+                    firstDemand &= ~(Uint64(1) << lane);
+                } else if (weights[lane] == 0.0f) {
+                    secondDemand &= ~(Uint64(1) << lane);
+                }
+            }
+        }
+        for (int input = 0; input < 3; input++) {
+            if (node.inputs[input] >= 0) {
+                context.demand[node.inputs[input]] |= input == 0 ? firstDemand : (input == 1 ? secondDemand : demand);
+            }
+        }
+    }
+
+    for (size_t index = 0; index < graph.nodes.size(); index++) {
+        if (context.dependsOnSample[index]) {
+            evaluateNoiseGraphNode(context, batch, index);
+        }
+    }
+
+    float (*result)[NOISE_GRAPH_BATCH] = context.slots[graph.output].channels;
+    for (int lane = 0; lane < batch.count; lane++) {
+        colors[lane] = Color(static_cast<Uint8>(result[0][lane]), static_cast<Uint8>(result[1][lane]), static_cast<Uint8>(result[2][lane]), static_cast<Uint8>(result[3][lane]));
+    }
+}
@@ -0,0 +1,197 @@
+#include <cstddef>
+#include <cstring>
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include <SDL.h>
+#pragma once
+
+// Píxeles RGBA8 empaquetados: un Uint32 por píxel con los bytes en el orden r, g, b, a, igual que Color en memoria.
+// Las sumas y escalas saturan en 0 y 255 como las operaciones de Color
+
+inline __m128 pixelToFloats(Uint32 pixel) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_cvtsi32_si128(static_cast<int>(pixel));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+
+// Trunca como static_cast<Uint8> después de saturar
+inline __m128i floatsToBytes(__m128 first, __m128 second, __m128 third, __m128 fourth) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maximum = _mm_set1_ps(255.0f);
+    __m128i a = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(first, zero), maximum));
+    __m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(second, zero), maximum));
+    __m128i c = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(third, zero), maximum));
+    __m128i d = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(fourth, zero), maximum));
+    return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+}
+
+inline Uint32 floatsToPixel(__m128 channels) {
+    return static_cast<Uint32>(_mm_cvtsi128_si32(floatsToBytes(channels, channels, channels, channels)));
+}
+
+inline Uint32 addPixelSaturate(Uint32 a, Uint32 b) {
+    return static_cast<Uint32>(_mm_cvtsi128_si32(_mm_adds_epu8(_mm_cvtsi32_si128(static_cast<int>(a)), _mm_cvtsi32_si128(static_cast<int>(b)))));
+}
+
+inline Uint32 scalePixelSaturate(Uint32 pixel, float factor) {
+    return floatsToPixel(_mm_mul_ps(pixelToFloats(pixel), _mm_set1_ps(factor)));
+}
+
+// u * a + v * b + w * c por canal, en el mismo orden de sumas que la versión escalar
+inline Uint32 interpolatePixel(float u, float v, float w, Uint32 a, Uint32 b, Uint32 c) {
+    __m128 weighted = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(u), pixelToFloats(a)), _mm_mul_ps(_mm_set1_ps(v), pixelToFloats(b))), _mm_mul_ps(_mm_set1_ps(w), pixelToFloats(c)));
+    return floatsToPixel(weighted);
+}
+
+// interpolatePixel sobre 4 píxeles con sus propias coordenadas baricéntricas; las sumas van en el mismo orden, así que
+// el resultado es idéntico, pero los 4 se empaquetan a bytes de una vez
+inline void interpolatePixels4(const float* u, const float* v, const float* w, Uint32 a, Uint32 b, Uint32 c, Uint32* out) {
+    __m128 first = pixelToFloats(a);
+    __m128 second = pixelToFloats(b);
+    __m128 third = pixelToFloats(c);
+    __m128 weighted[4];
+    for (int lane = 0; lane < 4; lane++) {
+        weighted[lane] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(u[lane]), first), _mm_mul_ps(_mm_set1_ps(v[lane]), second)), _mm_mul_ps(_mm_set1_ps(w[lane]), third));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), floatsToBytes(weighted[0], weighted[1], weighted[2], weighted[3]));
+}
+
+inline void addPixelsSaturate4(const Uint32* a, const Uint32* b, Uint32* out) {
+    __m128i sum = _mm_adds_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), sum);
+}
+
+inline void scalePixelsSaturate4(const Uint32* in, float factor, Uint32* out) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128 scale = _mm_set1_ps(factor);
+    __m128 first = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale);
+    __m128 second = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale);
+    __m128 third = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale);
+    __m128 fourth = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), floatsToBytes(first, second, third, fourth));
+}
+
+// RGBA en memoria (r en el byte bajo) a ARGB8888 (b en el byte bajo): se intercambian los bytes r y b.
+// Las filas se leen como bytes para poder pasar directamente las filas de Color del framebuffer
+inline Uint32 pixelToARGB8888(Uint32 pixel) {
+    return (pixel & 0xFF00FF00u) | (pixel & 0xFFu) << 16 | (pixel >> 16 & 0xFFu);
+}
+
+inline __m128i pixelsToARGB8888(__m128i pixels) {
+    const __m128i alphaGreen = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+    __m128i red = _mm_slli_epi32(_mm_and_si128(pixels, lowByte), 16);
+    __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowByte);
+    return _mm_or_si128(_mm_and_si128(pixels, alphaGreen), _mm_or_si128(red, blue));
+}
+
+#if defined(__AVX2__)
+inline void addPixelsSaturate8(const Uint32* a, const Uint32* b, Uint32* out) {
+    __m256i sum = _mm256_adds_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), sum);
+}
+
+inline void scalePixelsSaturate8(const Uint32* in, float factor, Uint32* out) {
+    __m256 scale = _mm256_set1_ps(factor);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 maximum = _mm256_set1_ps(255.0f);
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i upperBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4));
+    __m256i channels[4] = {_mm256_cvtepu8_epi32(bytes), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)),
+                           _mm256_cvtepu8_epi32(upperBytes), _mm256_cvtepu8_epi32(_mm_srli_si128(upperBytes, 8))};
+    for (__m256i& channel : channels) {
+        __m256 scaled = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(channel), scale), zero), maximum);
+        channel = _mm256_cvttps_epi32(scaled);
+    }
+    // Los pack de AVX2 trabajan por mitades de 128 bits; el permute devuelve los píxeles a su orden
+    __m256i words = _mm256_packs_epi32(channels[0], channels[1]);
+    __m256i upperWords = _mm256_packs_epi32(channels[2], channels[3]);
+    __m256i packed = _mm256_packus_epi16(words, upperWords);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+}
+
+inline void convertRowToARGB8888(const Uint8* rgba, Uint32* argb, size_t count) {
+    const __m256i alphaGreen = _mm256_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m256i lowByte = _mm256_set1_epi32(0xFF);
+    // El resto se calcula antes del ciclo para que con anchos múltiplos de 8 el ciclo escalar desaparezca
+    size_t vectorCount = count & ~size_t(7);
+    size_t x = 0;
+    for (; x < vectorCount; x += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + x * 4));
+        __m256i red = _mm256_slli_epi32(_mm256_and_si256(pixels, lowByte), 16);
+        __m256i blue = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), lowByte);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(argb + x), _mm256_or_si256(_mm256_and_si256(pixels, alphaGreen), _mm256_or_si256(red, blue)));
+    }
+    for (; x < count; x++) {
+        Uint32 pixel;
+        std::memcpy(&pixel, rgba + x * 4, sizeof(pixel));
+        argb[x] = pixelToARGB8888(pixel);
+    }
+}
+#else
+inline void addPixelsSaturate8(const Uint32* a, const Uint32* b, Uint32* out) {
+    addPixelsSaturate4(a, b, out);
+    addPixelsSaturate4(a + 4, b + 4, out + 4);
+}
+
+inline void scalePixelsSaturate8(const Uint32* in, float factor, Uint32* out) {
+    scalePixelsSaturate4(in, factor, out);
+    scalePixelsSaturate4(in + 4, factor, out + 4);
+}
+
+inline void convertRowToARGB8888(const Uint8* rgba, Uint32* argb, size_t count) {
+    size_t vectorCount = count & ~size_t(3);
+    size_t x = 0;
+    for (; x < vectorCount; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(argb + x), pixelsToARGB8888(pixels));
+    }
+    for (; x < count; x++) {
+        Uint32 pixel;
+        std::memcpy(&pixel, rgba + x * 4, sizeof(pixel));
+        argb[x] = pixelToARGB8888(pixel);
+    }
+}
+#endif
+
+// Filas de cualquier largo: bloques de 8 y 4 y el resto píxel por píxel
+inline void addPixelRowSaturate(const Uint32* a, const Uint32* b, Uint32* out, size_t count) {
+    size_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        addPixelsSaturate8(a + x, b + x, out + x);
+    }
+    for (; x + 4 <= count; x += 4) {
+        addPixelsSaturate4(a + x, b + x, out + x);
+    }
+    for (; x < count; x++) {
+        out[x] = addPixelSaturate(a[x], b[x]);
+    }
+}
+
+inline void scalePixelRowSaturate(const Uint32* in, float factor, Uint32* out, size_t count) {
+    size_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        scalePixelsSaturate8(in + x, factor, out + x);
+    }
+    for (; x + 4 <= count; x += 4) {
+        scalePixelsSaturate4(in + x, factor, out + x);
+    }
+    for (; x < count; x++) {
+        out[x] = scalePixelSaturate(in[x], factor);
+    }
+}
+
+inline void interpolatePixelRow(const float* u, const float* v, const float* w, Uint32 a, Uint32 b, Uint32 c, Uint32* out, size_t count) {
+    size_t x = 0;
+    for (; x + 4 <= count; x += 4) {
+        interpolatePixels4(u + x, v + x, w + x, a, b, c, out + x);
+    }
+    for (; x < count; x++) {
+        out[x] = interpolatePixel(u[x], v[x], w[x], a, b, c);
+    }
+}
@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include "glm/glm.hpp"
+#include "meshOptimizer.h"
+#include "vertexArray.h"
+#pragma once
+
+// Mallas compactas: la posición va en 16 bits por eje relativa a la caja de la malla y la normal en 2x16 bits con la
+// codificación octaédrica, 10 bytes por vértice único contra los 48 de cada esquina de la lista de triángulos. En
+// disco los índices van como diferencias en zigzag con varints y los meshlets van tal cual
+
+struct QuantizedVertex {
+    Uint16 position[3];
+    Sint16 normal[2];
+};
+
+// Tramo de triángulos seguidos del índice con su esfera y el cono de sus normales, para descartarlo entero antes de
+// transformar sus vértices
+struct Meshlet {
+    Uint32 firstIndex;
+    Uint32 indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff; // Seno de la apertura del cono; 1 si las normales abren tanto que nunca miran todas hacia atrás
+};
+
+const size_t MESHLET_TRIANGLES = 64;
+const size_t MESHLET_VERTICES = 64;
+// Cuánto pesa abrir el cono de normales contra agregar un vértice nuevo al elegir el triángulo siguiente
+const float MESHLET_CONE_WEIGHT = 2.0f;
+
+struct QuantizedMesh {
+    glm::vec3 origin;  // Esquina mínima de la caja
+    glm::vec3 scale;   // Tamaño de un paso de cuantización en cada eje
+    std::vector<QuantizedVertex> vertices;
+    std::vector<Uint32> indices;
+    std::vector<Meshlet> meshlets; // Vacío si la malla se dibuja entera
+};
+
+// La esfera unitaria se proyecta al octaedro |x| + |y| + |z| = 1 y la mitad de abajo se dobla sobre las esquinas
+inline void encodeOctahedral(const glm::vec3& normal, Sint16 out[2]) {
+    float inverse = 1.0f / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+    float x = normal.x * inverse;
+    float y = normal.y * inverse;
+    if (normal.z < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = static_cast<Sint16>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+    out[1] = static_cast<Sint16>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline glm::vec3 decodeOctahedral(const Sint16 encoded[2]) {
+    float x = encoded[0] / 32767.0f;
+    float y = encoded[1] / 32767.0f;
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    // Sin ramas: en la mitad de abajo t desdobla las esquinas
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    return glm::normalize(glm::vec3(x, y, z));
+}
+
+inline glm::vec3 decodePosition(const QuantizedMesh& mesh, const QuantizedVertex& vertex) {
+    return mesh.origin + glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) * mesh.scale;
+}
+
+inline QuantizedVertex quantizeVertex(const QuantizedMesh& mesh, const glm::vec3& position, const glm::vec3& normal) {
+    QuantizedVertex vertex;
+    for (int axis = 0; axis < 3; axis++) {
+        float steps = mesh.scale[axis] > 0.0f ? (position[axis] - mesh.origin[axis]) / mesh.scale[axis] : 0.0f;
+        vertex.position[axis] = static_cast<Uint16>(std::lround(std::clamp(steps, 0.0f, 65535.0f)));
+    }
+    encodeOctahedral(normal, vertex.normal);
+    return vertex;
+}
+
+// Lo que recibe el vertex shader; original es la posición en el modelo, igual que en setupVertexArray
+inline Vertex decodeVertex(const QuantizedMesh& mesh, size_t index) {
+    const QuantizedVertex& vertex = mesh.vertices[index];
+    glm::vec3 position = decodePosition(mesh, vertex);
+    return Vertex {position, decodeOctahedral(vertex.normal), position, 0.0};
+}
+
+// Cada meshlet crece desde el primer triángulo libre en el orden del optimizador sumando el vecino que agrega menos
+// vértices y menos abre el cono de normales, hasta llenarse de triángulos o de vértices. La vecindad va por posición,
+// así que cruza las aristas duras que weldVertices deja partidas. Los índices quedan agrupados por meshlet y dentro de
+// cada uno en el orden que traían; las esferas y los conos salen de los vértices ya cuantizados, que son los que se
+// dibujan
+void buildMeshlets(QuantizedMesh& mesh) {
+    size_t triangleCount = mesh.indices.size() / 3;
+    std::map<std::array<Uint16, 3>, Uint32> positionIds;
+    std::vector<Uint32> positionOf(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Uint16* position = mesh.vertices[i].position;
+        positionOf[i] = positionIds.emplace(std::array<Uint16, 3> {position[0], position[1], position[2]}, static_cast<Uint32>(positionIds.size())).first->second;
+    }
+    std::vector<Uint32> adjacencyOffsets(positionIds.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacencyOffsets[positionOf[mesh.indices[i]] + 1]++;
+    }
+    for (size_t p = 0; p < positionIds.size(); p++) {
+        adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+    }
+    std::vector<Uint32> adjacency(adjacencyOffsets.back());
+    std::vector<Uint32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    std::vector<glm::vec3> triangleNormals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int corner = 0; corner < 3; corner++) {
+            adjacency[cursor[positionOf[mesh.indices[t * 3 + corner]]]++] = static_cast<Uint32>(t);
+        }
+        // Normal de la cara según el orden de las esquinas; los triángulos degenerados quedan sin normal y no cuentan
+        // para el cono
+        glm::vec3 a = decodePosition(mesh, mesh.vertices[mesh.indices[t * 3]]);
+        glm::vec3 b = decodePosition(mesh, mesh.vertices[mesh.indices[t * 3 + 1]]);
+        glm::vec3 c = decodePosition(mesh, mesh.vertices[mesh.indices[t * 3 + 2]]);
+        glm::vec3 cross = glm::cross(b - a, c - a);
+        float length = glm::length(cross);
+        triangleNormals[t] = length > 1e-12f ? cross / length : glm::vec3(0.0f);
+    }
+
+    const Uint32 unowned = std::numeric_limits<Uint32>::max();
+    std::vector<bool> assigned(triangleCount, false);
+    std::vector<Uint32> owner(mesh.vertices.size(), unowned);
+    std::vector<Uint32> positionOwner(positionIds.size(), unowned);
+    std::vector<Uint32> triangles;
+    std::vector<Uint32> members;
+    std::vector<Uint32> memberPositions;
+    std::vector<Uint32> indices;
+    indices.reserve(triangleCount * 3);
+    mesh.meshlets.clear();
+
+    auto newVertices = [&](size_t t, Uint32 id) {
+        size_t count = 0;
+        for (int corner = 0; corner < 3; corner++) {
+            count += owner[mesh.indices[t * 3 + corner]] != id;
+        }
+        return count;
+    };
+
+    size_t seed = 0;
+    while (true) {
+        while (seed < triangleCount && assigned[seed]) {
+            seed++;
+        }
+        if (seed == triangleCount) {
+            break;
+        }
+        Uint32 id = static_cast<Uint32>(mesh.meshlets.size());
+        glm::vec3 normalSum(0.0f);
+        size_t next = seed;
+        while (true) {
+            assigned[next] = true;
+            triangles.push_back(static_cast<Uint32>(next));
+            normalSum += triangleNormals[next];
+            for (int corner = 0; corner < 3; corner++) {
+                Uint32 index = mesh.indices[next * 3 + corner];
+                if (owner[index] != id) {
+                    owner[index] = id;
+                    members.push_back(index);
+                }
+                if (positionOwner[positionOf[index]] != id) {
+                    positionOwner[positionOf[index]] = id;
+                    memberPositions.push_back(positionOf[index]);
+                }
+            }
+            if (triangles.size() >= MESHLET_TRIANGLES) {
+                break;
+            }
+
+            glm::vec3 axis = glm::length(normalSum) > 1e-4f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            float bestScore = std::numeric_limits<float>::max();
+            size_t best = triangleCount;
+            for (Uint32 position : memberPositions) {
+                for (Uint32 a = adjacencyOffsets[position]; a < adjacencyOffsets[position + 1]; a++) {
+                    Uint32 candidate = adjacency[a];
+                    if (assigned[candidate]) {
+                        continue;
+                    }
+                    size_t added = newVertices(candidate, id);
+                    if (members.size() + added > MESHLET_VERTICES) {
+                        continue;
+                    }
+                    float score = added + MESHLET_CONE_WEIGHT * (1.0f - glm::dot(triangleNormals[candidate], axis));
+                    if (score < bestScore || (score == bestScore && candidate < best)) {
+                        bestScore = score;
+                        best = candidate;
+                    }
+                }
+            }
+            if (best == triangleCount) {
+                break;
+            }
+            next = best;
+        }
+
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<Uint32>(indices.size());
+        meshlet.indexCount = static_cast<Uint32>(triangles.size() * 3);
+        std::sort(triangles.begin(), triangles.end());
+        for (Uint32 t : triangles) {
+            indices.insert(indices.end(), mesh.indices.begin() + t * 3, mesh.indices.begin() + t * 3 + 3);
+        }
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+        for (Uint32 member : members) {
+            glm::vec3 position = decodePosition(mesh, mesh.vertices[member]);
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+        }
+        meshlet.center = (minimum + maximum) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (Uint32 member : members) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(decodePosition(mesh, mesh.vertices[member]) - meshlet.center));
+        }
+        // El cono sale de las normales de las caras, como en meshoptimizer: render no descarta caras de atrás, así que
+        // con las normales interpoladas de los vértices un triángulo de frente podía quedar fuera del cono
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+        glm::vec3 faceNormalSum(0.0f);
+        for (Uint32 t : triangles) {
+            faceNormalSum += triangleNormals[t];
+        }
+        if (glm::length(faceNormalSum) > 1e-4f) {
+            meshlet.coneAxis = glm::normalize(faceNormalSum);
+            float minimumDot = 1.0f;
+            for (Uint32 t : triangles) {
+                if (triangleNormals[t] != glm::vec3(0.0f)) {
+                    minimumDot = std::min(minimumDot, glm::dot(meshlet.coneAxis, triangleNormals[t]));
+                }
+            }
+            if (minimumDot > 0.0f) {
+                meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+            }
+        }
+        mesh.meshlets.push_back(meshlet);
+        triangles.clear();
+        members.clear();
+        memberPositions.clear();
+    }
+    indices.insert(indices.end(), mesh.indices.begin() + triangleCount * 3, mesh.indices.end());
+    mesh.indices = std::move(indices);
+}
+
+// La caja sale de las posiciones, así que puede ensancharse con margin para que quepan vértices que se muevan después
+QuantizedMesh quantizeMesh(const IndexedMesh& indexed, float margin = 0.0f) {
+    QuantizedMesh mesh;
+    glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : indexed.vertices) {
+        minimum = glm::min(minimum, vertex.position);
+        maximum = glm::max(maximum, vertex.position);
+    }
+    if (indexed.vertices.empty()) {
+        minimum = maximum = glm::vec3(0.0f);
+    }
+    mesh.origin = minimum - glm::vec3(margin);
+    mesh.scale = (maximum - minimum + glm::vec3(2.0f * margin)) / 65535.0f;
+    mesh.vertices.reserve(indexed.vertices.size());
+    for (const Vertex& vertex : indexed.vertices) {
+        mesh.vertices.push_back(quantizeVertex(mesh, vertex.position, vertex.normal));
+    }
+    mesh.indices = indexed.indices;
+    buildMeshlets(mesh);
+    return mesh;
+}
+
+// De la lista de triángulos de setupVertexArray a la malla que dibuja render, pasando por el optimizador si se pide
+QuantizedMesh createQuantizedMesh(const std::vector<Vertex>& triangleList, bool optimize) {
+    IndexedMesh indexed = weldVertices(triangleList);
+    if (optimize) {
+        optimizeMesh(indexed);
+    }
+    return quantizeMesh(indexed);
+}
+
+// Las mallas no cambian después de crearse, así que todas las instancias y los hilos que las dibujan comparten una
+typedef std::shared_ptr<const QuantizedMesh> MeshHandle;
+
+MeshHandle createMeshHandle(QuantizedMesh mesh) {
+    return std::make_shared<const QuantizedMesh>(std::move(mesh));
+}
+
+size_t quantizedMeshBytes(const QuantizedMesh& mesh) {
+    return sizeof(QuantizedMesh) + mesh.vertices.size() * sizeof(QuantizedVertex) + mesh.indices.size() * sizeof(Uint32) + mesh.meshlets.size() * sizeof(Meshlet);
+}
+
+// Después del optimizador los índices vecinos están cerca, así que la diferencia con el anterior casi siempre entra
+// en un byte
+std::vector<Uint8> encodeIndices(const std::vector<Uint32>& indices) {
+    std::vector<Uint8> encoded;
+    Uint32 previous = 0;
+    for (Uint32 index : indices) {
+        Sint32 delta = static_cast<Sint32>(index - previous);
+        Uint32 zigzag = (static_cast<Uint32>(delta) << 1) ^ static_cast<Uint32>(delta >> 31);
+        while (zigzag >= 0x80) {
+            encoded.push_back(static_cast<Uint8>(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        encoded.push_back(static_cast<Uint8>(zigzag));
+        previous = index;
+    }
+    return encoded;
+}
+
+bool decodeIndices(const std::vector<Uint8>& encoded, size_t count, std::vector<Uint32>& indices) {
+    indices.resize(count);
+    size_t cursor = 0;
+    Uint32 previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        Uint32 zigzag = 0;
+        for (int shift = 0;; shift += 7) {
+            if (cursor >= encoded.size() || shift > 28) {
+                return false;
+            }
+            Uint8 byte = encoded[cursor++];
+            zigzag |= static_cast<Uint32>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        Sint32 delta = static_cast<Sint32>(zigzag >> 1) ^ -static_cast<Sint32>(zigzag & 1);
+        previous += static_cast<Uint32>(delta);
+        indices[i] = previous;
+    }
+    return cursor == encoded.size();
+}
+
+struct QuantizedMeshHeader {
+    char magic[4];
+    Uint32 vertexCount;
+    Uint32 indexCount;
+    Uint32 encodedIndexBytes;
+    Uint32 meshletCount;
+    glm::vec3 origin;
+    glm::vec3 scale;
+};
+
+bool saveQuantizedMesh(const std::string& path, const QuantizedMesh& mesh) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to write mesh " << path << std::endl;
+        return false;
+    }
+    std::vector<Uint8> encoded = encodeIndices(mesh.indices);
+    QuantizedMeshHeader header = {{'Q', 'M', 'S', '2'}, static_cast<Uint32>(mesh.vertices.size()), static_cast<Uint32>(mesh.indices.size()), static_cast<Uint32>(encoded.size()), static_cast<Uint32>(mesh.meshlets.size()), mesh.origin, mesh.scale};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(QuantizedVertex));
+    file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+    return static_cast<bool>(file);
+}
+
+bool loadQuantizedMesh(const std::string& path, QuantizedMesh& mesh) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open the file: " << path << std::endl;
+        return false;
+    }
+    QuantizedMeshHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, "QMS2", 4) != 0) {
+        std::cout << "Mesh " << path << " is not a quantized mesh" << std::endl;
+        return false;
+    }
+    mesh.origin = header.origin;
+    mesh.scale = header.scale;
+    mesh.vertices.resize(header.vertexCount);
+    mesh.meshlets.resize(header.meshletCount);
+    std::vector<Uint8> encoded(header.encodedIndexBytes);
+    file.read(reinterpret_cast<char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(QuantizedVertex));
+    file.read(reinterpret_cast<char*>(encoded.data()), encoded.size());
+    file.read(reinterpret_cast<char*>(mesh.meshlets.data()), mesh.meshlets.size() * sizeof(Meshlet));
+    if (!file || !decodeIndices(encoded, header.indexCount, mesh.indices)) {
+        std::cout << "Mesh " << path << " is truncated" << std::endl;
+        return false;
+    }
+    for (Uint32 index : mesh.indices) {
+        if (index >= mesh.vertices.size()) {
+            std::cout << "Mesh " << path << " has an index out of range" << std::endl;
+            return false;
+        }
+    }
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        if (static_cast<size_t>(meshlet.firstIndex) + meshlet.indexCount > mesh.indices.size()) {
+            std::cout << "Mesh " << path << " has a meshlet out of range" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
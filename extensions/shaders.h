@@ -25,9 +25,47 @@ Vertex vertexShader(const Vertex& vertex, const Uniform& uniform) {
     return Vertex {vertexRedux, normal, vertex.position, z};
 }
 
-float nextTime = 0.5f;
+// Lo mismo que vertexShader con las matrices ya multiplicadas, para las instancias que transforman toda una malla con
+// el mismo modelo
+Vertex transformVertex(const Vertex& vertex, const glm::mat4& modelViewProjection, const glm::mat4& viewport, const glm::mat3& normalMatrix) {
+    glm::vec4 transformedVertex = modelViewProjection * glm::vec4(vertex.position, 1.0f);
+    double z = transformedVertex.z;
+    transformedVertex = viewport * transformedVertex;
+    glm::vec3 vertexRedux(transformedVertex.x / transformedVertex.w, transformedVertex.y / transformedVertex.w, transformedVertex.z / transformedVertex.w);
+    return Vertex {vertexRedux, glm::normalize(normalMatrix * vertex.normal), vertex.position, z};
+}
+
+// Cuántas octavas evaluar (para FastNoiseLite::SetFractalDetail); footprint es cuánto del espacio del objeto cubre un
+// píxel y cyclesPerUnit la frecuencia de la primera octava (frecuencia * zoom). La primera octava siempre queda; las
+// demás se desvanecen mientras su longitud de onda baja de cuatro a dos píxeles, así el detalle no salta al alejarse
+float octavesForFootprint(int octaves, float cyclesPerUnit, float lacunarity, float footprint) {
+    if (footprint <= 0.0f) {
+        return static_cast<float>(octaves);
+    }
+    float cyclesPerPixel = cyclesPerUnit * footprint;
+    float visibleOctaves = 1.0f;
+    while (visibleOctaves < octaves) {
+        cyclesPerPixel *= lacunarity;
+        float weight = std::clamp(std::log2(0.5f / cyclesPerPixel), 0.0f, 1.0f);
+        visibleOctaves += weight;
+        if (weight < 1.0f) {
+            break;
+        }
+    }
+    return visibleOctaves;
+}
 
-Color fragmentShader(Fragment& fragment) {
+// Sombreado del relieve con la normal perturbada por el gradiente del ruido (en espacio del objeto); strength es la altura
+// del relieve. Solo oscurece lo que la normal perturbada aparta del sol: la caída de Lambert la ponen las luces
+float bumpLighting(const Fragment& fragment, const Uniform& uniform, const glm::vec3& noiseGradient, float strength) {
+    glm::vec3 gradient = glm::transpose(glm::inverse(glm::mat3(uniform.model))) * noiseGradient;
+    glm::vec3 tangentGradient = gradient - fragment.normal * glm::dot(gradient, fragment.normal);
+    glm::vec3 bumpedNormal = glm::normalize(fragment.normal - tangentGradient * strength);
+    glm::vec3 toSun = glm::normalize(uniform.frame.sunPosition - glm::vec3(uniform.model * glm::vec4(fragment.original, 1.0f)));
+    return std::clamp(1.0f + glm::dot(bumpedNormal - fragment.normal, toSun), 0.0f, 1.0f);
+}
+
+Color fragmentShader(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -42,7 +80,7 @@ Color fragmentShader(Fragment& fragment) {
     // Configuración de ruido fractal para variaciones
     noise.SetFractalType(FastNoiseLite::FractalType_PingPong); // Tipo de ruido fractal
     noise.SetFractalOctaves(2); // Número de octavas
-    noise.SetFractalLacunarity(8 + nextTime); // Lacunarity (variación en la frecuencia)
+    noise.SetFractalLacunarity(8 + uniform.animationPhase); // Lacunarity (variación en la frecuencia)
     noise.SetFractalGain(0.9f); // Ganancia
     noise.SetFractalWeightedStrength(0.80f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(10); // Fuerza de ping pong
@@ -51,6 +89,7 @@ Color fragmentShader(Fragment& fragment) {
     float ox = 15.0f; // Desplazamiento en X
     float oy = 15.0f; // Desplazamiento en Y
     float zoom = 3000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(2, 0.035f * zoom, 8 + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     // Obtener el valor de ruido en función de la posición y el zoom
     float noiseValue = abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
@@ -66,10 +105,8 @@ Color fragmentShader(Fragment& fragment) {
     return Color(0, 0, 0, 255); // Color negro para el espacio
 }
 
-Color fragmentShaderSun(Fragment& fragment) {
-    // Obtiene las coordenadas del fragmento en el espacio 2D
-    glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
-
+// Ruido celular del sol; la búsqueda de vecinos usa SSE2 (SetCellularSIMD) y da el mismo resultado que la escalar
+FastNoiseLite createSunNoise(const Uniform& uniform) {
     // Crear un objeto FastNoiseLite para generar ruido
     FastNoiseLite noise;
 
@@ -81,7 +118,7 @@ Color fragmentShaderSun(Fragment& fragment) {
     // Configuración de ruido fractal para variaciones
     noise.SetFractalType(FastNoiseLite::FractalType_PingPong); // Tipo de ruido fractal
     noise.SetFractalOctaves(2); // Número de octavas
-    noise.SetFractalLacunarity(10 + nextTime); // Lacunarity (variación en la frecuencia)
+    noise.SetFractalLacunarity(10 + uniform.animationPhase); // Lacunarity (variación en la frecuencia)
     noise.SetFractalGain(1.0f); // Ganancia
     noise.SetFractalWeightedStrength(0.80f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(10); // Fuerza de ping pong
@@ -91,45 +128,53 @@ Color fragmentShaderSun(Fragment& fragment) {
     noise.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance2Add); // Tipo de retorno celular
     noise.SetCellularJitter(20); // Jitter (variación en las celdas)
 
-    // Definir el rango de colores desde amarillo hasta rojo
-    Color yellowColor(255, 255, 0, 255);
-    Color redColor(255, 75, 0, 255);
-    Color flareColor(255, 0, 0, 255); // Color de las llamaradas (ajusta según tus preferencias)
+    return noise;
+}
+
+// Valor del ruido celular del sol en el fragmento, compartido por la versión de 8 bits y la HDR
+float sunNoiseValue(const Fragment& fragment, const Uniform& uniform) {
+    // Crear un objeto FastNoiseLite para generar ruido
+    FastNoiseLite noise = createSunNoise(uniform);
 
     // Parámetros para la rotación del sol
     float ox = 3000.0f; // Desplazamiento en X
     float oy = 3000.0f; // Desplazamiento en Y
     float zoom = 5000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(2, 0.005f * zoom, 10 + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     // Obtener el valor de ruido en función de la posición y el zoom
-    float noiseValue = abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
-
-    // Aplicar un color amarillo si el valor de ruido es bajo, de lo contrario, aplicar rojo
-    Color tmpColor = (noiseValue < 0.5f) ? redColor : yellowColor;
+    return abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
+}
 
-    // Agregar efecto de llamaradas de fuego
-    float flareIntensity = 2.0f;
-    float oxf = 6000.0f; // Desplazamiento en X
-    float oyf = 6000.0f; // Desplazamiento en Y
-    float zoomf = 8000.0f; // Factor de zoom (ajusta según tus preferencias)
+Color fragmentShaderSun(Fragment& fragment, const Uniform& uniform) {
+    // Definir el rango de colores desde amarillo hasta rojo
+    Color yellowColor(255, 255, 0, 255);
+    Color redColor(255, 75, 0, 255);
 
-    float noiseValuef = abs(noise.GetNoise((fragment.original.x + oxf) * zoomf, (fragment.original.y + oyf) * zoomf, fragment.original.z * zoomf));
+    float noiseValue = sunNoiseValue(fragment, uniform);
 
-    if (noiseValuef > 0.9f) {
-        /*  tmpColor = flareColor; */
-    }
+    // Aplicar un color amarillo si el valor de ruido es bajo, de lo contrario, aplicar rojo
+    Color tmpColor = (noiseValue < 0.5f) ? redColor : yellowColor;
 
-    // Multiplicar el color por la coordenada Z para simular la perspectiva
+    // Multiplicar el color por la coordenada Z para simular la perspectiva; el brillo alrededor lo agrega el bloom
     fragment.color = tmpColor * fragment.z;
-    fragment.color = fragment.color + (flareColor * flareIntensity);
-
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
 
     return fragment.color;
 }
 
-Color fragmentShaderEarth(Fragment& fragment) {
+// Versión HDR: la superficie emite luz lineal por encima de 1 en vez de saturar en 255; el bloom la esparce y el tone
+// map la comprime
+ColorF fragmentShaderSunHDR(Fragment& fragment, const Uniform& uniform) {
+    ColorF yellowColor = toLinear(Color(255, 255, 0, 255));
+    ColorF redColor = toLinear(Color(255, 75, 0, 255));
+    float emission = 3.0f;
+
+    float yellowWeight = sunNoiseValue(fragment, uniform) < 0.5f ? 0.0f : 1.0f;
+    ColorF surfaceColor = redColor * (1.0f - yellowWeight) + yellowColor * yellowWeight;
+    return surfaceColor * (fragment.z * emission);
+}
+
+Color fragmentShaderEarth(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -140,7 +185,7 @@ Color fragmentShaderEarth(Fragment& fragment) {
     noise.SetFrequency(0.0002f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(3);
-    noise.SetFractalLacunarity(10.0f + nextTime);
+    noise.SetFractalLacunarity(10.0f + uniform.animationPhase);
     noise.SetFractalGain(0.2f);
     noise.SetFractalWeightedStrength(0.50f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(10); // Fuerza de ping pong
@@ -160,6 +205,7 @@ Color fragmentShaderEarth(Fragment& fragment) {
     float ox = 3000.0f; // Desplazamiento en X
     float oy = 3000.0f; // Desplazamiento en Y
     float zoom = 5000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(3, 0.0002f * zoom, 10.0f + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     // Obtener el valor de ruido en función de la posición y el zoom
     float noiseValue = abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
@@ -170,6 +216,7 @@ Color fragmentShaderEarth(Fragment& fragment) {
     float oxc = 5000.0f; // Desplazamiento en X
     float oyc = 5000.0f; // Desplazamiento en Y
     float zoomc = 8000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(3, 0.0002f * zoomc, 10.0f + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     float noiseValueC = abs(noise.GetNoise((fragment.original.x + oxc) * zoomc, (fragment.original.y + oyc) * zoomc, fragment.original.z * zoomc));
 
@@ -201,13 +248,10 @@ Color fragmentShaderEarth(Fragment& fragment) {
         fragment.color = fragment.color;
     }
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
-
     return fragment.color;
 }
 
-Color fragmentShaderMars(Fragment& fragment) {
+Color fragmentShaderMars(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -218,7 +262,7 @@ Color fragmentShaderMars(Fragment& fragment) {
     noise.SetFrequency(0.006f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(2);
-    noise.SetFractalLacunarity(4.0f + nextTime);
+    noise.SetFractalLacunarity(4.0f + uniform.animationPhase);
     noise.SetFractalGain(0.8f);
     noise.SetFractalWeightedStrength(0.80f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(8); // Fuerza de ping pong
@@ -236,23 +280,27 @@ Color fragmentShaderMars(Fragment& fragment) {
     float ox = 3000.0f; // Desplazamiento en X
     float oy = 3000.0f; // Desplazamiento en Y
     float zoom = 5000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(2, 0.006f * zoom, 4.0f + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
-    // Obtener el valor de ruido en función de la posición y el zoom
-    float noiseValue = abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
+    // Obtener el valor de ruido y su gradiente en una sola evaluación
+    glm::vec3 noiseGradient;
+    float signedNoise = noise.GetNoiseWithGradient((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom, noiseGradient.x, noiseGradient.y, noiseGradient.z);
+    float noiseValue = abs(signedNoise);
 
     // Seleccionar el color en función del valor de ruido y el umbral
     Color tmpColor = (noiseValue < 0.4f) ? marsColor1 : marsColor2;
 
-    // Multiplicar el color por la coordenada Z para simular la perspectiva
-    fragment.color = tmpColor * fragment.z;
+    // Relieve: el gradiente del ruido (por la regla de la cadena, multiplicado por el zoom) inclina la normal
+    float bumpStrength = 0.004f;
+    float bumpIntensity = bumpLighting(fragment, uniform, noiseGradient * (signedNoise < 0 ? -zoom : zoom), bumpStrength);
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
+    // Multiplicar el color por la coordenada Z para simular la perspectiva
+    fragment.color = tmpColor * (fragment.z * bumpIntensity);
 
     return fragment.color;
 }
 
-Color fragmentShaderJupiter(Fragment& fragment) {
+Color fragmentShaderJupiter(Fragment& fragment, const Uniform& uniform) {
     // Obtener las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -268,7 +316,7 @@ Color fragmentShaderJupiter(Fragment& fragment) {
     noise.SetFrequency(0.005f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(3);
-    noise.SetFractalLacunarity(5.0f + nextTime);
+    noise.SetFractalLacunarity(5.0f + uniform.animationPhase);
     noise.SetFractalGain(0.9f);
     noise.SetFractalWeightedStrength(0.90f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(1); // Fuerza de ping pong
@@ -277,6 +325,7 @@ Color fragmentShaderJupiter(Fragment& fragment) {
     noise.SetCellularDistanceFunction(FastNoiseLite::CellularDistanceFunction_Euclidean); // Función de distancia celular
     noise.SetCellularReturnType(FastNoiseLite::CellularReturnType_Distance2Add); // Tipo de retorno celular
     noise.SetCellularJitter(10); // Jitter (variación en las celdas)
+    noise.SetFractalDetail(octavesForFootprint(3, 0.005f * zoom, 5.0f + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     // Definir colores para Júpiter y la Gran Mancha Roja
     Color jupiterColor(255, 164, 81, 255); // Color de Júpiter
@@ -303,13 +352,10 @@ Color fragmentShaderJupiter(Fragment& fragment) {
         fragment.color = jupiterColorFinal;
     }
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.2f; // Puedes ajustar la velocidad de rotación
-
     return fragment.color;
 }
 
-Color fragmentShaderSaturn(Fragment& fragment) {
+Color fragmentShaderSaturn(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -320,7 +366,7 @@ Color fragmentShaderSaturn(Fragment& fragment) {
     noise.SetFrequency(0.005f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(1);
-    noise.SetFractalLacunarity(5.0f + nextTime);
+    noise.SetFractalLacunarity(5.0f + uniform.animationPhase);
     noise.SetFractalGain(0.5f);
     noise.SetFractalWeightedStrength(0.90f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(2); // Fuerza de ping pong
@@ -355,13 +401,10 @@ Color fragmentShaderSaturn(Fragment& fragment) {
     float ringInnerRadius = 0.6f;
     float ringOuterRadius = 0.8f;
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
-
     return fragment.color;
 }
 
-Color fragmentShaderUranus(Fragment& fragment) {
+Color fragmentShaderUranus(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -372,7 +415,7 @@ Color fragmentShaderUranus(Fragment& fragment) {
     noise.SetFrequency(0.009f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(2);
-    noise.SetFractalLacunarity(2.0f + nextTime);
+    noise.SetFractalLacunarity(2.0f + uniform.animationPhase);
     noise.SetFractalGain(0.5f);
     noise.SetFractalWeightedStrength(0.80f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(4); // Fuerza de ping pong
@@ -390,6 +433,7 @@ Color fragmentShaderUranus(Fragment& fragment) {
     float ox = 1000.0f; // Desplazamiento en X
     float oy = 1000.0f; // Desplazamiento en Y
     float zoom = 3000.0f; // Factor de zoom (ajusta según tus preferencias)
+    noise.SetFractalDetail(octavesForFootprint(2, 0.009f * zoom, 2.0f + uniform.animationPhase, fragment.footprint)); // Desvanecer octavas más pequeñas que un píxel
 
     // Obtener el valor de ruido en función de la posición y el zoom
     float noiseValue = abs(noise.GetNoise((fragment.original.x + ox) * zoom, (fragment.original.y + oy) * zoom, fragment.original.z * zoom));
@@ -400,13 +444,10 @@ Color fragmentShaderUranus(Fragment& fragment) {
     // Multiplicar el color por la coordenada Z para simular la perspectiva
     fragment.color = tmpColor * fragment.z;
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
-
     return fragment.color;
 }
 
-Color fragmentShaderNeptune(Fragment& fragment) {
+Color fragmentShaderNeptune(Fragment& fragment, const Uniform& uniform) {
     // Obtiene las coordenadas del fragmento en el espacio 2D
     glm::vec2 fragmentCoords(fragment.original.x, fragment.original.y);
 
@@ -417,7 +458,7 @@ Color fragmentShaderNeptune(Fragment& fragment) {
     noise.SetFrequency(0.0023f);
     noise.SetFractalType(FastNoiseLite::FractalType_Ridged);
     noise.SetFractalOctaves(1);
-    noise.SetFractalLacunarity(2.0f + nextTime);
+    noise.SetFractalLacunarity(2.0f + uniform.animationPhase);
     noise.SetFractalGain(0.5f);
     noise.SetFractalWeightedStrength(0.80f); // Fuerza ponderada
     noise.SetFractalPingPongStrength(4); // Fuerza de ping pong
@@ -456,13 +497,10 @@ Color fragmentShaderNeptune(Fragment& fragment) {
     // Multiplicar el color por la coordenada Z para simular la perspectiva
     fragment.color = tmpColor * fragment.z;
 
-    // Incrementar la variable "nextTime" para animar el ruido (rotación)
-    nextTime += 0.5f; // Puedes ajustar la velocidad de rotación
-
     return fragment.color;
 }
 
-Color fragmentShaderSpaceship(Fragment& fragment) {
+Color fragmentShaderSpaceship(Fragment& fragment, const Uniform& /*uniform*/) {
     Color ship(144,8,155);
     fragment.color = ship;
 
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "fragment.h"
+#include "uniform.h"
+#pragma once
+
+constexpr int SHADING_CACHE_WIDTH = 1024;
+constexpr int SHADING_CACHE_HEIGHT = 512;
+
+// Superficie sombreada de un planeta en coordenadas equirectangulares (longitud, latitud) del espacio del objeto
+struct ShadingCache {
+    int width = 0;
+    int height = 0;
+    float radius = 0.0f;
+    std::vector<Color> texels;
+    std::vector<Uint32> shadedFrame;
+    Uint32 frame = 1;
+    Uint32 refreshInterval = 1;
+    size_t shadedThisFrame = 0;
+};
+
+void initShadingCache(ShadingCache& cache, float radius, int width = SHADING_CACHE_WIDTH, int height = SHADING_CACHE_HEIGHT) {
+    cache.width = width;
+    cache.height = height;
+    cache.radius = radius;
+    cache.texels.assign(width * height, Color());
+    cache.shadedFrame.assign(width * height, 0);
+}
+
+// Los planetas grandes en pantalla refrescan su superficie animada más seguido; los lejanos casi nunca
+void beginShadingCacheFrame(ShadingCache& cache, float projectedRadius) {
+    cache.frame++;
+    cache.shadedThisFrame = 0;
+    float interval = 512.0f / std::max(projectedRadius, 1.0f);
+    cache.refreshInterval = static_cast<Uint32>(std::clamp(interval, 1.0f, 60.0f));
+}
+
+// Devuelve el texel de la superficie y solo evalúa el shader si nunca se sombreó o si ya venció su intervalo
+template <Color (*shader)(Fragment&, const Uniform&)>
+Color sampleShadingCache(ShadingCache& cache, const Fragment& fragment, const Uniform& uniform) {
+    glm::vec3 direction = glm::normalize(fragment.original);
+    float u = std::atan2(direction.z, direction.x) * (0.5f / 3.14159265f) + 0.5f;
+    float v = std::asin(std::clamp(direction.y, -1.0f, 1.0f)) * (1.0f / 3.14159265f) + 0.5f;
+    int x = std::min(static_cast<int>(u * cache.width), cache.width - 1);
+    int y = std::min(static_cast<int>(v * cache.height), cache.height - 1);
+    int index = y * cache.width + x;
+
+    Uint32 shadedFrame = cache.shadedFrame[index];
+    if (shadedFrame != 0 && cache.frame - shadedFrame < cache.refreshInterval) {
+        return cache.texels[index];
+    }
+
+    // Se sombrea el centro del texel para que el resultado no dependa de qué píxel lo pidió primero
+    float longitude = ((x + 0.5f) / cache.width - 0.5f) * 2.0f * 3.14159265f;
+    float latitude = ((y + 0.5f) / cache.height - 0.5f) * 3.14159265f;
+    Fragment texelFragment = fragment;
+    texelFragment.original = glm::vec3(std::cos(latitude) * std::cos(longitude), std::sin(latitude), std::cos(latitude) * std::sin(longitude)) * cache.radius;
+    texelFragment.footprint = std::max(fragment.footprint, 2.0f * 3.14159265f * cache.radius / cache.width);
+
+    cache.texels[index] = shader(texelFragment, uniform);
+    cache.shadedFrame[index] = cache.frame;
+    cache.shadedThisFrame++;
+    return cache.texels[index];
+}
@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <vector>
+#include "glm/glm.hpp"
+#include "loadOBJFile.h"
+#include "vertexArray.h"
+#pragma once
+
+// Simplificación con métricas de error cuadráticas (Garland y Heckbert 1997) sobre las caras de un OBJ. Se colapsan
+// medias aristas: el vértice que se quita pasa a ser uno que ya existe, así que cada esquina conserva su normal del
+// archivo y los niveles se arman con setupVertexArray como el modelo original
+
+// Matriz simétrica 4x4 guardada en sus 10 términos distintos
+struct Quadric {
+    std::array<double, 10> m{};
+
+    void addPlane(const glm::vec3& normal, double distance, double weight) {
+        double a = normal.x, b = normal.y, c = normal.z, d = distance;
+        std::array<double, 10> plane = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+        for (int i = 0; i < 10; i++) {
+            m[i] += plane[i] * weight;
+        }
+    }
+
+    void add(const Quadric& other) {
+        for (int i = 0; i < 10; i++) {
+            m[i] += other.m[i];
+        }
+    }
+
+    double evaluate(const glm::vec3& p) const {
+        return m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+             + m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+             + m[7] * p.z * p.z + 2.0 * m[8] * p.z + m[9];
+    }
+};
+
+struct MeshLOD {
+    std::vector<Vertex> vertices;
+    float error; // Distancia aproximada a la malla original, en unidades del modelo
+};
+
+struct MeshLODChain {
+    std::vector<MeshLOD> levels; // El primero es el modelo completo
+};
+
+// Los bordes abiertos se sujetan con un plano perpendicular a la cara para que no se encojan
+const double SIMPLIFY_BOUNDARY_WEIGHT = 10.0;
+// Un colapso que gira alguna cara más que esto (coseno) se descarta
+const double SIMPLIFY_MIN_FACE_COSINE = 0.2;
+
+// Reduce faces hasta que queden a lo sumo cada uno de targets (de mayor a menor) y devuelve una copia en cada punto.
+// errors recibe el error acumulado hasta ese nivel
+std::vector<std::vector<Face>> simplifyFaces(const std::vector<glm::vec3>& vertices, const std::vector<Face>& faces, const std::vector<size_t>& targets, std::vector<float>& errors) {
+    // Los OBJ repiten posiciones en las costuras; para la topología cuenta la posición, no el índice
+    std::map<std::tuple<float, float, float>, int> welded;
+    std::vector<int> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        remap[i] = welded.emplace(std::make_tuple(vertices[i].x, vertices[i].y, vertices[i].z), static_cast<int>(i)).first->second;
+    }
+    std::vector<Face> triangles = faces;
+    for (Face& face : triangles) {
+        for (int& index : face.vertexIndices) {
+            index = remap[index];
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertices.size());
+    std::vector<std::vector<int>> vertexFaces(vertices.size());
+    std::map<std::pair<int, int>, int> edgeUses;
+    for (size_t f = 0; f < triangles.size(); f++) {
+        const std::array<int, 3>& corners = triangles[f].vertexIndices;
+        glm::vec3 p0(vertices[corners[0]]), p1(vertices[corners[1]]), p2(vertices[corners[2]]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length > 0.0) {
+            normal /= length;
+            for (int corner : corners) {
+                quadrics[corner].addPlane(normal, -glm::dot(normal, p0), 1.0);
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            vertexFaces[corners[i]].push_back(static_cast<int>(f));
+            edgeUses[std::minmax(corners[i], corners[(i + 1) % 3])]++;
+        }
+    }
+    for (size_t f = 0; f < triangles.size(); f++) {
+        const std::array<int, 3>& corners = triangles[f].vertexIndices;
+        glm::vec3 p0(vertices[corners[0]]), p1(vertices[corners[1]]), p2(vertices[corners[2]]);
+        glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+        for (int i = 0; i < 3; i++) {
+            int a = corners[i], b = corners[(i + 1) % 3];
+            if (edgeUses[std::minmax(a, b)] != 1) {
+                continue;
+            }
+            glm::vec3 edge = vertices[b] - vertices[a];
+            glm::vec3 normal = glm::cross(edge, faceNormal);
+            double length = glm::length(normal);
+            if (length > 0.0) {
+                normal /= length;
+                quadrics[a].addPlane(normal, -glm::dot(normal, vertices[a]), SIMPLIFY_BOUNDARY_WEIGHT);
+                quadrics[b].addPlane(normal, -glm::dot(normal, vertices[a]), SIMPLIFY_BOUNDARY_WEIGHT);
+            }
+        }
+    }
+
+    // Cola con los colapsos más baratos primero; una entrada vieja se reconoce porque la versión de su vértice cambió
+    struct Collapse {
+        double cost;
+        int from, to;
+        int version;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    std::vector<int> versions(vertices.size(), 0);
+    std::vector<bool> removedFaces(triangles.size(), false);
+    auto pushCollapses = [&](int from) {
+        for (int f : vertexFaces[from]) {
+            for (int to : triangles[f].vertexIndices) {
+                if (to != from && !removedFaces[f]) {
+                    Quadric sum = quadrics[from];
+                    sum.add(quadrics[to]);
+                    queue.push({std::max(sum.evaluate(vertices[to]), 0.0), from, to, versions[from]});
+                }
+            }
+        }
+    };
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] == static_cast<int>(i)) {
+            pushCollapses(static_cast<int>(i));
+        }
+    }
+
+    size_t liveFaces = triangles.size();
+    double maximumCost = 0.0;
+    std::vector<std::vector<Face>> levels;
+    auto snapshot = [&]() {
+        std::vector<Face> level;
+        for (size_t f = 0; f < triangles.size(); f++) {
+            if (!removedFaces[f]) {
+                level.push_back(triangles[f]);
+            }
+        }
+        levels.push_back(std::move(level));
+        errors.push_back(static_cast<float>(std::sqrt(maximumCost)));
+    };
+
+    size_t nextTarget = 0;
+    while (nextTarget < targets.size()) {
+        if (liveFaces <= targets[nextTarget] || queue.empty()) {
+            snapshot();
+            nextTarget++;
+            continue;
+        }
+        Collapse collapse = queue.top();
+        queue.pop();
+        // El tercer vértice de una cara que desapareció todavía la tiene en su lista
+        std::erase_if(vertexFaces[collapse.from], [&](int f) { return removedFaces[f]; });
+        if (collapse.version != versions[collapse.from] || vertexFaces[collapse.from].empty()) {
+            continue;
+        }
+
+        // Las caras que quedan tienen que seguir mirando hacia el mismo lado
+        glm::vec3 target(vertices[collapse.to]);
+        bool flips = false;
+        bool connected = false;
+        for (int f : vertexFaces[collapse.from]) {
+            const std::array<int, 3>& corners = triangles[f].vertexIndices;
+            if (std::find(corners.begin(), corners.end(), collapse.to) != corners.end()) {
+                connected = true;
+                continue;
+            }
+            std::array<glm::vec3, 3> before, after;
+            for (int i = 0; i < 3; i++) {
+                before[i] = vertices[corners[i]];
+                after[i] = corners[i] == collapse.from ? target : before[i];
+            }
+            glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+            double oldLength = glm::length(oldNormal), newLength = glm::length(newNormal);
+            if (newLength <= 0.0 || (oldLength > 0.0 && glm::dot(oldNormal, newNormal) < SIMPLIFY_MIN_FACE_COSINE * oldLength * newLength)) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips || !connected) {
+            continue;
+        }
+
+        for (int f : vertexFaces[collapse.from]) {
+            std::array<int, 3>& corners = triangles[f].vertexIndices;
+            if (std::find(corners.begin(), corners.end(), collapse.to) != corners.end()) {
+                removedFaces[f] = true;
+                liveFaces--;
+            } else {
+                std::replace(corners.begin(), corners.end(), collapse.from, collapse.to);
+                vertexFaces[collapse.to].push_back(f);
+            }
+        }
+        std::erase_if(vertexFaces[collapse.to], [&](int f) { return removedFaces[f]; });
+        vertexFaces[collapse.from].clear();
+        quadrics[collapse.to].add(quadrics[collapse.from]);
+        maximumCost = std::max(maximumCost, collapse.cost);
+
+        // Cambian los costos del vértice que queda y de sus vecinos
+        versions[collapse.to]++;
+        pushCollapses(collapse.to);
+        for (int f : vertexFaces[collapse.to]) {
+            for (int neighbor : triangles[f].vertexIndices) {
+                if (neighbor != collapse.to) {
+                    versions[neighbor]++;
+                    pushCollapses(neighbor);
+                }
+            }
+        }
+    }
+    return levels;
+}
+
+// Niveles con la mitad de caras cada uno hasta minimumFaces
+MeshLODChain buildMeshLODs(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<Face>& faces, size_t minimumFaces) {
+    MeshLODChain chain;
+    chain.levels.push_back({setupVertexArray(vertices, normals, faces), 0.0f});
+    std::vector<size_t> targets;
+    for (size_t target = faces.size() / 2; target >= minimumFaces; target /= 2) {
+        targets.push_back(target);
+    }
+    std::vector<float> errors;
+    std::vector<std::vector<Face>> levels = simplifyFaces(vertices, faces, targets, errors);
+    for (size_t i = 0; i < levels.size(); i++) {
+        // Si ya no se pudo colapsar más, el nivel repetido no sirve
+        if (levels[i].size() * 3 >= chain.levels.back().vertices.size()) {
+            continue;
+        }
+        chain.levels.push_back({setupVertexArray(vertices, normals, levels[i]), errors[i]});
+    }
+    return chain;
+}
+
+// El nivel más simple cuyo error, proyectado a la distancia del modelo, no pasa de maxPixelError píxeles
+size_t selectMeshLOD(const MeshLODChain& chain, float pixelsPerUnit, float maxPixelError) {
+    size_t level = 0;
+    while (level + 1 < chain.levels.size() && chain.levels[level + 1].error * pixelsPerUnit <= maxPixelError) {
+        level++;
+    }
+    return level;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+#include <emmintrin.h>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "fragment.h"
+#include "framebuffer.h"
+#include "texture.h"
+#include "uniform.h"
+#pragma once
+
+enum SkyBackend {
+    SKY_SPHERE,
+    SKY_CUBEMAP,
+    SKY_STARFIELD
+};
+
+constexpr int SKY_CUBEMAP_SIZE = 1024;
+constexpr int STARFIELD_CELLS_PER_FACE = 64;
+constexpr int STARFIELD_MAX_STARS_PER_CELL = 3;
+
+// Las estrellas son grises, así que un canal BC4 (medio byte por texel) basta
+CompressedCubeMap bakeSkyCubeMap(Color (*shader)(Fragment&, const Uniform&), const Uniform& uniform, float sphereRadius, int size = SKY_CUBEMAP_SIZE) {
+    return bakeCubeMap(shader, uniform, sphereRadius, size, TEXTURE_BC4);
+}
+
+// Selecciona la cara y el texel para cuatro direcciones a la vez; las direcciones no necesitan estar normalizadas
+inline void cubeMapTexelCoordinates(__m128 dx, __m128 dy, __m128 dz, int size, int* faces, int* rows, int* columns) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(signMask, dx);
+    __m128 ay = _mm_andnot_ps(signMask, dy);
+    __m128 az = _mm_andnot_ps(signMask, dz);
+
+    __m128 isX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+    __m128 isY = _mm_andnot_ps(isX, _mm_cmpge_ps(ay, az));
+    __m128 isZ = _mm_andnot_ps(_mm_or_ps(isX, isY), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+    __m128 signX = _mm_and_ps(signMask, dx);
+    __m128 signY = _mm_and_ps(signMask, dy);
+    __m128 signZ = _mm_and_ps(signMask, dz);
+    __m128 negY = _mm_xor_ps(dy, signMask);
+
+    // X: s = -sign(x) * z, t = -y; Y: s = x, t = sign(y) * z; Z: s = sign(z) * x, t = -y
+    __m128 sX = _mm_xor_ps(_mm_xor_ps(dz, signX), signMask);
+    __m128 tY = _mm_xor_ps(dz, signY);
+    __m128 sZ = _mm_xor_ps(dx, signZ);
+
+    __m128 major = _mm_or_ps(_mm_and_ps(isX, ax), _mm_or_ps(_mm_and_ps(isY, ay), _mm_and_ps(isZ, az)));
+    __m128 s = _mm_or_ps(_mm_and_ps(isX, sX), _mm_or_ps(_mm_and_ps(isY, dx), _mm_and_ps(isZ, sZ)));
+    __m128 t = _mm_or_ps(_mm_and_ps(isY, tY), _mm_andnot_ps(isY, negY));
+
+    __m128 halfSize = _mm_set1_ps(size * 0.5f);
+    __m128 scale = _mm_div_ps(halfSize, major);
+    __m128i texelX = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(s, scale), halfSize));
+    __m128i texelY = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(t, scale), halfSize));
+    __m128i maxTexel = _mm_set1_epi32(size - 1);
+    __m128i zero = _mm_setzero_si128();
+    texelX = _mm_and_si128(texelX, _mm_cmpgt_epi32(texelX, zero));
+    texelY = _mm_and_si128(texelY, _mm_cmpgt_epi32(texelY, zero));
+    texelX = _mm_or_si128(_mm_and_si128(_mm_cmplt_epi32(texelX, maxTexel), texelX), _mm_andnot_si128(_mm_cmplt_epi32(texelX, maxTexel), maxTexel));
+    texelY = _mm_or_si128(_mm_and_si128(_mm_cmplt_epi32(texelY, maxTexel), texelY), _mm_andnot_si128(_mm_cmplt_epi32(texelY, maxTexel), maxTexel));
+
+    // Cara: X -> 0/1, Y -> 2/3, Z -> 4/5 según el signo del eje mayor
+    __m128i faceBase = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isY), _mm_set1_epi32(2)), _mm_and_si128(_mm_castps_si128(isZ), _mm_set1_epi32(4)));
+    __m128 majorSign = _mm_or_ps(_mm_and_ps(isX, signX), _mm_or_ps(_mm_and_ps(isY, signY), _mm_and_ps(isZ, signZ)));
+    __m128i negative = _mm_srli_epi32(_mm_castps_si128(majorSign), 31);
+    __m128i face = _mm_add_epi32(faceBase, negative);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(faces), face);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rows), texelY);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(columns), texelX);
+}
+
+// Rellena los píxeles que siguen con la profundidad de limpieza con una lectura del cube map por píxel
+void renderSkyCubeMap(const CompressedCubeMap& cubeMap, const Uniform& uniform, const std::array<double, SCREEN_WIDTH * SCREEN_HEIGHT>& depthBuffer) {
+    glm::mat4 inverseViewProjection = glm::inverse(uniform.projection * uniform.view);
+    glm::vec3 camera = uniform.frame.cameraPosition;
+
+    // La dirección del rayo es lineal en NDC: d = P.xyz - camara * P.w con P = inversa(VP) * (nx, ny, 1, 1)
+    glm::vec4 origin = inverseViewProjection * glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+    glm::vec4 stepX = inverseViewProjection[0] * (2.0f / SCREEN_WIDTH);
+    glm::vec4 stepY = inverseViewProjection[1] * (2.0f / SCREEN_HEIGHT);
+    glm::vec3 baseDirection = glm::vec3(origin) - camera * origin.w;
+    glm::vec3 directionStepX = glm::vec3(stepX) - camera * stepX.w;
+    glm::vec3 directionStepY = glm::vec3(stepY) - camera * stepY.w;
+
+    const double clearDepth = std::numeric_limits<double>::max();
+    __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+    for (size_t y = 1; y < SCREEN_HEIGHT; y++) {
+        glm::vec3 rowDirection = baseDirection + directionStepY * (y + 0.5f);
+        __m128 rowX = _mm_set1_ps(rowDirection.x);
+        __m128 rowY = _mm_set1_ps(rowDirection.y);
+        __m128 rowZ = _mm_set1_ps(rowDirection.z);
+        __m128 stepDirX = _mm_set1_ps(directionStepX.x);
+        __m128 stepDirY = _mm_set1_ps(directionStepX.y);
+        __m128 stepDirZ = _mm_set1_ps(directionStepX.z);
+
+        for (size_t x = 0; x < SCREEN_WIDTH; x += 4) {
+            __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+            __m128 dx = _mm_add_ps(rowX, _mm_mul_ps(stepDirX, column));
+            __m128 dy = _mm_add_ps(rowY, _mm_mul_ps(stepDirY, column));
+            __m128 dz = _mm_add_ps(rowZ, _mm_mul_ps(stepDirZ, column));
+
+            int faces[4];
+            int rows[4];
+            int columns[4];
+            cubeMapTexelCoordinates(dx, dy, dz, cubeMap.size, faces, rows, columns);
+            for (size_t lane = 0; lane < 4 && x + lane < SCREEN_WIDTH; lane++) {
+                if (depthBuffer[y * SCREEN_WIDTH + x + lane] == clearDepth) {
+                    Uint8 star = sampleCompressedTexel(cubeMap, faces[lane], columns[lane], rows[lane]) & 0xFF;
+                    framebuffer[SCREEN_HEIGHT - y][x + lane] = Color(star, star, star, 255);
+                }
+            }
+        }
+    }
+}
+
+inline Uint32 hashStarCell(Uint32 seed, Uint32 face, Uint32 i, Uint32 j, Uint32 k) {
+    Uint32 hash = seed ^ (face * 0x9E3779B1u) ^ (i * 0x85EBCA77u) ^ (j * 0xC2B2AE3Du) ^ (k * 0x27D4EB2Fu);
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    hash *= 0x297A2D39u;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+// Celdas de la cara face que puede tocar la vista: el cono de las cuatro esquinas de la pantalla se recorta contra la
+// pirámide de la cara y sus vértices se proyectan al plano de la cara. La proyección lleva las aristas del cono a
+// rectas, así que la caja de esos vértices cubre todo lo visible. Devuelve false si la cara queda fuera de la vista
+bool starfieldFaceCells(int face, const std::array<glm::vec3, 4>& corners, int cellsPerFace, glm::ivec2& minimum, glm::ivec2& maximum) {
+    glm::vec3 normal = cubeMapDirection(face, 0.0f, 0.0f);
+    glm::vec3 uAxis = cubeMapDirection(face, 1.0f, 0.0f) - normal;
+    glm::vec3 vAxis = cubeMapDirection(face, 0.0f, 1.0f) - normal;
+
+    std::vector<glm::vec3> polygon(corners.begin(), corners.end());
+    std::vector<glm::vec3> clipped;
+    for (const glm::vec3& plane : {normal - uAxis, normal + uAxis, normal - vAxis, normal + vAxis}) {
+        clipped.clear();
+        for (size_t k = 0; k < polygon.size(); k++) {
+            const glm::vec3& current = polygon[k];
+            const glm::vec3& next = polygon[(k + 1) % polygon.size()];
+            float currentSide = glm::dot(current, plane);
+            float nextSide = glm::dot(next, plane);
+            if (currentSide >= 0.0f) {
+                clipped.push_back(current);
+            }
+            if ((currentSide >= 0.0f) != (nextSide >= 0.0f)) {
+                clipped.push_back(current + (next - current) * (currentSide / (currentSide - nextSide)));
+            }
+        }
+        polygon.swap(clipped);
+        if (polygon.empty()) {
+            return false;
+        }
+    }
+
+    glm::vec2 lower(1.0f), upper(-1.0f);
+    for (const glm::vec3& direction : polygon) {
+        float major = std::max(glm::dot(direction, normal), 1e-12f);
+        glm::vec2 uv(glm::dot(direction, uAxis) / major, glm::dot(direction, vAxis) / major);
+        lower = glm::min(lower, uv);
+        upper = glm::max(upper, uv);
+    }
+    auto cell = [&](float coordinate) { return std::clamp(static_cast<int>((coordinate + 1.0f) * 0.5f * cellsPerFace), 0, cellsPerFace - 1); };
+    minimum = glm::ivec2(cell(lower.x), cell(lower.y));
+    maximum = glm::ivec2(cell(upper.x), cell(upper.y));
+    return true;
+}
+
+// Estrellas procedurales: la esfera de direcciones se divide en celdas (una rejilla por cara del cubo) y cada celda
+// que toca la vista genera con un hash hasta STARFIELD_MAX_STARS_PER_CELL estrellas; solo se recorren las celdas de
+// cada cara que cubre la vista y solo se escriben los píxeles de las estrellas
+void renderStarfield(const Uniform& uniform, const std::array<double, SCREEN_WIDTH * SCREEN_HEIGHT>& depthBuffer, Uint32 seed = 18340, int cellsPerFace = STARFIELD_CELLS_PER_FACE) {
+    glm::mat4 viewProjection = uniform.projection * uniform.view;
+    const double clearDepth = std::numeric_limits<double>::max();
+    float cellSize = 2.0f / cellsPerFace;
+
+    // Las estrellas están en el infinito, así que solo cuenta la rotación de la vista
+    glm::mat3 inverseRotation = glm::transpose(glm::mat3(uniform.view));
+    std::array<glm::vec3, 4> corners;
+    const glm::vec2 cornerSigns[4] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+    for (int corner = 0; corner < 4; corner++) {
+        corners[corner] = inverseRotation * glm::vec3(cornerSigns[corner].x / uniform.projection[0][0], cornerSigns[corner].y / uniform.projection[1][1], -1.0f);
+    }
+
+    for (int face = 0; face < 6; face++) {
+        glm::ivec2 minimum, maximum;
+        if (!starfieldFaceCells(face, corners, cellsPerFace, minimum, maximum)) {
+            continue;
+        }
+        for (int j = minimum.y; j <= maximum.y; j++) {
+            for (int i = minimum.x; i <= maximum.x; i++) {
+                Uint32 cellHash = hashStarCell(seed, face, i, j, 0);
+                int starCount = (cellHash & 0xFF) < 96 ? 0 : 1 + ((cellHash >> 8) & 0xFF) % STARFIELD_MAX_STARS_PER_CELL;
+
+                for (int star = 0; star < starCount; star++) {
+                    Uint32 starHash = hashStarCell(seed, face, i, j, star + 1);
+                    float u = (i + (starHash & 0xFFFF) / 65536.0f) * cellSize - 1.0f;
+                    float v = (j + (starHash >> 16) / 65536.0f) * cellSize - 1.0f;
+                    Uint8 brightness = 128 + (hashStarCell(seed, face, i, j, star + 17) & 0x7F);
+
+                    glm::vec4 clip = viewProjection * glm::vec4(glm::normalize(cubeMapDirection(face, u, v)), 0.0f);
+                    if (clip.w <= 0.0f) {
+                        continue;
+                    }
+                    int x = static_cast<int>((clip.x / clip.w + 1.0f) * 0.5f * SCREEN_WIDTH);
+                    int y = static_cast<int>((clip.y / clip.w + 1.0f) * 0.5f * SCREEN_HEIGHT);
+                    if (x < 0 || x >= static_cast<int>(SCREEN_WIDTH) || y < 1 || y >= static_cast<int>(SCREEN_HEIGHT)) {
+                        continue;
+                    }
+                    if (depthBuffer[y * SCREEN_WIDTH + x] == clearDepth) {
+                        framebuffer[SCREEN_HEIGHT - y][x] = Color(brightness, brightness, brightness, 255);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cmath>
+#include "glm/glm.hpp"
+#include "fragment.h"
+#include "framebuffer.h"
+#include "uniform.h"
+#pragma once
+
+// Esferas dibujadas sin triángulos: cada píxel del rectángulo de la elipse proyectada lanza un rayo contra la esfera
+// analítica y sale con la profundidad, la normal y la posición en el objeto exactas. El borde lleva la parte del píxel
+// que cubre la esfera para suavizar la silueta
+
+// Límites en NDC (x mínimo, x máximo, y mínimo, y máximo) de la proyección de una esfera de la vista, con los puntos de
+// tangencia de cada eje (Mara y McGuire 2013). Si la esfera cruza el plano cercano se devuelve toda la pantalla
+glm::vec4 projectedSphereBounds(const glm::vec3& center, float radius, const glm::mat4& projection) {
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    if (-center.z - radius <= nearPlane) {
+        return glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+    }
+    auto axisBounds = [&](float coordinate, float scale, float& minimum, float& maximum) {
+        float lengthSquared = coordinate * coordinate + center.z * center.z;
+        float tangent = std::sqrt(lengthSquared - radius * radius);
+        float cosine = tangent / std::sqrt(lengthSquared);
+        float sine = radius / std::sqrt(lengthSquared);
+        float first = scale * (coordinate * cosine - center.z * sine) / -(coordinate * sine + center.z * cosine);
+        float second = scale * (coordinate * cosine + center.z * sine) / -(-coordinate * sine + center.z * cosine);
+        minimum = std::min(first, second);
+        maximum = std::max(first, second);
+    };
+    glm::vec4 bounds;
+    axisBounds(center.x, projection[0][0], bounds.x, bounds.y);
+    axisBounds(center.y, projection[1][1], bounds.z, bounds.w);
+    return bounds;
+}
+
+// Si alguna parte de la esfera de la vista puede caer en pantalla: delante del plano cercano y con su rectángulo
+// proyectado tocando el NDC
+bool sphereInFrustum(const glm::vec3& center, float radius, const glm::mat4& projection) {
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    if (-center.z + radius < nearPlane) {
+        return false;
+    }
+    glm::vec4 bounds = projectedSphereBounds(center, radius, projection);
+    return bounds.y >= -1.0f && bounds.x <= 1.0f && bounds.w >= -1.0f && bounds.z <= 1.0f;
+}
+
+// Llama a emit(fragment, coverage) por cada píxel que toca la esfera de radio radius (en el espacio del modelo).
+// Los píxeles del borde que el rayo no toca usan el punto de la silueta más cercano al rayo
+template <typename Emit>
+void rasterizeSphere(const Uniform& uniform, float radius, Emit emit) {
+    glm::vec3 camera = uniform.frame.cameraPosition;
+    glm::vec3 center(uniform.model[3]);
+    float worldScale = glm::length(glm::vec3(uniform.model[0]));
+    float worldRadius = radius * worldScale;
+    glm::vec3 toCamera = camera - center;
+    float cameraDistanceSquared = glm::dot(toCamera, toCamera);
+    if (cameraDistanceSquared <= worldRadius * worldRadius) {
+        return;
+    }
+
+    glm::vec4 bounds = projectedSphereBounds(glm::vec3(uniform.view * glm::vec4(center, 1.0f)), worldRadius, uniform.projection);
+    int minX = std::max(1, static_cast<int>((bounds.x + 1.0f) * 0.5f * SCREEN_WIDTH) - 1);
+    int maxX = std::min(static_cast<int>(SCREEN_WIDTH) - 1, static_cast<int>((bounds.y + 1.0f) * 0.5f * SCREEN_WIDTH) + 1);
+    int minY = std::max(1, static_cast<int>((bounds.z + 1.0f) * 0.5f * SCREEN_HEIGHT) - 1);
+    int maxY = std::min(static_cast<int>(SCREEN_HEIGHT) - 1, static_cast<int>((bounds.w + 1.0f) * 0.5f * SCREEN_HEIGHT) + 1);
+
+    // Igual que en el cielo, la dirección del rayo es lineal en la posición del píxel
+    glm::mat4 inverseViewProjection = glm::inverse(uniform.projection * uniform.view);
+    glm::mat4 screenTransform = uniform.viewport * uniform.projection * uniform.view;
+    glm::mat4 inverseModel = glm::inverse(uniform.model);
+    glm::vec4 origin = inverseViewProjection * glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+    glm::vec4 stepX = inverseViewProjection[0] * (2.0f / SCREEN_WIDTH);
+    glm::vec4 stepY = inverseViewProjection[1] * (2.0f / SCREEN_HEIGHT);
+    glm::vec3 baseDirection = glm::vec3(origin) - camera * origin.w;
+    glm::vec3 directionStepX = glm::vec3(stepX) - camera * stepX.w;
+    glm::vec3 directionStepY = glm::vec3(stepY) - camera * stepY.w;
+    float pixelStep = glm::length(directionStepX);
+
+    for (int y = minY; y <= maxY; y++) {
+        glm::vec3 rowDirection = baseDirection + directionStepY * (y + 0.5f);
+        for (int x = minX; x <= maxX; x++) {
+            glm::vec3 direction = rowDirection + directionStepX * (x + 0.5f);
+            float inverseLength = 1.0f / std::sqrt(glm::dot(direction, direction));
+            direction *= inverseLength;
+            float along = -glm::dot(toCamera, direction);
+            if (along <= 0.0f) {
+                continue;
+            }
+            // Ancho del píxel a la distancia de la esfera; la cobertura es la distancia con signo a la silueta en píxeles,
+            // así que pasa de 0.5 justo donde el rayo del centro del píxel deja de tocar la esfera
+            float pixelSize = along * pixelStep * inverseLength;
+            float missSquared = std::max(cameraDistanceSquared - along * along, 0.0f);
+            float coverage = std::clamp(0.5f + (worldRadius - std::sqrt(missSquared)) / pixelSize, 0.0f, 1.0f);
+            if (coverage <= 0.0f) {
+                continue;
+            }
+
+            glm::vec3 point;
+            float discriminant = worldRadius * worldRadius - missSquared;
+            if (discriminant > 0.0f) {
+                point = camera + direction * (along - std::sqrt(discriminant));
+            } else {
+                glm::vec3 closest = camera + direction * along - center;
+                point = center + closest * (worldRadius / std::sqrt(glm::dot(closest, closest)));
+            }
+            glm::vec3 normal = (point - center) / worldRadius;
+            glm::vec4 screen = screenTransform * glm::vec4(point, 1.0f);
+
+            Fragment fragment;
+            fragment.position = glm::ivec2(x, y);
+            fragment.z = screen.z / screen.w;
+            fragment.original = glm::vec3(inverseModel * glm::vec4(point, 1.0f));
+            fragment.normal = normal;
+            // Lo que cubre el píxel en el objeto crece cuando la superficie se ve de canto
+            float facing = std::max(-glm::dot(direction, normal), 0.1f);
+            fragment.footprint = pixelSize / (facing * worldScale);
+            emit(fragment, coverage);
+        }
+    }
+}
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <emmintrin.h>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "fragment.h"
+#include "noiseGraph.h"
+#include "uniform.h"
+#pragma once
+
+// BC1 guarda color RGB565 y BC4 un solo canal; ambos ocupan 8 bytes por bloque de 4x4 texeles
+enum TextureFormat {
+    TEXTURE_BC1,
+    TEXTURE_BC4
+};
+
+constexpr int DECODED_BLOCK_CACHE_SIZE = 64;
+
+struct CompressedCubeMap {
+    int size = 0;
+    int blocksPerSide = 0;
+    TextureFormat format = TEXTURE_BC1;
+    std::vector<Uint64> blocks;
+};
+
+// Caras en el orden +X, -X, +Y, -Y, +Z, -Z; u y v van de -1 a 1
+glm::vec3 cubeMapDirection(int face, float u, float v) {
+    switch (face) {
+        case 0: return glm::vec3(1.0f, -v, -u);
+        case 1: return glm::vec3(-1.0f, -v, u);
+        case 2: return glm::vec3(u, 1.0f, v);
+        case 3: return glm::vec3(u, -1.0f, -v);
+        case 4: return glm::vec3(u, -v, 1.0f);
+        default: return glm::vec3(-u, -v, -1.0f);
+    }
+}
+
+// Inversa de cubeMapDirection; la dirección no necesita estar normalizada
+inline void cubeMapTexelCoordinate(const glm::vec3& direction, int size, int& face, int& x, int& y) {
+    glm::vec3 absolute = glm::abs(direction);
+    float major, s, t;
+    if (absolute.x >= absolute.y && absolute.x >= absolute.z) {
+        face = direction.x < 0.0f ? 1 : 0;
+        major = absolute.x;
+        s = direction.x < 0.0f ? direction.z : -direction.z;
+        t = -direction.y;
+    } else if (absolute.y >= absolute.z) {
+        face = direction.y < 0.0f ? 3 : 2;
+        major = absolute.y;
+        s = direction.x;
+        t = direction.y < 0.0f ? -direction.z : direction.z;
+    } else {
+        face = direction.z < 0.0f ? 5 : 4;
+        major = absolute.z;
+        s = direction.z < 0.0f ? -direction.x : direction.x;
+        t = -direction.y;
+    }
+    float halfSize = size * 0.5f;
+    float scale = halfSize / major;
+    x = std::clamp(static_cast<int>(s * scale + halfSize), 0, size - 1);
+    y = std::clamp(static_cast<int>(t * scale + halfSize), 0, size - 1);
+}
+
+inline Uint16 packRGB565(int r, int g, int b) {
+    return static_cast<Uint16>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+inline glm::ivec3 unpackRGB565(Uint16 color) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    return glm::ivec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// Paleta de BC1 en modo de cuatro colores: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1; cada entrada es RGBA empaquetado
+inline void bc1Palette(Uint16 color0, Uint16 color1, Uint32 palette[4]) {
+    glm::ivec3 endpoints[4];
+    endpoints[0] = unpackRGB565(color0);
+    endpoints[1] = unpackRGB565(color1);
+    if (color0 > color1) {
+        endpoints[2] = (endpoints[0] * 2 + endpoints[1]) / 3;
+        endpoints[3] = (endpoints[0] + endpoints[1] * 2) / 3;
+    } else {
+        endpoints[2] = (endpoints[0] + endpoints[1]) / 2;
+        endpoints[3] = glm::ivec3(0);
+    }
+    for (int i = 0; i < 4; i++) {
+        palette[i] = Uint32(endpoints[i].x) | Uint32(endpoints[i].y) << 8 | Uint32(endpoints[i].z) << 16 | 0xFF000000u;
+    }
+}
+
+// Paleta de BC4 en modo de ocho valores: v0, v1 y seis interpolados entre ambos
+inline void bc4Palette(Uint8 value0, Uint8 value1, Uint8 palette[8]) {
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1) {
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = static_cast<Uint8>(((7 - i) * value0 + i * value1) / 7);
+        }
+    } else {
+        for (int i = 1; i < 5; i++) {
+            palette[i + 1] = static_cast<Uint8>(((5 - i) * value0 + i * value1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Extremos en la diagonal de la caja envolvente, con los canales que decrecen contra el dominante invertidos
+Uint64 encodeBC1Block(const Color texels[16]) {
+    glm::ivec3 minimum(255), maximum(0);
+    glm::vec3 mean(0.0f);
+    for (int i = 0; i < 16; i++) {
+        glm::ivec3 texel(texels[i].r, texels[i].g, texels[i].b);
+        minimum = glm::min(minimum, texel);
+        maximum = glm::max(maximum, texel);
+        mean += glm::vec3(texel);
+    }
+    mean /= 16.0f;
+
+    glm::ivec3 range = maximum - minimum;
+    int dominant = range.x >= range.y && range.x >= range.z ? 0 : (range.y >= range.z ? 1 : 2);
+    glm::vec3 covariance(0.0f);
+    for (int i = 0; i < 16; i++) {
+        glm::vec3 delta = glm::vec3(texels[i].r, texels[i].g, texels[i].b) - mean;
+        covariance += delta * delta[dominant];
+    }
+
+    glm::ivec3 inset = range / 16;
+    glm::ivec3 high = maximum - inset;
+    glm::ivec3 low = minimum + inset;
+    for (int channel = 0; channel < 3; channel++) {
+        if (covariance[channel] < 0.0f) {
+            std::swap(high[channel], low[channel]);
+        }
+    }
+
+    Uint16 color0 = packRGB565(high.x, high.y, high.z);
+    Uint16 color1 = packRGB565(low.x, low.y, low.z);
+    if (color0 == color1) {
+        return color0 | Uint64(color1) << 16;
+    }
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    Uint32 palette[4];
+    bc1Palette(color0, color1, palette);
+    Uint32 indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int bestIndex = 0;
+        int bestDistance = std::numeric_limits<int>::max();
+        for (int entry = 0; entry < 4; entry++) {
+            int dr = int(palette[entry] & 0xFF) - texels[i].r;
+            int dg = int((palette[entry] >> 8) & 0xFF) - texels[i].g;
+            int db = int((palette[entry] >> 16) & 0xFF) - texels[i].b;
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                bestIndex = entry;
+            }
+        }
+        indices |= Uint32(bestIndex) << (2 * i);
+    }
+    return color0 | Uint64(color1) << 16 | Uint64(indices) << 32;
+}
+
+Uint64 encodeBC4Block(const Uint8 values[16]) {
+    Uint8 maximum = *std::max_element(values, values + 16);
+    Uint8 minimum = *std::min_element(values, values + 16);
+    if (maximum == minimum) {
+        return maximum | Uint64(minimum) << 8;
+    }
+
+    // Posición 0 es v0 y 7 es v1; las intermedias van a los índices 2 a 7
+    Uint64 indices = 0;
+    int range = maximum - minimum;
+    for (int i = 0; i < 16; i++) {
+        int position = ((maximum - values[i]) * 7 + range / 2) / range;
+        Uint64 index = position == 0 ? 0 : (position == 7 ? 1 : position + 1);
+        indices |= index << (3 * i);
+    }
+    return maximum | Uint64(minimum) << 8 | indices << 16;
+}
+
+// Cada carril toma sus dos bits de índice con una máscara propia y se compara contra las cuatro entradas de la paleta
+inline void decodeBC1Block(Uint64 block, Uint32 texels[16]) {
+    Uint32 palette[4];
+    bc1Palette(static_cast<Uint16>(block), static_cast<Uint16>(block >> 16), palette);
+    __m128i indices = _mm_set1_epi32(static_cast<int>(block >> 32));
+
+    for (int group = 0; group < 4; group++) {
+        int shift = group * 8;
+        __m128i laneMask = _mm_set_epi32(3 << (shift + 6), 3 << (shift + 4), 3 << (shift + 2), 3 << shift);
+        __m128i laneIndex = _mm_and_si128(indices, laneMask);
+        __m128i result = _mm_setzero_si128();
+        for (int entry = 0; entry < 4; entry++) {
+            __m128i entryIndex = _mm_set_epi32(entry << (shift + 6), entry << (shift + 4), entry << (shift + 2), entry << shift);
+            __m128i match = _mm_cmpeq_epi32(laneIndex, entryIndex);
+            result = _mm_or_si128(result, _mm_and_si128(match, _mm_set1_epi32(static_cast<int>(palette[entry]))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(texels + group * 4), result);
+    }
+}
+
+// Igual que BC1 pero con índices de tres bits; cada mitad del bloque cabe en 24 bits. El gris sale replicado en RGB
+inline void decodeBC4Block(Uint64 block, Uint32 texels[16]) {
+    Uint8 palette[8];
+    bc4Palette(static_cast<Uint8>(block), static_cast<Uint8>(block >> 8), palette);
+
+    for (int half = 0; half < 2; half++) {
+        __m128i indices = _mm_set1_epi32(static_cast<int>((block >> (16 + 24 * half)) & 0xFFFFFF));
+        for (int group = 0; group < 2; group++) {
+            int shift = group * 12;
+            __m128i laneMask = _mm_set_epi32(7 << (shift + 9), 7 << (shift + 6), 7 << (shift + 3), 7 << shift);
+            __m128i laneIndex = _mm_and_si128(indices, laneMask);
+            __m128i result = _mm_setzero_si128();
+            for (int entry = 0; entry < 8; entry++) {
+                __m128i entryIndex = _mm_set_epi32(entry << (shift + 9), entry << (shift + 6), entry << (shift + 3), entry << shift);
+                __m128i match = _mm_cmpeq_epi32(laneIndex, entryIndex);
+                result = _mm_or_si128(result, _mm_and_si128(match, _mm_set1_epi32(palette[entry])));
+            }
+            result = _mm_or_si128(_mm_or_si128(result, _mm_slli_epi32(result, 8)), _mm_slli_epi32(result, 16));
+            result = _mm_or_si128(result, _mm_set1_epi32(static_cast<int>(0xFF000000u)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(texels + half * 8 + group * 4), result);
+        }
+    }
+}
+
+// Caché directa de bloques decodificados por hilo; los vecinos en pantalla suelen caer en el mismo bloque
+struct DecodedBlockCache {
+    const CompressedCubeMap* textures[DECODED_BLOCK_CACHE_SIZE] = {};
+    Uint32 blockIndices[DECODED_BLOCK_CACHE_SIZE] = {};
+    Uint32 texels[DECODED_BLOCK_CACHE_SIZE][16];
+};
+
+inline thread_local DecodedBlockCache decodedBlockCache;
+
+inline Uint32 sampleCompressedTexel(const CompressedCubeMap& cubeMap, int face, int x, int y) {
+    Uint32 blockIndex = (face * cubeMap.blocksPerSide + (y >> 2)) * cubeMap.blocksPerSide + (x >> 2);
+    Uint32 slot = (blockIndex ^ (blockIndex >> 6)) & (DECODED_BLOCK_CACHE_SIZE - 1);
+
+    DecodedBlockCache& cache = decodedBlockCache;
+    if (cache.textures[slot] != &cubeMap || cache.blockIndices[slot] != blockIndex) {
+        if (cubeMap.format == TEXTURE_BC1) {
+            decodeBC1Block(cubeMap.blocks[blockIndex], cache.texels[slot]);
+        } else {
+            decodeBC4Block(cubeMap.blocks[blockIndex], cache.texels[slot]);
+        }
+        cache.textures[slot] = &cubeMap;
+        cache.blockIndices[slot] = blockIndex;
+    }
+    return cache.texels[slot][(y & 3) * 4 + (x & 3)];
+}
+
+inline Color unpackTexel(Uint32 texel) {
+    return Color::fromPixel(texel);
+}
+
+Color sampleCubeMap(const CompressedCubeMap& cubeMap, const glm::vec3& direction) {
+    int face, x, y;
+    cubeMapTexelCoordinate(direction, cubeMap.size, face, x, y);
+    return unpackTexel(sampleCompressedTexel(cubeMap, face, x, y));
+}
+
+size_t compressedCubeMapBytes(const CompressedCubeMap& cubeMap) {
+    return cubeMap.blocks.size() * sizeof(Uint64);
+}
+
+// Hornea un material procedural en un cube map comprimido; cada cara se sombrea y comprime bloque a bloque en su propio
+// hilo, así que nunca existe la versión sin comprimir completa. BC4 guarda el canal más brillante de cada texel. Con un
+// grafo, cada bloque de 4x4 se evalúa como un lote de 16 fragmentos en lugar de llamar al shader
+CompressedCubeMap bakeCubeMap(Color (*shader)(Fragment&, const Uniform&), const Uniform& uniform, float sphereRadius, int size, TextureFormat format,
+                              const NoiseGraph* graph = nullptr) {
+    CompressedCubeMap cubeMap;
+    cubeMap.size = size;
+    cubeMap.blocksPerSide = size / 4;
+    cubeMap.format = format;
+    cubeMap.blocks.resize(6 * cubeMap.blocksPerSide * cubeMap.blocksPerSide);
+
+    float texelFootprint = 2.0f * sphereRadius / size;
+
+    std::vector<std::thread> faceThreads;
+    for (int face = 0; face < 6; face++) {
+        faceThreads.emplace_back([&cubeMap, shader, graph, &uniform, sphereRadius, size, format, face, texelFootprint]() {
+            NoiseGraphContext context;
+            NoiseGraphBatch batch;
+            if (graph) {
+                createNoiseGraphContext(context, *graph);
+                batch.count = 16;
+            }
+            for (int blockY = 0; blockY < cubeMap.blocksPerSide; blockY++) {
+                for (int blockX = 0; blockX < cubeMap.blocksPerSide; blockX++) {
+                    Color texels[16];
+                    Uint8 values[16];
+                    for (int i = 0; i < 16; i++) {
+                        int x = blockX * 4 + (i & 3);
+                        int y = blockY * 4 + (i >> 2);
+                        float u = (x + 0.5f) / size * 2.0f - 1.0f;
+                        float v = (y + 0.5f) / size * 2.0f - 1.0f;
+
+                        Fragment fragment;
+                        fragment.position = glm::ivec2(x, y);
+                        fragment.z = 1.0f;
+                        fragment.original = glm::normalize(cubeMapDirection(face, u, v)) * sphereRadius;
+                        fragment.footprint = texelFootprint;
+                        fragment.normal = glm::normalize(fragment.original);
+
+                        if (graph) {
+                            batch.x[i] = fragment.original.x;
+                            batch.y[i] = fragment.original.y;
+                            batch.z[i] = fragment.original.z;
+                            batch.depth[i] = fragment.z;
+                            batch.footprint[i] = fragment.footprint;
+                        } else {
+                            texels[i] = shader(fragment, uniform);
+                        }
+                    }
+                    if (graph) {
+                        evaluateNoiseGraph(context, batch, texels);
+                    }
+                    for (int i = 0; i < 16; i++) {
+                        values[i] = std::max({texels[i].r, texels[i].g, texels[i].b});
+                    }
+                    size_t blockIndex = (face * cubeMap.blocksPerSide + blockY) * cubeMap.blocksPerSide + blockX;
+                    cubeMap.blocks[blockIndex] = format == TEXTURE_BC1 ? encodeBC1Block(texels) : encodeBC4Block(values);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : faceThreads) {
+        thread.join();
+    }
+    return cubeMap;
+}
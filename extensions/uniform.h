@@ -1,9 +1,17 @@
 #include "glm/glm.hpp"
 #pragma once
 
+struct FrameUniforms {
+    float time;
+    glm::vec3 sunPosition; // En el mundo; el sol es una luz puntual
+    glm::vec3 cameraPosition;
+};
+
 struct Uniform {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 projection;
     glm::mat4 viewport;
+    FrameUniforms frame;
+    float animationPhase;
 };
\ No newline at end of file
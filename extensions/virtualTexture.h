@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "glm/glm.hpp"
+#include "color.h"
+#include "fragment.h"
+#include "noiseGraph.h"
+#include "texture.h"
+#include "uniform.h"
+#pragma once
+
+constexpr int VIRTUAL_TILE_SIZE = 64;
+constexpr int VIRTUAL_TEXTURE_MAX_LEVEL = 10;
+constexpr size_t VIRTUAL_TEXTURE_BUDGET_BYTES = 16 * 1024 * 1024;
+constexpr size_t VIRTUAL_TEXTURE_MAX_PENDING = 64;
+constexpr size_t VIRTUAL_TEXTURE_REQUESTS_PER_FRAME = 16;
+
+// Cada cara del cubo es un quadtree: el nivel L tiene 2^L x 2^L tiles de VIRTUAL_TILE_SIZE texeles
+inline Uint64 virtualTileKey(int face, int level, int tileX, int tileY) {
+    return Uint64(face) << 56 | Uint64(level) << 48 | Uint64(tileY) << 24 | Uint64(tileX);
+}
+
+inline int virtualTileLevel(Uint64 key) {
+    return static_cast<int>((key >> 48) & 0xFF);
+}
+
+inline Uint64 virtualTileParent(Uint64 key) {
+    int face = static_cast<int>(key >> 56);
+    int level = virtualTileLevel(key);
+    int tileY = static_cast<int>((key >> 24) & 0xFFFFFF);
+    int tileX = static_cast<int>(key & 0xFFFFFF);
+    return virtualTileKey(face, level - 1, tileX >> 1, tileY >> 1);
+}
+
+struct VirtualTile {
+    std::vector<Uint32> texels;
+    Uint32 lastUsedFrame = 0;
+};
+
+// Solo el hilo que dibuja el planeta lee tiles y escribe feedback durante el cuadro; los trabajadores entregan tiles
+// terminados en completed y el hilo principal los integra entre cuadros, así que el muestreo no usa candados
+struct VirtualTexture {
+    Color (*shader)(Fragment&, const Uniform&) = nullptr;
+    const NoiseGraph* graph = nullptr; // Si el planeta tiene material de grafo, los tiles salen de él y no del shader
+    Uniform uniform{};
+    float radius = 0.0f;
+
+    std::unordered_map<Uint64, VirtualTile> tiles;
+    std::unordered_set<Uint64> pending;
+    std::vector<Uint64> feedback;
+    Uint32 frame = 1;
+    Uint32 generation = 1;
+
+    std::mutex completedMutex;
+    std::vector<std::pair<Uint64, std::vector<Uint32>>> completed;
+};
+
+struct TileRequest {
+    VirtualTexture* texture;
+    Uint64 key;
+};
+
+// Trabajadores compartidos por todos los planetas que generan tiles con el shader de ruido
+struct TileStreamer {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TileRequest> requests;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    ~TileStreamer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+};
+
+std::vector<Uint32> generateVirtualTile(const VirtualTexture& texture, Uint64 key) {
+    int face = static_cast<int>(key >> 56);
+    int level = virtualTileLevel(key);
+    int tileY = static_cast<int>((key >> 24) & 0xFFFFFF);
+    int tileX = static_cast<int>(key & 0xFFFFFF);
+    int faceSize = VIRTUAL_TILE_SIZE << level;
+    float texelFootprint = 2.0f * texture.radius / faceSize;
+
+    std::vector<Uint32> texels(VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE);
+    auto texelDirection = [&](int x, int y) {
+        float u = (tileX * VIRTUAL_TILE_SIZE + x + 0.5f) / faceSize * 2.0f - 1.0f;
+        float v = (tileY * VIRTUAL_TILE_SIZE + y + 0.5f) / faceSize * 2.0f - 1.0f;
+        return glm::normalize(cubeMapDirection(face, u, v));
+    };
+
+    // El grafo sombrea el tile por lotes de texeles contiguos; cada trabajador arma su propio contexto
+    if (texture.graph) {
+        NoiseGraphContext context;
+        createNoiseGraphContext(context, *texture.graph);
+        NoiseGraphBatch batch;
+        std::array<Color, NOISE_GRAPH_BATCH> colors;
+        for (int first = 0; first < VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE; first += NOISE_GRAPH_BATCH) {
+            batch.count = std::min(NOISE_GRAPH_BATCH, VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE - first);
+            for (int lane = 0; lane < batch.count; lane++) {
+                glm::vec3 original = texelDirection((first + lane) % VIRTUAL_TILE_SIZE, (first + lane) / VIRTUAL_TILE_SIZE) * texture.radius;
+                batch.x[lane] = original.x;
+                batch.y[lane] = original.y;
+                batch.z[lane] = original.z;
+                batch.depth[lane] = 1.0f;
+                batch.footprint[lane] = texelFootprint;
+            }
+            evaluateNoiseGraph(context, batch, colors.data());
+            for (int lane = 0; lane < batch.count; lane++) {
+                texels[first + lane] = colors[lane].toPixel();
+            }
+        }
+        return texels;
+    }
+
+    for (int y = 0; y < VIRTUAL_TILE_SIZE; y++) {
+        for (int x = 0; x < VIRTUAL_TILE_SIZE; x++) {
+            Fragment fragment;
+            fragment.position = glm::ivec2(x, y);
+            fragment.z = 1.0f;
+            fragment.original = texelDirection(x, y) * texture.radius;
+            fragment.footprint = texelFootprint;
+            fragment.normal = glm::normalize(fragment.original);
+
+            texels[y * VIRTUAL_TILE_SIZE + x] = texture.shader(fragment, texture.uniform).toPixel();
+        }
+    }
+    return texels;
+}
+
+void startTileStreamer(TileStreamer& streamer, unsigned workerCount = std::max(1u, std::thread::hardware_concurrency() / 2)) {
+    for (unsigned i = 0; i < workerCount; i++) {
+        streamer.workers.emplace_back([&streamer]() {
+            while (true) {
+                TileRequest request;
+                {
+                    std::unique_lock<std::mutex> lock(streamer.mutex);
+                    streamer.wake.wait(lock, [&streamer]() { return streamer.stopping || !streamer.requests.empty(); });
+                    if (streamer.stopping) {
+                        return;
+                    }
+                    request = streamer.requests.front();
+                    streamer.requests.pop_front();
+                }
+                std::vector<Uint32> texels = generateVirtualTile(*request.texture, request.key);
+                std::lock_guard<std::mutex> lock(request.texture->completedMutex);
+                request.texture->completed.emplace_back(request.key, std::move(texels));
+            }
+        });
+    }
+}
+
+// Los seis tiles del nivel 0 se generan al crear la textura y nunca se desalojan, así siempre hay algo que muestrear
+std::unique_ptr<VirtualTexture> createVirtualTexture(Color (*shader)(Fragment&, const Uniform&), const Uniform& uniform, float radius, const NoiseGraph* graph = nullptr) {
+    std::unique_ptr<VirtualTexture> texture = std::make_unique<VirtualTexture>();
+    texture->shader = shader;
+    texture->graph = graph;
+    texture->uniform = uniform;
+    texture->radius = radius;
+    for (int face = 0; face < 6; face++) {
+        Uint64 key = virtualTileKey(face, 0, 0, 0);
+        texture->tiles[key].texels = generateVirtualTile(*texture, key);
+    }
+    return texture;
+}
+
+// Resultado de la última búsqueda por hilo: los píxeles vecinos casi siempre piden el mismo tile
+struct VirtualTileLookup {
+    const VirtualTexture* texture = nullptr;
+    Uint32 generation = 0;
+    Uint64 desiredKey = 0;
+    const VirtualTile* tile = nullptr;
+    int levelShift = 0;
+};
+
+inline thread_local VirtualTileLookup virtualTileLookup;
+
+// Elige el nivel cuyo texel cubre el footprint del píxel, deja el tile pedido en el feedback y muestrea el ancestro
+// residente más fino
+Color sampleVirtualTexture(VirtualTexture& texture, const glm::vec3& original, float footprint) {
+    int level = VIRTUAL_TEXTURE_MAX_LEVEL;
+    if (footprint > 0.0f) {
+        float texelsNeeded = 2.0f * texture.radius / (VIRTUAL_TILE_SIZE * footprint);
+        level = std::clamp(static_cast<int>(std::ceil(std::log2(std::max(texelsNeeded, 1.0f)))), 0, VIRTUAL_TEXTURE_MAX_LEVEL);
+    }
+
+    int face, x, y;
+    cubeMapTexelCoordinate(original, VIRTUAL_TILE_SIZE << level, face, x, y);
+    Uint64 desiredKey = virtualTileKey(face, level, x / VIRTUAL_TILE_SIZE, y / VIRTUAL_TILE_SIZE);
+
+    VirtualTileLookup& lookup = virtualTileLookup;
+    if (lookup.texture != &texture || lookup.generation != texture.generation || lookup.desiredKey != desiredKey) {
+        texture.feedback.push_back(desiredKey);
+        Uint64 key = desiredKey;
+        int levelShift = 0;
+        auto found = texture.tiles.find(key);
+        while (found == texture.tiles.end()) {
+            key = virtualTileParent(key);
+            levelShift++;
+            found = texture.tiles.find(key);
+        }
+        lookup.texture = &texture;
+        lookup.generation = texture.generation;
+        lookup.desiredKey = desiredKey;
+        lookup.tile = &found->second;
+        lookup.levelShift = levelShift;
+    }
+
+    int texelX = (x >> lookup.levelShift) & (VIRTUAL_TILE_SIZE - 1);
+    int texelY = (y >> lookup.levelShift) & (VIRTUAL_TILE_SIZE - 1);
+    return unpackTexel(lookup.tile->texels[texelY * VIRTUAL_TILE_SIZE + texelX]);
+}
+
+size_t virtualTextureBytes(const VirtualTexture& texture) {
+    return texture.tiles.size() * VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * sizeof(Uint32);
+}
+
+// Entre cuadros: integra los tiles terminados, marca lo usado según el feedback, desaloja por LRU hasta volver al
+// presupuesto y pide los tiles que faltan, los más gruesos primero para que el detalle se refine de a poco
+void updateVirtualTexture(VirtualTexture& texture, TileStreamer& streamer) {
+    std::vector<std::pair<Uint64, std::vector<Uint32>>> completed;
+    {
+        std::lock_guard<std::mutex> lock(texture.completedMutex);
+        completed.swap(texture.completed);
+    }
+    for (auto& [key, texels] : completed) {
+        texture.pending.erase(key);
+        VirtualTile& tile = texture.tiles[key];
+        tile.texels = std::move(texels);
+        tile.lastUsedFrame = texture.frame;
+    }
+
+    std::unordered_set<Uint64> missing;
+    std::sort(texture.feedback.begin(), texture.feedback.end());
+    texture.feedback.erase(std::unique(texture.feedback.begin(), texture.feedback.end()), texture.feedback.end());
+    for (Uint64 key : texture.feedback) {
+        while (true) {
+            auto found = texture.tiles.find(key);
+            if (found != texture.tiles.end()) {
+                found->second.lastUsedFrame = texture.frame;
+            } else if (!texture.pending.contains(key)) {
+                missing.insert(key);
+            }
+            if (virtualTileLevel(key) == 0) {
+                break;
+            }
+            key = virtualTileParent(key);
+        }
+    }
+    texture.feedback.clear();
+
+    size_t budgetTiles = VIRTUAL_TEXTURE_BUDGET_BYTES / (VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * sizeof(Uint32));
+    if (texture.tiles.size() > budgetTiles) {
+        std::vector<std::pair<Uint32, Uint64>> candidates;
+        for (const auto& [key, tile] : texture.tiles) {
+            if (virtualTileLevel(key) > 0 && tile.lastUsedFrame != texture.frame) {
+                candidates.emplace_back(tile.lastUsedFrame, key);
+            }
+        }
+        size_t evictCount = std::min(candidates.size(), texture.tiles.size() - budgetTiles);
+        std::nth_element(candidates.begin(), candidates.begin() + evictCount, candidates.end());
+        for (size_t i = 0; i < evictCount; i++) {
+            texture.tiles.erase(candidates[i].second);
+        }
+    }
+
+    std::vector<Uint64> requests(missing.begin(), missing.end());
+    std::sort(requests.begin(), requests.end(), [](Uint64 a, Uint64 b) { return virtualTileLevel(a) < virtualTileLevel(b); });
+    size_t requestCount = std::min({requests.size(), VIRTUAL_TEXTURE_REQUESTS_PER_FRAME, VIRTUAL_TEXTURE_MAX_PENDING - std::min(texture.pending.size(), VIRTUAL_TEXTURE_MAX_PENDING)});
+    if (requestCount > 0) {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        for (size_t i = 0; i < requestCount; i++) {
+            texture.pending.insert(requests[i]);
+            streamer.requests.push_back({&texture, requests[i]});
+        }
+    }
+    streamer.wake.notify_all();
+
+    texture.frame++;
+    texture.generation++;
+}
@@ -1,14 +1,34 @@
 #include <SDL.h>
+#include <atomic>
+#include <cstdio>
+#include <functional>
 #include <mutex>
+#include <span>
 #include <vector>
 #include <thread>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "extensions/atmosphere.h"
+#include "extensions/bloom.h"
 #include "extensions/color.h"
+#include "extensions/eclipse.h"
+#include "extensions/framebuffer.h"
+#include "extensions/icosphere.h"
+#include "extensions/lights.h"
 #include "extensions/loadOBJFile.h"
+#include "extensions/meshletCulling.h"
+#include "extensions/meshOptimizer.h"
+#include "extensions/noiseGraph.h"
+#include "extensions/quantizedMesh.h"
 #include "extensions/shaders.h"
+#include "extensions/shadingCache.h"
+#include "extensions/simplify.h"
+#include "extensions/sky.h"
+#include "extensions/sphere.h"
+#include "extensions/texture.h"
 #include "extensions/uniform.h"
 #include "extensions/vertexArray.h"
+#include "extensions/virtualTexture.h"
 
 const int WINDOW_WIDTH = 720;
 const int WINDOW_HEIGHT = 480;
@@ -35,27 +55,98 @@ enum Planets {
     SHIP
 };
 
-struct BuildingModel {
-    Uniform uniform;
-    std::vector<Vertex>* v;
-    Planets i;
+enum LightingModel {
+    LIGHT_FACING,
+    VIEW_FACING,
+    EMISSIVE // El sol: su color ya es la luz que emite y no lo iluminan las luces
 };
 
+typedef Color (*FragmentShader)(Fragment&, const Uniform&);
+typedef ColorF (*HDRFragmentShader)(Fragment&, const Uniform&);
+
+enum ShadingQuality {
+    PER_PIXEL,
+    PER_VERTEX,
+    HYBRID,
+    TEXTURE_SPACE,
+    BAKED_TEXTURE,
+    VIRTUAL_TEXTURE,
+    NOISE_GRAPH
+};
+
+// Lo que cambia entre instancias de una misma malla; la vista, la proyección y el cuadro son de todo el lote
+struct InstanceData {
+    glm::mat4 model;
+    Planets material; // Elige el shader, el modelo de luz y la superficie
+    float animationPhase;
+};
+
+// Instancias de una malla que se dibujan con la misma plantilla de render
+struct DrawCommand {
+    MeshHandle mesh;
+    Planets material;
+    ShadingQuality quality;
+    std::vector<InstanceData> instances;
+};
+
+float gouraudScreenRadiusThreshold = 24.0f;
+bool hybridGouraudLighting = false;
+bool textureSpaceShading = true;
+bool bakedPlanetTextures = false;
+int planetTextureSize = 512;
+bool virtualTexturedPlanets = true;
+float virtualTextureScreenRadiusThreshold = 160.0f;
+bool noiseGraphMaterials = true;
+bool hdrFramebufferEnabled = false;
+float hdrExposure = 1.0f;
+bool bloomEnabled = true;
+bool planetAtmospheres = true;
+bool analyticSpheres = true;
+bool proceduralSphereLODs = true;
+int sphereLODLevels = 6;
+float sphereLODPixelError = 0.5f;
+bool sphereGeomorphing = true;
+bool simplifiedShipLODs = true;
+float meshLODPixelError = 1.0f;
+size_t minimumLODFaces = 16;
+bool optimizeMeshOrder = true;
+size_t minimumInstancesPerThread = 64;
+bool meshletCulling = true;
+bool meshletOcclusionCulling = true;
+bool dynamicLights = true;
+int beaconLightsPerPlanet = 24;
+int sunFlareLights = 32;
+
+// Todo lo que un planeta guarda de su superficie entre cuadros, según el modo de sombreado que use
+struct PlanetSurface {
+    ShadingCache shadingCache;
+    CompressedCubeMap bakedTexture;
+    std::unique_ptr<VirtualTexture> virtualTexture;
+    NoiseGraph noiseGraph;
+    HDRFragmentShader hdrShader = nullptr;
+    std::unique_ptr<Atmosphere> atmosphere;
+    float sphereRadius = 0.0f; // Si es mayor que 0 el cuerpo se dibuja como una esfera analítica de este radio
+};
+
+std::array<PlanetSurface, SHIP + 1> planetSurfaces;
+
 Color clearColor = {0, 0, 0, 255};
 
-glm::vec3 light = glm::vec3(0, 0, 200.0f);
+float animationPhase = 1.5f;
+
+SkyBackend skyBackend = SKY_CUBEMAP;
+
+// Las luces y los eclipses del cuadro; se arman antes de lanzar los hilos de dibujo y estos solo los leen
+LightClusters lightClusters;
+EclipseTiles eclipseTiles;
+bool eclipseShadows = true;
 
 Color interpolateColor(const glm::vec3& barycentricCoord, const Color& colorA, const Color& colorB, const Color& colorC) {
     float u = barycentricCoord.x;
     float v = barycentricCoord.y;
     float w = barycentricCoord.z;
 
-    uint8_t r = static_cast<uint8_t>(u * colorA.r + v * colorB.r + w * colorC.r);
-    uint8_t g = static_cast<uint8_t>(u * colorA.g + v * colorB.g + w * colorC.g);
-    uint8_t b = static_cast<uint8_t>(u * colorA.b + v * colorB.b + w * colorC.b);
-    uint8_t a = static_cast<uint8_t>(u * colorA.a + v * colorB.a + w * colorC.a);
-
-    return Color(r, g, b, a);
+    return Color::fromPixel(interpolatePixel(u, v, w, colorA.toPixel(), colorB.toPixel(), colorC.toPixel()));
 }
 
 bool isBarycentricCoord(const glm::vec3& barycentricCoord) {
@@ -115,149 +206,629 @@ glm::vec3 calculatePositionInCircle(float angleR, float radius){
     return glm::vec3(posX, 0.0f, posZ);
 }
 
-Uniform uniform;
-Uniform uniform2;
-Uniform uniform3;
-Uniform uniform4;
-Uniform uniform5;
-Uniform uniform6;
-Uniform uniform7;
-Uniform uniform8;
-Uniform uniform9;
-
-BuildingModel model1;
-BuildingModel model2;
-BuildingModel model3;
-BuildingModel model4;
-BuildingModel model5;
-BuildingModel model6;
-BuildingModel model7;
-BuildingModel model8;
-BuildingModel model9;
-
-void render(const std::vector<Vertex>& vertexArray,  const Uniform& uniform, int planetIdentifier) {
-    std::vector<Vertex> transformedVertexArray;
+float calculateBoundingRadius(const std::vector<Vertex>& vertexArray) {
+    float radius = 0.0f;
     for (const auto& vertex : vertexArray) {
-        auto transformedVertex = vertexShader(vertex, uniform);
-        transformedVertexArray.push_back(transformedVertex);
+        radius = std::max(radius, glm::length(vertex.position));
     }
+    return radius;
+}
 
-    for (size_t i = 0; i < transformedVertexArray.size(); i += 3) {
-        const Vertex& a = transformedVertexArray[i];
-        const Vertex& b = transformedVertexArray[i + 1];
-        const Vertex& c = transformedVertexArray[i + 2];
+float calculateProjectedRadius(const Uniform& uniform, float boundingRadius) {
+    glm::vec4 center = uniform.view * uniform.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float scale = std::max({glm::length(glm::vec3(uniform.model[0])), glm::length(glm::vec3(uniform.model[1])), glm::length(glm::vec3(uniform.model[2]))});
+    float radius = boundingRadius * scale;
+    float distance = glm::length(glm::vec3(center));
+    if (distance <= radius) {
+        return std::numeric_limits<float>::max();
+    }
+    return radius / distance * uniform.projection[1][1] * (WINDOW_HEIGHT / 2.0f);
+}
 
-        glm::vec3 A = a.position;
-        glm::vec3 B = b.position;
-        glm::vec3 C = c.position;
+ShadingQuality selectShadingQuality(Planets planet, const Uniform& uniform, float boundingRadius, size_t vertexCount) {
+    if (planet == SPACE || planet == SHIP) {
+        return PER_PIXEL;
+    }
+    float projectedRadius = calculateProjectedRadius(uniform, boundingRadius);
+    float projectedArea = 3.14159f * projectedRadius * projectedRadius;
+    // Solo la mitad de los vértices es visible; si el planeta cubre menos píxeles que eso, por píxel sale más barato
+    if (projectedRadius >= gouraudScreenRadiusThreshold || projectedArea < vertexCount / 2.0f) {
+        // Las cachés y texturas guardan 8 bits; la emisión HDR solo sale del shader evaluado por píxel
+        if (hdrFramebufferEnabled && planetSurfaces[planet].hdrShader) {
+            return PER_PIXEL;
+        }
+        // De cerca ninguna textura de tamaño fijo alcanza; el detalle sale de los tiles virtuales
+        if (virtualTexturedPlanets && projectedRadius >= virtualTextureScreenRadiusThreshold) {
+            return VIRTUAL_TEXTURE;
+        }
+        // Las texturas y la caché sombrean una vez por texel, así que van antes que el grafo evaluado en cada fragmento;
+        // los tiles virtuales y las texturas horneadas ya salen del grafo cuando el planeta lo tiene
+        if (bakedPlanetTextures) {
+            return BAKED_TEXTURE;
+        }
+        if (textureSpaceShading) {
+            return TEXTURE_SPACE;
+        }
+        // Un material cargado de materials/ reemplaza al shader compilado
+        if (noiseGraphMaterials && planetSurfaces[planet].noiseGraph.output >= 0) {
+            return NOISE_GRAPH;
+        }
+        return PER_PIXEL;
+    }
+    return hybridGouraudLighting ? HYBRID : PER_VERTEX;
+}
 
-        int minX = static_cast<int>(std::min({A.x, B.x, C.x}));
-        int minY = static_cast<int>(std::min({A.y, B.y, C.y}));
-        int maxX = static_cast<int>(std::max({A.x, B.x, C.x}));
-        int maxY = static_cast<int>(std::max({A.y, B.y, C.y}));
+Uniform uniform;
+std::vector<DrawCommand> drawList;
 
-        for (int y = minY; y <= maxY; ++y) {
-            for (int x = minX; x <= maxX; ++x) {
-                if (y>0 && y<WINDOW_HEIGHT && x>0 && x<WINDOW_WIDTH) {
-                    glm::vec2 pixelPosition(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
-                    glm::vec3 barycentricCoord = calculateBarycentricCoord(A, B, C, pixelPosition);
+// Los meshlets se prueban en dos pasadas: la primera contra la profundidad del cuadro anterior y la segunda, con la
+// profundidad que dejó la primera, dibuja los que aquella tapó de más porque algo se movió
+enum MeshletPass {
+    FIRST_MESHLET_PASS,
+    SECOND_MESHLET_PASS
+};
 
-                    double cam = barycentricCoord.x * a.z + barycentricCoord.y * b.z + barycentricCoord.z * c.z;
+MeshletPass meshletPass = FIRST_MESHLET_PASS;
+DepthPyramid previousDepthPyramid;
+DepthPyramid depthPyramid;
+std::atomic<size_t> totalMeshlets;
+std::atomic<size_t> visibleMeshlets;
+std::atomic<size_t> occludedMeshlets;
+
+// El uniform de una instancia: el del cuadro con su modelo y su fase
+Uniform instanceUniform(const Uniform& frameUniform, const InstanceData& instance) {
+    Uniform result = frameUniform;
+    result.model = instance.model;
+    result.animationPhase = instance.animationPhase;
+    return result;
+}
 
-                    if (isBarycentricCoord(barycentricCoord) && cam > 0) {
-                        Color modelColor {0, 0, 0};
-                        Color interpolatedColor = interpolateColor(barycentricCoord, modelColor, modelColor, modelColor);
+// Lo que comparten las instancias de un lote: la malla decodificada una sola vez y los arreglos que cada instancia
+// vuelve a llenar
+struct BatchScratch {
+    std::vector<Vertex> decoded;
+    std::vector<Vertex> transformed;
+    std::vector<bool> transformedReady;
+    std::vector<std::pair<size_t, size_t>> indexRanges; // Tramos del índice que sobreviven al descarte de meshlets
+    std::vector<Color> vertexColors;
+    std::vector<bool> vertexColorReady;
+    // Fragmentos de una fila de un triángulo que esperan su color de vértice, interpolado en bloques con interpolatePixelRow
+    std::vector<Fragment> rowFragments;
+    std::vector<float> rowU, rowV, rowW, rowIntensity;
+    std::vector<Uint32> rowColors;
+};
 
-                        float depth = barycentricCoord.x * A.z + barycentricCoord.y * B.z + barycentricCoord.z * C.z;
+template <FragmentShader shader>
+Color shadeVertex(const Vertex& vertex, const Uniform& uniform) {
+    Fragment fragment;
+    fragment.position = glm::ivec2(vertex.position.x, vertex.position.y);
+    fragment.z = vertex.position.z;
+    fragment.original = vertex.original;
+    fragment.normal = vertex.normal;
+    return shader(fragment, uniform);
+}
 
-                        glm::vec3 normal = a.normal * barycentricCoord.x + b.normal * barycentricCoord.y+ c.normal * barycentricCoord.z;
+template <FragmentShader shader, LightingModel lighting, ShadingQuality quality>
+void renderInstance(const QuantizedMesh& mesh, BatchScratch& batch, bool analyticSphere, const Uniform& uniform, PlanetSurface* surface) {
+    constexpr bool vertexShaded = quality == PER_VERTEX || quality == HYBRID;
+
+    // Los meshlets que miran hacia atrás, caen fuera de la vista o quedan detrás de la pirámide de profundidad se
+    // descartan antes de transformar sus vértices; una malla sin meshlets es un solo tramo
+    std::vector<std::pair<size_t, size_t>>& indexRanges = batch.indexRanges;
+    indexRanges.clear();
+    if (!analyticSphere) {
+        if (meshletCulling && !mesh.meshlets.empty()) {
+            MeshletView meshletView = createMeshletView(uniform, mesh);
+            const DepthPyramid* occluders = meshletOcclusionCulling ? &previousDepthPyramid : nullptr;
+            size_t visible = 0;
+            size_t occluded = 0;
+            for (const Meshlet& meshlet : mesh.meshlets) {
+                MeshletVisibility visibility = classifyMeshlet(meshlet, meshletView, occluders);
+                if (meshletPass == SECOND_MESHLET_PASS) {
+                    if (visibility != MESHLET_OCCLUDED || classifyMeshlet(meshlet, meshletView, &depthPyramid) != MESHLET_VISIBLE) {
+                        continue;
+                    }
+                } else if (visibility != MESHLET_VISIBLE) {
+                    occluded += visibility == MESHLET_OCCLUDED;
+                    continue;
+                }
+                visible++;
+                if (!indexRanges.empty() && indexRanges.back().second == meshlet.firstIndex) {
+                    indexRanges.back().second += meshlet.indexCount;
+                } else {
+                    indexRanges.push_back({meshlet.firstIndex, meshlet.firstIndex + meshlet.indexCount});
+                }
+            }
+            visibleMeshlets += visible;
+            occludedMeshlets += occluded;
+            if (meshletPass == FIRST_MESHLET_PASS) {
+                totalMeshlets += mesh.meshlets.size();
+            }
+        } else {
+            indexRanges.push_back({0, mesh.indices.size()});
+        }
+    }
 
-                        float fragmentIntensity = (abs(glm::dot(normal, light)) > 1 ) ? 1: abs(glm::dot(normal, light));
+    // Cada vértice único que usa algún tramo se transforma una vez; los triángulos lo leen por índice
+    std::vector<Vertex>& transformedVertexArray = batch.transformed;
+    std::vector<bool>& transformedReady = batch.transformedReady;
+    if (!indexRanges.empty()) {
+        glm::mat4 modelViewProjection = uniform.projection * uniform.view * uniform.model;
+        glm::mat3 normalMatrix(uniform.model);
+        std::fill(transformedReady.begin(), transformedReady.end(), false);
+        for (const auto& [firstIndex, lastIndex] : indexRanges) {
+            for (size_t i = firstIndex; i < lastIndex; i++) {
+                Uint32 index = mesh.indices[i];
+                if (!transformedReady[index]) {
+                    transformedVertexArray[index] = transformVertex(batch.decoded[index], modelViewProjection, uniform.viewport, normalMatrix);
+                    transformedReady[index] = true;
+                }
+            }
+        }
+    }
 
-                        if (planetIdentifier == SPACE) {
-                            fragmentIntensity = glm::dot(normal, glm::vec3(0.0f,0.0f,1.0f));
-                        }
-                        if (fragmentIntensity <= 0){
-                            continue;
-                        }
+    // El planeta que se dibuja no cuenta como oclusor de sí mismo
+    Uint32 eclipseSelf = eclipseOccluderBits(eclipseTiles, glm::vec3(uniform.model[3]));
 
-                        Color finalColor = interpolatedColor * fragmentIntensity;
-                        glm::vec3 original = a.original * barycentricCoord.x + b.original * barycentricCoord.y + c.original * barycentricCoord.z;
-
-                        Fragment fragment;
-                        fragment.position = glm::ivec2(x, y);
-                        fragment.color = finalColor;
-                        fragment.z = depth;
-                        fragment.original = original;
-
-                        int index = y * WINDOW_WIDTH + x;
-                        if (depth < zBuffer[index]) {
-                            mutex.lock();
-                            Color fragmentShaderf;
-
-                            switch (planetIdentifier) {
-                                case SPACE:
-                                    fragmentShaderf = fragmentShader(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case SUN:
-                                    fragmentShaderf = fragmentShaderSun(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case EARTH:
-                                    fragmentShaderf = fragmentShaderEarth(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case MARS:
-                                    fragmentShaderf = fragmentShaderMars(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case JUPITER:
-                                    fragmentShaderf = fragmentShaderJupiter(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case SATURN:
-                                    fragmentShaderf = fragmentShaderSaturn(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case URANUS:
-                                    fragmentShaderf = fragmentShaderUranus(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case NEPTUNE:
-                                    fragmentShaderf = fragmentShaderNeptune(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
-                                case SHIP:
-                                    fragmentShaderf = fragmentShaderSpaceship(fragment);
-                                    SDL_SetRenderDrawColor(renderer, fragmentShaderf.r, fragmentShaderf.g, fragmentShaderf.b, fragmentShaderf.a);
-                                    break;
+    // El color de cada vértice se calcula la primera vez que lo necesita un píxel visible. PER_VERTEX también lo
+    // ilumina en el vértice; HYBRID solo toma de los vértices el color del shader y lo ilumina en cada píxel
+    std::vector<Color>& vertexColors = batch.vertexColors;
+    std::vector<bool>& vertexColorReady = batch.vertexColorReady;
+    if constexpr (vertexShaded) {
+        std::fill(vertexColorReady.begin(), vertexColorReady.end(), false);
+    }
+    auto vertexColorAt = [&](Uint32 index) {
+        if (!vertexColorReady[index]) {
+            const Vertex& vertex = transformedVertexArray[index];
+            Color color = shadeVertex<shader>(vertex, uniform);
+            if constexpr (quality == PER_VERTEX && lighting == LIGHT_FACING) {
+                // Un vértice fuera de la pantalla toma las luces del tile del borde
+                int x = static_cast<int>(std::clamp(vertex.position.x, 0.0f, WINDOW_WIDTH - 1.0f));
+                int y = static_cast<int>(std::clamp(vertex.position.y, 0.0f, WINDOW_HEIGHT - 1.0f));
+                glm::vec3 position(uniform.model * glm::vec4(vertex.original, 1.0f));
+                float visibility = eclipseVisibility(eclipseTiles, x, y, position, eclipseSelf);
+                color = fromLinear(shadeClusteredLights(lightClusters, x, y, position, vertex.normal, toLinear(color), visibility));
+            } else if constexpr (quality == PER_VERTEX && lighting == VIEW_FACING) {
+                color = color * std::max(vertex.normal.z, 0.0f);
+            }
+            vertexColors[index] = color;
+            vertexColorReady[index] = true;
+        }
+        return vertexColors[index];
+    };
+
+    // La atmósfera se aplica sobre el color final de la superficie, con la cámara y el sol de este cuadro
+    const Atmosphere* atmosphere = surface ? surface->atmosphere.get() : nullptr;
+    AtmosphereView atmosphereView{};
+    if (atmosphere) {
+        atmosphereView = createAtmosphereView(*atmosphere, uniform);
+    }
+
+    // Escribe un píxel ya sombreado; se llama con el candado tomado. El cielo se dibuja antes que las mallas, así que
+    // los bordes de las esferas (coverage < 1) se mezclan con lo que ya hay: el cielo o lo que se dibujó detrás. En
+    // HDR la mezcla va en hdrCoverage y el fondo de 8 bits se agrega al resolver. Solo los que tienen el centro dentro
+    // de la silueta (coverage >= 0.5) escriben profundidad, para que lo que se dibuje detrás después no quede tapado
+    // por un borde casi transparente
+    auto storePixel = [&](int x, int y, float depth, const Color& color, const ColorF& hdrColor, bool hdrShaded, float coverage) {
+        int index = y * WINDOW_WIDTH + x;
+        if (depth >= zBuffer[index]) {
+            return;
+        }
+        if (hdrFramebufferEnabled) {
+            ColorF value = hdrShaded ? hdrColor : toLinear(color);
+            float& covered = hdrCoverage[WINDOW_HEIGHT - y][x];
+            if (coverage < 1.0f) {
+                // Sobre un color ya multiplicado por su cobertura; sin cobertura lo guardado es de otro cuadro
+                __m128 background = covered > 0.0f ? loadColorF(hdrFramebuffer[WINDOW_HEIGHT - y][x]) : _mm_setzero_ps();
+                storeColorF(value, _mm_add_ps(background, _mm_mul_ps(_mm_set1_ps(coverage), _mm_sub_ps(loadColorF(value), background))));
+                covered += coverage * (1.0f - covered);
+            } else {
+                covered = 1.0f;
+            }
+            hdrFramebuffer[WINDOW_HEIGHT - y][x] = value;
+        } else if (coverage < 1.0f) {
+            Color& pixel = framebuffer[WINDOW_HEIGHT - y][x];
+            pixel = Color::fromPixel(interpolatePixel(coverage, 1.0f - coverage, 0.0f, color.toPixel(), pixel.toPixel(), 0));
+        } else {
+            framebuffer[WINDOW_HEIGHT - y][x] = color;
+        }
+        if (coverage >= 0.5f) {
+            zBuffer[index] = depth;
+        }
+    };
+
+    // Los materiales de grafo se evalúan por lotes de fragmentos que se escriben con un solo candado por lote
+    NoiseGraphContext graphContext;
+    NoiseGraphBatch graphBatch;
+    std::array<glm::ivec2, NOISE_GRAPH_BATCH> graphPixels;
+    std::array<glm::vec3, NOISE_GRAPH_BATCH> graphNormals;
+    std::array<float, NOISE_GRAPH_BATCH> graphCoverage;
+    std::array<Color, NOISE_GRAPH_BATCH> graphColors;
+    if constexpr (quality == NOISE_GRAPH) {
+        createNoiseGraphContext(graphContext, surface->noiseGraph);
+    }
+    auto flushGraphBatch = [&]() {
+        evaluateNoiseGraph(graphContext, graphBatch, graphColors.data());
+        if (lighting == LIGHT_FACING || atmosphere) {
+            for (int lane = 0; lane < graphBatch.count; lane++) {
+                glm::vec3 original(graphBatch.x[lane], graphBatch.y[lane], graphBatch.z[lane]);
+                ColorF shaded = toLinear(graphColors[lane]);
+                if constexpr (lighting == LIGHT_FACING) {
+                    glm::vec3 position(uniform.model * glm::vec4(original, 1.0f));
+                    float visibility = eclipseVisibility(eclipseTiles, graphPixels[lane].x, graphPixels[lane].y, position, eclipseSelf);
+                    shaded = shadeClusteredLights(lightClusters, graphPixels[lane].x, graphPixels[lane].y, position, graphNormals[lane], shaded, visibility);
+                }
+                if (atmosphere) {
+                    shaded = shadeAtmosphereSurface(*atmosphere, atmosphereView, original, shaded);
+                }
+                graphColors[lane] = fromLinear(shaded);
+            }
+        }
+        mutex.lock();
+        for (int lane = 0; lane < graphBatch.count; lane++) {
+            storePixel(graphPixels[lane].x, graphPixels[lane].y, graphBatch.depth[lane], graphColors[lane], ColorF(), false, graphCoverage[lane]);
+        }
+        mutex.unlock();
+        graphBatch.count = 0;
+    };
+
+    // Sombrea y escribe un fragmento de la malla o de la esfera; vertexColor es el color ya interpolado de los modos
+    // por vértice
+    auto shadeFragment = [&](Fragment& fragment, const Color& vertexColor, float coverage) {
+        int x = fragment.position.x;
+        int y = fragment.position.y;
+        float depth = fragment.z;
+        int index = y * WINDOW_WIDTH + x;
+        if (depth >= zBuffer[index]) {
+            return;
+        }
+
+        if constexpr (quality == NOISE_GRAPH) {
+            int lane = graphBatch.count++;
+            graphPixels[lane] = glm::ivec2(x, y);
+            graphNormals[lane] = fragment.normal;
+            graphCoverage[lane] = coverage;
+            graphBatch.x[lane] = fragment.original.x;
+            graphBatch.y[lane] = fragment.original.y;
+            graphBatch.z[lane] = fragment.original.z;
+            graphBatch.depth[lane] = depth;
+            graphBatch.footprint[lane] = fragment.footprint;
+            if (graphBatch.count == NOISE_GRAPH_BATCH) {
+                flushGraphBatch();
+            }
+            return;
+        }
+
+        // Los shaders solo leen el uniform, así que se evalúan fuera del candado y en paralelo
+        Color fragmentShaderf;
+        ColorF hdrColor;
+        bool hdrShaded = false;
+
+        if constexpr (quality == PER_PIXEL) {
+            if (hdrFramebufferEnabled && surface->hdrShader) {
+                hdrColor = surface->hdrShader(fragment, uniform);
+                hdrShaded = true;
+            } else {
+                fragmentShaderf = shader(fragment, uniform);
+            }
+        } else if constexpr (quality == TEXTURE_SPACE) {
+            // Cada planeta lo dibuja un solo hilo, así que su caché no necesita candado
+            fragmentShaderf = sampleShadingCache<shader>(surface->shadingCache, fragment, uniform);
+        } else if constexpr (quality == BAKED_TEXTURE) {
+            fragmentShaderf = sampleCubeMap(surface->bakedTexture, fragment.original);
+        } else if constexpr (quality == VIRTUAL_TEXTURE) {
+            fragmentShaderf = sampleVirtualTexture(*surface->virtualTexture, fragment.original, fragment.footprint);
+        } else {
+            fragmentShaderf = vertexColor;
+        }
+
+        // Con PER_VERTEX la luz ya viene interpolada de los vértices
+        constexpr bool pixelLighting = lighting == LIGHT_FACING && quality != PER_VERTEX;
+        if (pixelLighting || atmosphere) {
+            ColorF shaded = hdrShaded ? hdrColor : toLinear(fragmentShaderf);
+            if constexpr (pixelLighting) {
+                glm::vec3 position(uniform.model * glm::vec4(fragment.original, 1.0f));
+                float visibility = eclipseVisibility(eclipseTiles, x, y, position, eclipseSelf);
+                shaded = shadeClusteredLights(lightClusters, x, y, position, fragment.normal, shaded, visibility);
+            }
+            if (atmosphere) {
+                shaded = shadeAtmosphereSurface(*atmosphere, atmosphereView, fragment.original, shaded);
+            }
+            if (hdrFramebufferEnabled) {
+                hdrColor = shaded;
+                hdrShaded = true;
+            } else {
+                fragmentShaderf = fromLinear(shaded);
+            }
+        }
+
+        mutex.lock();
+        storePixel(x, y, depth, fragmentShaderf, hdrColor, hdrShaded, coverage);
+        mutex.unlock();
+    };
+
+    if (analyticSphere) {
+        rasterizeSphere(uniform, surface->sphereRadius, [&](Fragment& fragment, float coverage) {
+            if constexpr (lighting == VIEW_FACING) {
+                if (fragment.normal.z <= 0.0f) {
+                    return;
+                }
+            }
+            shadeFragment(fragment, Color(), coverage);
+        });
+    }
+
+    for (const auto& [firstIndex, lastIndex] : indexRanges) {
+        for (size_t i = firstIndex; i + 2 < lastIndex; i += 3) {
+            const Vertex& a = transformedVertexArray[mesh.indices[i]];
+            const Vertex& b = transformedVertexArray[mesh.indices[i + 1]];
+            const Vertex& c = transformedVertexArray[mesh.indices[i + 2]];
+
+            glm::vec3 A = a.position;
+            glm::vec3 B = b.position;
+            glm::vec3 C = c.position;
+
+            int minX = static_cast<int>(std::min({A.x, B.x, C.x}));
+            int minY = static_cast<int>(std::min({A.y, B.y, C.y}));
+            int maxX = static_cast<int>(std::max({A.x, B.x, C.x}));
+            int maxY = static_cast<int>(std::max({A.y, B.y, C.y}));
+
+            bool vertexColorsReady = false;
+            Color colorA, colorB, colorC;
+
+            // La interpolación es afín en pantalla, así que las diferencias finitas de un quad 2x2 son iguales en todo el triángulo
+            float footprint = 0.0f;
+            if constexpr (quality == PER_PIXEL || quality == TEXTURE_SPACE || quality == VIRTUAL_TEXTURE || quality == NOISE_GRAPH) {
+                glm::vec2 quadOrigin(minX + 0.5f, minY + 0.5f);
+                glm::vec3 baryOrigin = calculateBarycentricCoord(A, B, C, quadOrigin);
+                glm::vec3 baryStepX = calculateBarycentricCoord(A, B, C, quadOrigin + glm::vec2(1.0f, 0.0f)) - baryOrigin;
+                glm::vec3 baryStepY = calculateBarycentricCoord(A, B, C, quadOrigin + glm::vec2(0.0f, 1.0f)) - baryOrigin;
+                glm::vec3 originalDx = a.original * baryStepX.x + b.original * baryStepX.y + c.original * baryStepX.z;
+                glm::vec3 originalDy = a.original * baryStepY.x + b.original * baryStepY.y + c.original * baryStepY.z;
+                footprint = std::max(glm::length(originalDx), glm::length(originalDy));
+            }
+
+            for (int y = minY; y <= maxY; ++y) {
+                for (int x = minX; x <= maxX; ++x) {
+                    if (y>0 && y<WINDOW_HEIGHT && x>0 && x<WINDOW_WIDTH) {
+                        glm::vec2 pixelPosition(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+                        glm::vec3 barycentricCoord = calculateBarycentricCoord(A, B, C, pixelPosition);
+
+                        double cam = barycentricCoord.x * a.z + barycentricCoord.y * b.z + barycentricCoord.z * c.z;
+
+                        if (isBarycentricCoord(barycentricCoord) && cam > 0) {
+                            Color modelColor {0, 0, 0};
+                            Color interpolatedColor = interpolateColor(barycentricCoord, modelColor, modelColor, modelColor);
+
+                            float depth = barycentricCoord.x * A.z + barycentricCoord.y * B.z + barycentricCoord.z * C.z;
+
+                            glm::vec3 normal = a.normal * barycentricCoord.x + b.normal * barycentricCoord.y+ c.normal * barycentricCoord.z;
+
+                            // Las caras iluminadas reciben la luz de los clusters después del shader
+                            float fragmentIntensity = 1.0f;
+                            if constexpr (lighting == VIEW_FACING) {
+                                fragmentIntensity = glm::dot(normal, glm::vec3(0.0f,0.0f,1.0f));
                             }
+                            if (fragmentIntensity <= 0){
+                                continue;
+                            }
+
+                            Color finalColor = interpolatedColor * fragmentIntensity;
+                            glm::vec3 original = a.original * barycentricCoord.x + b.original * barycentricCoord.y + c.original * barycentricCoord.z;
+
+                            Fragment fragment;
+                            fragment.position = glm::ivec2(x, y);
+                            fragment.color = finalColor;
+                            fragment.z = depth;
+                            fragment.original = original;
+                            fragment.footprint = footprint;
+                            fragment.normal = glm::normalize(normal);
+
+                            if constexpr (vertexShaded) {
+                                if (depth >= zBuffer[y * WINDOW_WIDTH + x]) {
+                                    continue;
+                                }
+                                batch.rowFragments.push_back(fragment);
+                                batch.rowU.push_back(barycentricCoord.x);
+                                batch.rowV.push_back(barycentricCoord.y);
+                                batch.rowW.push_back(barycentricCoord.z);
+                                batch.rowIntensity.push_back(fragmentIntensity);
+                            } else {
+                                shadeFragment(fragment, Color(), 1.0f);
+                            }
+                        }
+                    }
+                }
 
-                            SDL_RenderDrawPoint(renderer, x, WINDOW_HEIGHT-y);
-                            nextTime = 0.5f + 1.0f;
-                            zBuffer[index] = depth;
-                            mutex.unlock();
+                // Los colores de la fila se interpolan juntos antes de sombrear, en el mismo orden de x
+                if constexpr (vertexShaded) {
+                    size_t count = batch.rowFragments.size();
+                    if (count == 0) {
+                        continue;
+                    }
+                    if (!vertexColorsReady) {
+                        colorA = vertexColorAt(mesh.indices[i]);
+                        colorB = vertexColorAt(mesh.indices[i + 1]);
+                        colorC = vertexColorAt(mesh.indices[i + 2]);
+                        vertexColorsReady = true;
+                    }
+                    batch.rowColors.resize(count);
+                    interpolatePixelRow(batch.rowU.data(), batch.rowV.data(), batch.rowW.data(), colorA.toPixel(), colorB.toPixel(), colorC.toPixel(), batch.rowColors.data(), count);
+                    for (size_t k = 0; k < count; k++) {
+                        Color vertexColor = Color::fromPixel(batch.rowColors[k]);
+                        if constexpr (quality == HYBRID) {
+                            vertexColor = vertexColor * batch.rowIntensity[k];
                         }
+                        shadeFragment(batch.rowFragments[k], vertexColor, 1.0f);
                     }
+                    batch.rowFragments.clear();
+                    batch.rowU.clear();
+                    batch.rowV.clear();
+                    batch.rowW.clear();
+                    batch.rowIntensity.clear();
                 }
             }
         }
     }
+
+    if constexpr (quality == NOISE_GRAPH) {
+        if (graphBatch.count > 0) {
+            flushGraphBatch();
+        }
+    }
+}
+
+// Dibuja todas las instancias de un lote: la malla se decodifica una vez y cada instancia solo paga su transformación
+template <FragmentShader shader, LightingModel lighting, ShadingQuality quality>
+void render(const QuantizedMesh& mesh, std::span<const InstanceData> instances, const Uniform& frameUniform, PlanetSurface* surface) {
+    // Las esferas analíticas no tienen vértices, así que los modos que sombrean por vértice siguen con la malla
+    constexpr bool vertexShaded = quality == PER_VERTEX || quality == HYBRID;
+    bool analyticSphere = !vertexShaded && analyticSpheres && surface && surface->sphereRadius > 0.0f;
+
+    // La segunda pasada solo vuelve sobre los meshlets; las esferas y las mallas enteras ya quedaron dibujadas
+    if (meshletPass == SECOND_MESHLET_PASS && (analyticSphere || mesh.meshlets.empty())) {
+        return;
+    }
+
+    BatchScratch batch;
+    if (!analyticSphere) {
+        batch.decoded.resize(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            batch.decoded[i] = decodeVertex(mesh, i);
+        }
+        batch.transformed.resize(mesh.vertices.size());
+        batch.transformedReady.resize(mesh.vertices.size());
+        if constexpr (vertexShaded) {
+            batch.vertexColors.resize(mesh.vertices.size());
+            batch.vertexColorReady.resize(mesh.vertices.size());
+        }
+    }
+    for (const InstanceData& instance : instances) {
+        renderInstance<shader, lighting, quality>(mesh, batch, analyticSphere, instanceUniform(frameUniform, instance), surface);
+    }
+}
+
+typedef void (*RenderPipeline)(const QuantizedMesh&, std::span<const InstanceData>, const Uniform&, PlanetSurface*);
+
+std::array<std::array<RenderPipeline, 7>, SHIP + 1> pipelineTable;
+
+template <FragmentShader shader, LightingModel lighting>
+void registerPipeline(Planets planet) {
+    pipelineTable[planet][PER_PIXEL] = render<shader, lighting, PER_PIXEL>;
+    pipelineTable[planet][PER_VERTEX] = render<shader, lighting, PER_VERTEX>;
+    pipelineTable[planet][HYBRID] = render<shader, lighting, HYBRID>;
+    pipelineTable[planet][TEXTURE_SPACE] = render<shader, lighting, TEXTURE_SPACE>;
+    pipelineTable[planet][BAKED_TEXTURE] = render<shader, lighting, BAKED_TEXTURE>;
+    pipelineTable[planet][VIRTUAL_TEXTURE] = render<shader, lighting, VIRTUAL_TEXTURE>;
+    pipelineTable[planet][NOISE_GRAPH] = render<shader, lighting, NOISE_GRAPH>;
+}
+
+void buildPipelineTable() {
+    registerPipeline<fragmentShader, VIEW_FACING>(SPACE);
+    registerPipeline<fragmentShaderSun, EMISSIVE>(SUN);
+    registerPipeline<fragmentShaderEarth, LIGHT_FACING>(EARTH);
+    registerPipeline<fragmentShaderMars, LIGHT_FACING>(MARS);
+    registerPipeline<fragmentShaderJupiter, LIGHT_FACING>(JUPITER);
+    registerPipeline<fragmentShaderSaturn, LIGHT_FACING>(SATURN);
+    registerPipeline<fragmentShaderUranus, LIGHT_FACING>(URANUS);
+    registerPipeline<fragmentShaderNeptune, LIGHT_FACING>(NEPTUNE);
+    registerPipeline<fragmentShaderSpaceship, LIGHT_FACING>(SHIP);
+}
+
+// Luces dinámicas del cuadro: los motores de la nave, balizas que orbitan cada planeta y llamaradas que salen del sol
+void addDynamicLights(std::vector<PointLight>& lights, float time, const glm::vec3& forward, const glm::vec3& upVector, const glm::mat4& shipModel, std::span<const InstanceData> planets, float boundingRadius) {
+    glm::vec3 shipCenter(shipModel[3]);
+    glm::vec3 right = glm::normalize(glm::cross(forward, upVector));
+    float flicker = 1.2f + 0.3f * std::sin(time * 31.0f);
+    for (float side : {-1.0f, 1.0f}) {
+        lights.push_back({shipCenter - forward * 0.06f + right * (0.03f * side), 0.5f, ColorF(0.3f, 0.5f, 1.0f) * flicker});
+    }
+
+    for (const InstanceData& planet : planets) {
+        if (planet.material == SUN) {
+            continue;
+        }
+        glm::vec3 center(planet.model[3]);
+        float planetRadius = boundingRadius * glm::length(glm::vec3(planet.model[0]));
+        for (int i = 0; i < beaconLightsPerPlanet; i++) {
+            float angle = time * 0.8f + 6.2831853f * i / beaconLightsPerPlanet;
+            float tilt = std::sin(i * 1.7f) * 0.4f;
+            glm::vec3 orbit(std::cos(angle), tilt, std::sin(angle));
+            float blink = 0.5f + 0.5f * std::sin(time * 4.0f + i);
+            ColorF color = i % 2 == 0 ? ColorF(1.0f, 0.15f, 0.1f) : ColorF(0.1f, 1.0f, 0.3f);
+            lights.push_back({center + glm::normalize(orbit) * (planetRadius * 1.15f), planetRadius * 0.6f, color * blink});
+        }
+    }
+
+    // Direcciones repartidas con la espiral de Fibonacci; cada llamarada sube y baja con su propia fase
+    float sunRadius = boundingRadius * 1.5f;
+    for (int i = 0; i < sunFlareLights; i++) {
+        float height = 1.0f - 2.0f * (i + 0.5f) / sunFlareLights;
+        float ring = std::sqrt(1.0f - height * height);
+        float angle = i * 2.3999632f;
+        glm::vec3 direction(ring * std::cos(angle), height, ring * std::sin(angle));
+        float pulse = 0.5f + 0.5f * std::sin(time * 1.3f + i * 0.9f);
+        lights.push_back({direction * (sunRadius * (1.05f + 0.3f * pulse)), 1.0f, ColorF(1.0f, 0.45f, 0.1f) * (2.0f * pulse)});
+    }
+}
+
+// Agrega instancias de mesh a la lista del cuadro. Las que no caen en pantalla se descartan acá, antes de tocar un
+// vértice; las demás se agrupan por material y calidad, que es lo que fija la plantilla de render
+void drawInstanced(const MeshHandle& mesh, std::span<const InstanceData> instances, const Uniform& frameUniform, float boundingRadius) {
+    for (const InstanceData& instance : instances) {
+        Uniform instanceView = instanceUniform(frameUniform, instance);
+        glm::vec3 center(frameUniform.view * instance.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        float scale = std::max({glm::length(glm::vec3(instance.model[0])), glm::length(glm::vec3(instance.model[1])), glm::length(glm::vec3(instance.model[2]))});
+        if (!sphereInFrustum(center, boundingRadius * scale, frameUniform.projection)) {
+            continue;
+        }
+        ShadingQuality quality = selectShadingQuality(instance.material, instanceView, boundingRadius, mesh->vertices.size());
+        if (quality == TEXTURE_SPACE) {
+            beginShadingCacheFrame(planetSurfaces[instance.material].shadingCache, calculateProjectedRadius(instanceView, boundingRadius));
+        }
+        auto command = std::find_if(drawList.begin(), drawList.end(), [&](const DrawCommand& existing) {
+            return existing.mesh == mesh && existing.material == instance.material && existing.quality == quality;
+        });
+        if (command == drawList.end()) {
+            drawList.push_back({mesh, instance.material, quality, {}});
+            command = drawList.end() - 1;
+        }
+        command->instances.push_back(instance);
+    }
+}
+
+// Cada lote va en su hilo. Los lotes grandes de las calidades que no escriben en la superficie se reparten entre
+// varios hilos; la caché de sombreado y las texturas virtuales siguen con un solo hilo por planeta
+void executeDrawList(const Uniform& frameUniform) {
+    size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (const DrawCommand& command : drawList) {
+        size_t count = command.instances.size();
+        bool splittable = command.quality == PER_PIXEL || command.quality == PER_VERTEX || command.quality == HYBRID || command.quality == BAKED_TEXTURE;
+        size_t chunk = splittable ? std::max(minimumInstancesPerThread, (count + hardwareThreads - 1) / hardwareThreads) : count;
+        for (size_t first = 0; first < count; first += chunk) {
+            std::span<const InstanceData> instances(command.instances.data() + first, std::min(chunk, count - first));
+            threads.emplace_back(pipelineTable[command.material][command.quality], std::cref(*command.mesh), instances, std::cref(frameUniform), &planetSurfaces[command.material]);
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
 }
 
 int main(int argc, char* argv[]) {
 
     SDL_Init(SDL_INIT_EVERYTHING);
     startingFrame = SDL_GetTicks();
+    Uint32 startTicks = startingFrame;
     SDL_Window* window = SDL_CreateWindow("Space Travel", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, 0);
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    buildPipelineTable();
 
     glm::vec3 cameraPosition(0.0f, 0.0f, 17.0f);
     glm::vec3 targetPosition(0.0f, 0.0f, 0.0f);
     glm::vec3 upVector(0.0f, 1.0f, 0.0f);
 
-    std::vector<BuildingModel> models;
     int renderWidth, renderHeight;
     SDL_GetRendererOutputSize(renderer, &renderWidth, &renderHeight);
 
@@ -270,6 +841,75 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     std::vector<Vertex> vertexArrayPlanet = setupVertexArray(planetVertices, planetNormal, planetFaces);
+    float planetBoundingRadius = calculateBoundingRadius(vertexArrayPlanet);
+    MeshHandle planetMesh = createMeshHandle(createQuantizedMesh(vertexArrayPlanet, optimizeMeshOrder));
+
+    // El sol y los planetas son sphere.obj escalado, así que la esfera analítica usa su radio
+    for (int planet = SUN; planet <= NEPTUNE; planet++) {
+        planetSurfaces[planet].sphereRadius = planetBoundingRadius;
+    }
+    // Con el mismo radio, los planetas que pasan por triángulos eligen entre 20 y 20480 triángulos según su tamaño en pantalla
+    SphereLODChain planetLODs = generateSphereLODs(planetBoundingRadius, sphereLODLevels);
+
+    if (textureSpaceShading) {
+        for (int planet = SUN; planet <= NEPTUNE; planet++) {
+            initShadingCache(planetSurfaces[planet].shadingCache, planetBoundingRadius);
+        }
+    }
+
+    // Los materiales se hornean con la luz fija en +Z; Marte conserva ese relieve iluminado al girar
+    Uniform bakeUniform{};
+    bakeUniform.model = glm::mat4(1.0f);
+    bakeUniform.frame.sunPosition = glm::vec3(0.0f, 0.0f, 1000.0f);
+    bakeUniform.animationPhase = animationPhase;
+    std::array<FragmentShader, SHIP + 1> planetShaders = {nullptr, fragmentShaderSun, fragmentShaderEarth, fragmentShaderMars, fragmentShaderJupiter, fragmentShaderSaturn, fragmentShaderUranus, fragmentShaderNeptune, nullptr};
+    planetSurfaces[SUN].hdrShader = fragmentShaderSunHDR;
+
+    if (noiseGraphMaterials) {
+        // Los demás planetas no tienen material de grafo y siguen con su shader
+        std::array<const char*, SHIP + 1> materialPaths = {nullptr, nullptr, "../materials/earth.graph", nullptr, "../materials/jupiter.graph", nullptr, nullptr, nullptr, nullptr};
+        for (int planet = SUN; planet <= NEPTUNE; planet++) {
+            if (materialPaths[planet]) {
+                loadNoiseGraph(materialPaths[planet], animationPhase, planetSurfaces[planet].noiseGraph);
+            }
+        }
+    }
+
+    // Las texturas horneadas y los tiles virtuales de los planetas con material de grafo se sombrean con el grafo por lotes
+    auto planetGraph = [](int planet) -> const NoiseGraph* {
+        return planetSurfaces[planet].noiseGraph.output >= 0 ? &planetSurfaces[planet].noiseGraph : nullptr;
+    };
+
+    if (bakedPlanetTextures) {
+        for (int planet = SUN; planet <= NEPTUNE; planet++) {
+            planetSurfaces[planet].bakedTexture = bakeCubeMap(planetShaders[planet], bakeUniform, planetBoundingRadius, planetTextureSize, TEXTURE_BC1, planetGraph(planet));
+        }
+    }
+
+    // Es local a main, así que sus trabajadores terminan antes de que se destruyan las texturas virtuales globales
+    TileStreamer tileStreamer;
+    if (virtualTexturedPlanets) {
+        for (int planet = SUN; planet <= NEPTUNE; planet++) {
+            planetSurfaces[planet].virtualTexture = createVirtualTexture(planetShaders[planet], bakeUniform, planetBoundingRadius, planetGraph(planet));
+        }
+        startTileStreamer(tileStreamer);
+    }
+
+    Bloom bloom;
+
+    // Las tablas se guardan junto al ejecutable y se recalculan si cambian los parámetros
+    if (planetAtmospheres) {
+        planetSurfaces[EARTH].atmosphere = createAtmosphere({0.06f, 0.012f, glm::vec3(0.03f, 0.07f, 0.17f), 8.0f}, planetBoundingRadius, "atmosphere-earth.lut");
+        planetSurfaces[URANUS].atmosphere = createAtmosphere({0.08f, 0.016f, glm::vec3(0.03f, 0.12f, 0.14f), 8.0f}, planetBoundingRadius, "atmosphere-uranus.lut");
+        planetSurfaces[NEPTUNE].atmosphere = createAtmosphere({0.08f, 0.016f, glm::vec3(0.02f, 0.06f, 0.22f), 8.0f}, planetBoundingRadius, "atmosphere-neptune.lut");
+    }
+
+    CompressedCubeMap skyCubeMap;
+    if (skyBackend == SKY_CUBEMAP) {
+        Uniform skyUniform{};
+        skyUniform.animationPhase = animationPhase;
+        skyCubeMap = bakeSkyCubeMap(fragmentShader, skyUniform, planetBoundingRadius);
+    }
 
     std::vector<glm::vec3> spaceshipVertices;
     std::vector<glm::vec3> spaceshipNormal;
@@ -279,7 +919,13 @@ int main(int argc, char* argv[]) {
     if (!success2) {
         return 1;
     }
-    std::vector<Vertex> vertexArrayShip = setupVertexArray(spaceshipVertices, spaceshipNormal, spaceshipFaces);
+    // El nivel 0 es la nave tal como viene del archivo; los demás salen de simplificarla
+    MeshLODChain shipLODs = buildMeshLODs(spaceshipVertices, spaceshipNormal, spaceshipFaces, simplifiedShipLODs ? minimumLODFaces : spaceshipFaces.size() + 1);
+    float shipBoundingRadius = calculateBoundingRadius(shipLODs.levels[0].vertices);
+    std::vector<MeshHandle> shipMeshes;
+    for (const MeshLOD& level : shipLODs.levels) {
+        shipMeshes.push_back(createMeshHandle(createQuantizedMesh(level.vertices, optimizeMeshOrder)));
+    }
 
     float forwardBackwardMovementSpeed = 0.1f;
     float leftRightMovementSpeed = 0.06f;
@@ -338,8 +984,6 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        models.clear();
-        light = cameraPosition - targetPosition;
         sunRotation += 0.01f;
         earthRotation += 0.2f;
         marsRotation += 0.15f;
@@ -356,111 +1000,131 @@ int main(int argc, char* argv[]) {
         glm::vec3 translateUranus = calculatePositionInCircle(uranusRotation, 5.5f);
         glm::vec3 translateNeptune = calculatePositionInCircle(neptuneRotation, 6.25f);
 
-        uniform.model = createModelSpace();
+        FrameUniforms frameUniforms;
+        frameUniforms.time = (SDL_GetTicks() - startTicks) / 1000.0f;
+        frameUniforms.sunPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+        frameUniforms.cameraPosition = cameraPosition;
+
+        InstanceData space = {createModelSpace(), SPACE, animationPhase};
+        std::vector<InstanceData> planets = {
+            {createModelPlanet(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.5f, 1.5f, 1.5f), glm::vec3(0.0f, 1.0f, 0.0f), 0.1f), SUN, animationPhase},
+            {createModelPlanet(translateEarth, glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), 0.35f), EARTH, animationPhase},
+            {createModelPlanet(translateMars, glm::vec3(0.45f, 0.45f, 0.45f), glm::vec3(0.0f, 1.0f, 0.0f), 0.3f), MARS, animationPhase},
+            {createModelPlanet(translateJupiter, glm::vec3(0.8f, 0.8f, 0.8f), glm::vec3(0.0f, 1.0f, 0.0f), 0.15f), JUPITER, animationPhase},
+            {createModelPlanet(translateSaturn, glm::vec3(0.65f, 0.65f, 0.65f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f), SATURN, animationPhase},
+            {createModelPlanet(translateUranus, glm::vec3(0.6f, 0.6f, 0.6f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f), URANUS, animationPhase},
+            {createModelPlanet(translateNeptune, glm::vec3(0.7f, 0.7f, 0.7f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f), NEPTUNE, animationPhase}};
+        InstanceData ship = {createModelSpaceship(cameraPosition, targetPosition, upVector, rotationX, rotationY), SHIP, animationPhase};
+
+        uniform.model = space.model;
         uniform.view = glm::lookAt(cameraPosition, targetPosition, upVector);
         uniform.projection = createProjectionMatrix();
         uniform.viewport = createViewportMatrix();
+        uniform.frame = frameUniforms;
+        uniform.animationPhase = animationPhase;
 
-        model1.uniform = uniform;
-        model1.v = &vertexArrayPlanet;
-        model1.i = SPACE;
-
-        uniform2.model = createModelPlanet(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.5f, 1.5f, 1.5f), glm::vec3(0.0f, 1.0f, 0.0f), 0.1f);
-        uniform2.view =  glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform2.projection = createProjectionMatrix();
-        uniform2.viewport = createViewportMatrix();
-
-        model2.uniform = uniform2;
-        model2.v = &vertexArrayPlanet;
-        model2.i = SUN;
-
-        uniform3.model = createModelPlanet(translateEarth, glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), 0.35f);
-        uniform3.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform3.projection = createProjectionMatrix();
-        uniform3.viewport = createViewportMatrix();
-
-        model3.uniform = uniform3;
-        model3.v = &vertexArrayPlanet;
-        model3.i = EARTH;
-
-        uniform4.model = createModelPlanet(translateMars, glm::vec3(0.45f, 0.45f, 0.45f), glm::vec3(0.0f, 1.0f, 0.0f), 0.3f);
-        uniform4.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform4.projection = createProjectionMatrix();
-        uniform4.viewport = createViewportMatrix();
-
-        model4.uniform = uniform4;
-        model4.v = &vertexArrayPlanet;
-        model4.i = MARS;
-
-        uniform5.model = createModelPlanet(translateJupiter, glm::vec3(0.8f, 0.8f, 0.8f), glm::vec3(0.0f, 1.0f, 0.0f), 0.15f);
-        uniform5.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform5.projection = createProjectionMatrix();
-        uniform5.viewport = createViewportMatrix();
-
-        model5.uniform = uniform5;
-        model5.v = &vertexArrayPlanet;
-        model5.i = JUPITER;
-
-        uniform6.model = createModelPlanet(translateSaturn, glm::vec3(0.65f, 0.65f, 0.65f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f);
-        uniform6.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform6.projection = createProjectionMatrix();
-        uniform6.viewport = createViewportMatrix();
-
-        model6.uniform = uniform6;
-        model6.v = &vertexArrayPlanet;
-        model6.i = SATURN;
-
-        uniform7.model = createModelPlanet(translateUranus, glm::vec3(0.6f, 0.6f, 0.6f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f);
-        uniform7.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform7.projection = createProjectionMatrix();
-        uniform7.viewport = createViewportMatrix();
-
-        model7.uniform = uniform7;
-        model7.v = &vertexArrayPlanet;
-        model7.i = URANUS;
-
-        uniform8.model = createModelPlanet(translateNeptune, glm::vec3(0.7f, 0.7f, 0.7f), glm::vec3(0.0f, 1.0f, 0.0f), 0.2f);
-        uniform8.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform8.projection = createProjectionMatrix();
-        uniform8.viewport = createViewportMatrix();
-
-        model8.uniform = uniform8;
-        model8.v = &vertexArrayPlanet;
-        model8.i = NEPTUNE;
-
-        uniform9.model = createModelSpaceship(cameraPosition, targetPosition, upVector, rotationX, rotationY);
-        uniform9.view = glm::lookAt(cameraPosition, targetPosition, upVector);
-        uniform9.projection = createProjectionMatrix();
-        uniform9.viewport = createViewportMatrix();
-
-        model9.uniform = uniform9;
-        model9.v = &vertexArrayShip;
-        model9.i = SHIP;
-
-        models.push_back(model1);
-        models.push_back(model2);
-        models.push_back(model3);
-        models.push_back(model4);
-        models.push_back(model5);
-        models.push_back(model6);
-        models.push_back(model7);
-        models.push_back(model8);
-        models.push_back(model9);
-
-        SDL_SetRenderDrawColor(renderer, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
-        SDL_RenderClear(renderer);
+        // El sol alcanza todo el sistema; su radio solo existe para que la caída no lo apague
+        std::vector<PointLight> lights = {{frameUniforms.sunPosition, 1000.0f, ColorF(1.0f, 0.95f, 0.85f), true}};
+        if (dynamicLights) {
+            addDynamicLights(lights, frameUniforms.time, glm::normalize(targetPosition - cameraPosition), upVector, ship.model, planets, planetBoundingRadius);
+        }
+        buildLightClusters(lightClusters, lights, uniform);
+
+        // Los planetas se tapan el sol entre ellos; el bit de cada oclusor es su número de planeta
+        std::vector<Occluder> occluders(SHIP + 1, Occluder{glm::vec3(0.0f), 0.0f});
+        if (eclipseShadows) {
+            for (const InstanceData& planet : planets) {
+                if (planet.material != SUN) {
+                    occluders[planet.material] = {glm::vec3(planet.model[3]), planetBoundingRadius * glm::length(glm::vec3(planet.model[0]))};
+                }
+            }
+        }
+        buildEclipseTiles(eclipseTiles, occluders, frameUniforms.sunPosition, planetBoundingRadius * glm::length(glm::vec3(planets[0].model[0])), uniform);
+
+        drawList.clear();
+        if (skyBackend == SKY_SPHERE) {
+            drawInstanced(planetMesh, std::span(&space, 1), uniform, planetBoundingRadius);
+        }
+        if (proceduralSphereLODs) {
+            // Los planetas con el mismo nivel van en un lote; los que están a mitad de un cambio de nivel y pasan por la
+            // malla llevan su propia copia morfada, porque las demás calidades dibujan la esfera analítica
+            std::vector<std::vector<InstanceData>> levelInstances(planetLODs.levels.size());
+            for (const InstanceData& planet : planets) {
+                Uniform planetUniform = instanceUniform(uniform, planet);
+                SphereLODSelection lod = selectSphereLOD(planetLODs, calculateProjectedRadius(planetUniform, planetBoundingRadius), sphereLODPixelError);
+                const SphereLevel& level = planetLODs.levels[lod.level];
+                ShadingQuality quality = selectShadingQuality(planet.material, planetUniform, planetBoundingRadius, level.mesh->vertices.size());
+                bool meshPath = !analyticSpheres || quality == PER_VERTEX || quality == HYBRID;
+                if (sphereGeomorphing && meshPath && lod.morph < 1.0f) {
+                    QuantizedMesh morphed;
+                    morphSphereLevel(level, lod.morph, morphed);
+                    drawInstanced(createMeshHandle(std::move(morphed)), std::span(&planet, 1), uniform, planetBoundingRadius);
+                } else {
+                    levelInstances[lod.level].push_back(planet);
+                }
+            }
+            for (size_t level = 0; level < levelInstances.size(); level++) {
+                drawInstanced(planetLODs.levels[level].mesh, levelInstances[level], uniform, planetBoundingRadius);
+            }
+        } else {
+            drawInstanced(planetMesh, planets, uniform, planetBoundingRadius);
+        }
+        // Un modelo de radio 1 a la distancia de la nave mide en pantalla cuántos píxeles ocupa una unidad
+        size_t shipLevel = selectMeshLOD(shipLODs, calculateProjectedRadius(instanceUniform(uniform, ship), 1.0f), meshLODPixelError);
+        drawInstanced(shipMeshes[shipLevel], std::span(&ship, 1), uniform, shipBoundingRadius);
+
+        clearFramebuffer(clearColor);
         std::fill(zBuffer.begin(), zBuffer.end(), std::numeric_limits<double>::max());
+        if (hdrFramebufferEnabled) {
+            clearHDRCoverage();
+        }
 
-        std::vector<std::thread> threadS;
+        // El cielo va primero para que los bordes de las esferas se mezclen con él
+        if (skyBackend == SKY_CUBEMAP) {
+            renderSkyCubeMap(skyCubeMap, uniform, zBuffer);
+        } else if (skyBackend == SKY_STARFIELD) {
+            renderStarfield(uniform, zBuffer);
+        }
 
-        for (const BuildingModel& model : models) {
-            threadS.emplace_back(render, *model.v, model.uniform, model.i);
+        totalMeshlets = 0;
+        visibleMeshlets = 0;
+        occludedMeshlets = 0;
+        meshletPass = FIRST_MESHLET_PASS;
+        executeDrawList(uniform);
+        if (occludedMeshlets > 0) {
+            buildDepthPyramid(depthPyramid, zBuffer.data(), WINDOW_WIDTH, WINDOW_HEIGHT);
+            meshletPass = SECOND_MESHLET_PASS;
+            executeDrawList(uniform);
         }
-        for (std::thread& thread : threadS) {
-            thread.join();
+        // Los halos no tapan nada y el cielo no escribe profundidad, así que la pirámide del cuadro siguiente sale de las
+        // mallas solas
+        if (meshletOcclusionCulling) {
+            buildDepthPyramid(previousDepthPyramid, zBuffer.data(), WINDOW_WIDTH, WINDOW_HEIGHT);
         }
 
-        SDL_RenderPresent(renderer);
+        for (PlanetSurface& surface : planetSurfaces) {
+            if (surface.virtualTexture) {
+                updateVirtualTexture(*surface.virtualTexture, tileStreamer);
+            }
+        }
+
+        for (const DrawCommand& command : drawList) {
+            if (planetSurfaces[command.material].atmosphere) {
+                for (const InstanceData& instance : command.instances) {
+                    renderAtmosphereLimb(*planetSurfaces[command.material].atmosphere, instanceUniform(uniform, instance), zBuffer, hdrFramebufferEnabled);
+                }
+            }
+        }
+
+        if (bloomEnabled) {
+            applyBloom(bloom, hdrFramebufferEnabled);
+        }
+
+        if (hdrFramebufferEnabled) {
+            renderHDRBuffer(renderer, hdrExposure);
+        } else {
+            renderBuffer(renderer);
+        }
         frameTime = SDL_GetTicks() - startingFrame;
         frameCounter++;
         if (frameTime >= 1000) {
@@ -469,6 +1133,14 @@ int main(int argc, char* argv[]) {
             startingFrame = SDL_GetTicks();
         }
         std::string fpsText = "Space Travel | FPS: " + std::to_string(fps);
+        if (bloomEnabled) {
+            char bloomText[32];
+            std::snprintf(bloomText, sizeof(bloomText), " | Bloom: %.2f ms", bloom.lastMilliseconds);
+            fpsText += bloomText;
+        }
+        fpsText += " | Lights: " + std::to_string(lightClusters.lights.size());
+        fpsText += " | Batches: " + std::to_string(drawList.size());
+        fpsText += " | Clusters: " + std::to_string(visibleMeshlets.load()) + "/" + std::to_string(totalMeshlets.load());
         SDL_SetWindowTitle(window, fpsText.c_str());
     }
     SDL_DestroyRenderer(renderer);